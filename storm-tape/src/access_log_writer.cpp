@@ -0,0 +1,272 @@
+// SPDX-FileCopyrightText: 2025 Istituto Nazionale di Fisica Nucleare
+//
+// SPDX-License-Identifier: EUPL-1.2
+
+#include "access_log_writer.hpp"
+#include <crow/logging.h>
+#include <fmt/chrono.h>
+#include <fmt/core.h>
+#include <fmt/std.h>
+#include <time.h>
+#include <stdexcept>
+#include <string_view>
+
+namespace storm {
+
+namespace {
+
+bool acceptable_request_id(std::string_view id)
+{
+  std::string_view acceptable = "ABCDEFGHIJKLMNOPQRSTUVWZ"
+                                "abcdefghijklmnopqrstuvwz"
+                                "0123456789;=-";
+  return id.size() > 0U && id.size() <= 120U
+      && id.find_first_not_of(acceptable) == std::string::npos;
+}
+
+// as std::quoted
+void append_quoted(std::string& out, std::string_view s)
+{
+  out += '"';
+  for (auto c : s) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+    }
+    out += c;
+  }
+  out += '"';
+}
+
+std::size_t quoted_size(std::string_view s)
+{
+  std::size_t size{2};
+  for (auto c : s) {
+    size += (c == '"' || c == '\\') ? 2 : 1;
+  }
+  return size;
+}
+
+// The timestamp, in local time, formatted at most once per second. Only the
+// thread writing the log uses it.
+std::string_view format_timestamp(std::time_t t)
+{
+  thread_local std::time_t cached_time{-1};
+  thread_local std::string cached;
+  if (t != cached_time) {
+    tm out{};
+    cached      = fmt::format("{:%FT%T%Ez}", *::localtime_r(&t, &out));
+    cached_time = t;
+  }
+  return cached;
+}
+
+} // namespace
+
+void append_access_log_line(std::string& out, AccessLogRecord const& record)
+{
+  auto const line_start = out.size();
+
+  out += format_timestamp(record.timestamp);
+  out += ' ';
+  out += acceptable_request_id(record.request_id) ? record.request_id : "-";
+  out += ' ';
+  if (record.principal.empty()) {
+    out += '-';
+  } else if (record.is_voms_user) {
+    append_quoted(out, record.principal);
+  } else {
+    out += record.principal;
+  }
+  fmt::format_to(std::back_inserter(out), " {} {} {:.3f} {} {} {}",
+                 record.operation, record.code,
+                 std::chrono::duration<double, std::milli>{record.latency}
+                     .count(),
+                 record.request_bytes, record.response_bytes, record.n_files);
+
+  auto const& op = record.operation;
+  if (op == "STAGE" || op == "STATUS" || op == "CANCEL" || op == "RELEASE"
+      || op == "DELETE") {
+    out += ' ';
+    out += record.stage_id;
+  }
+
+  if (op == "STAGE") {
+    constexpr long max_line_length = 2'048;
+    out += ' ';
+    // for the square brackets, a comma and the ellipsis
+    auto space_left =
+        max_line_length - static_cast<long>(out.size() - line_start) - 6;
+    out += '[';
+    bool first = true;
+    for (auto const& file : record.files) {
+      auto const& path = file.logical_path.native();
+      auto const size  = static_cast<long>(quoted_size(path));
+      // consider the comma
+      auto const needed = size + (first ? 0 : 1);
+      if (!first) {
+        out += ',';
+      }
+      if (needed > space_left) {
+        out += "...";
+        break;
+      }
+      append_quoted(out, path);
+      space_left -= needed;
+      first = false;
+    }
+    out += ']';
+  }
+  out += '\n';
+}
+
+class AccessLogWriter::Ring
+{
+  std::vector<AccessLogRecord> m_slots;
+  // the next record to push, only advanced by the owning thread
+  std::atomic<std::size_t> m_head{0};
+  // the next record to pop, only advanced by the drainer
+  std::atomic<std::size_t> m_tail{0};
+
+ public:
+  explicit Ring(std::size_t capacity)
+      : m_slots(capacity)
+  {}
+
+  bool push(AccessLogRecord&& record)
+  {
+    auto const head = m_head.load(std::memory_order_relaxed);
+    auto const tail = m_tail.load(std::memory_order_acquire);
+    if (head - tail == m_slots.size()) {
+      return false;
+    }
+    m_slots[head % m_slots.size()] = std::move(record);
+    m_head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  template<typename F>
+  std::size_t consume(F f)
+  {
+    auto const tail = m_tail.load(std::memory_order_relaxed);
+    auto const head = m_head.load(std::memory_order_acquire);
+    for (auto i = tail; i != head; ++i) {
+      auto& slot = m_slots[i % m_slots.size()];
+      f(slot);
+      // release the memory held by the record, e.g. the files of a stage
+      slot = AccessLogRecord{};
+    }
+    m_tail.store(head, std::memory_order_release);
+    return head - tail;
+  }
+};
+
+static std::uint64_t next_writer_id()
+{
+  static std::atomic<std::uint64_t> id{0};
+  return ++id;
+}
+
+AccessLogWriter::AccessLogWriter(AccessLogConfiguration const& config)
+    : m_config{config}
+    , m_file{config.file.empty() ? stdout
+                                 : std::fopen(config.file.c_str(), "a")}
+    , m_owns_file{!config.file.empty()}
+    , m_id{next_writer_id()}
+{
+  if (m_file == nullptr) {
+    throw std::runtime_error{
+        fmt::format("cannot open access log file '{}'", config.file)};
+  }
+  m_drainer = std::jthread{[this](std::stop_token token) { run(token); }};
+}
+
+AccessLogWriter::~AccessLogWriter()
+{
+  m_drainer.request_stop();
+  m_drainer.join();
+  if (m_owns_file) {
+    std::fclose(m_file);
+  }
+}
+
+AccessLogWriter::Ring& AccessLogWriter::ring()
+{
+  // the writers are rarely more than one, remember only the last one used
+  thread_local std::uint64_t writer_id{0};
+  thread_local RingPtr ring;
+  if (writer_id != m_id) {
+    ring = std::make_shared<Ring>(m_config.buffer_size);
+    {
+      std::lock_guard lock{m_rings_mutex};
+      m_rings.push_back(ring);
+    }
+    writer_id = m_id;
+  }
+  return *ring;
+}
+
+bool AccessLogWriter::push(AccessLogRecord&& record)
+{
+  if (ring().push(std::move(record))) {
+    return true;
+  }
+  m_dropped.fetch_add(1, std::memory_order_relaxed);
+  return false;
+}
+
+std::uint64_t AccessLogWriter::dropped() const
+{
+  return m_dropped.load(std::memory_order_relaxed);
+}
+
+bool AccessLogWriter::drain(std::string& buffer)
+{
+  std::vector<RingPtr> rings;
+  {
+    std::lock_guard lock{m_rings_mutex};
+    rings = m_rings;
+  }
+
+  buffer.clear();
+  std::size_t n{0};
+  for (auto const& ring : rings) {
+    n += ring->consume([&](AccessLogRecord const& record) {
+      append_access_log_line(buffer, record);
+    });
+  }
+  if (n == 0) {
+    return false;
+  }
+  std::fwrite(buffer.data(), 1, buffer.size(), m_file);
+  std::fflush(m_file);
+  return true;
+}
+
+void AccessLogWriter::run(std::stop_token token)
+{
+  std::string buffer;
+  std::uint64_t reported_dropped{0};
+  auto report_dropped = [&] {
+    if (auto const d = dropped(); d != reported_dropped) {
+      CROW_LOG_WARNING << fmt::format(
+          "{} access log records dropped, the buffers are full",
+          d - reported_dropped);
+      reported_dropped = d;
+    }
+  };
+
+  while (!token.stop_requested()) {
+    {
+      std::unique_lock lock{m_cv_mutex};
+      m_cv.wait_for(lock, token, m_config.flush_interval, [] { return false; });
+    }
+    drain(buffer);
+    report_dropped();
+  }
+
+  // what was pushed before stopping
+  drain(buffer);
+  report_dropped();
+}
+
+} // namespace storm
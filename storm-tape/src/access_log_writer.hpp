@@ -0,0 +1,93 @@
+// SPDX-FileCopyrightText: 2025 Istituto Nazionale di Fisica Nucleare
+//
+// SPDX-License-Identifier: EUPL-1.2
+
+#ifndef STORM_ACCESS_LOG_WRITER_HPP
+#define STORM_ACCESS_LOG_WRITER_HPP
+
+#include "configuration.hpp"
+#include "file.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace storm {
+
+// What is known of a request when it has been served. The record is formatted
+// into a line of the access log only when it is written.
+struct AccessLogRecord
+{
+  std::time_t timestamp{};
+  // as received, validated when formatted
+  std::string request_id;
+  // the subject, or the VOMS user if there is no subject
+  std::string principal;
+  bool is_voms_user{false};
+  std::string operation;
+  int code{};
+  // from the arrival of the request to the end of its handler
+  std::chrono::microseconds latency{};
+  std::size_t request_bytes{};
+  std::size_t response_bytes{};
+  // the files of the request or of the response, depending on the operation
+  std::size_t n_files{};
+  std::string stage_id;
+  Files files;
+};
+
+// Append the line of the access log corresponding to a record, including the
+// final newline. The line has the fields
+//   timestamp request-id principal operation code latency-ms request-bytes
+//   response-bytes n-files [stage-id [files]]
+void append_access_log_line(std::string& out, AccessLogRecord const& record);
+
+// The records are pushed by the threads serving the requests in a ring buffer
+// of their own, without locking. A background thread periodically collects
+// the records of all the buffers, formats them and writes them in one go. A
+// record that doesn't fit in the buffer of its thread is dropped.
+class AccessLogWriter
+{
+  class Ring;
+  using RingPtr = std::shared_ptr<Ring>;
+
+  AccessLogConfiguration m_config;
+  std::FILE* m_file;
+  bool m_owns_file;
+  // distinguishes the writers for the per-thread lookup of the rings
+  std::uint64_t m_id;
+  std::mutex m_rings_mutex;
+  std::vector<RingPtr> m_rings;
+  std::atomic<std::uint64_t> m_dropped{0};
+  std::condition_variable_any m_cv;
+  std::mutex m_cv_mutex;
+  std::jthread m_drainer;
+
+  Ring& ring();
+  void run(std::stop_token token);
+  // return true if any record was written
+  bool drain(std::string& buffer);
+
+ public:
+  explicit AccessLogWriter(AccessLogConfiguration const& config);
+  ~AccessLogWriter();
+  AccessLogWriter(AccessLogWriter const&)            = delete;
+  AccessLogWriter& operator=(AccessLogWriter const&) = delete;
+  AccessLogWriter(AccessLogWriter&&)                 = delete;
+  AccessLogWriter& operator=(AccessLogWriter&&)      = delete;
+
+  // return false if the record has been dropped
+  bool push(AccessLogRecord&& record);
+  std::uint64_t dropped() const;
+};
+
+} // namespace storm
+
+#endif
@@ -3,88 +3,41 @@
 // SPDX-License-Identifier: EUPL-1.2
 
 #include "access_logger.hpp"
-#include <fmt/chrono.h>
-#include <fmt/std.h>
-#include <time.h>
-#include <iomanip>
+#include <ctime>
 #include <iostream>
-#include <sstream>
 
-namespace {
-bool acceptable_request_id(std::string_view id)
+void storm::AccessLogger::open(AccessLogConfiguration const& config)
 {
-  std::string_view acceptable = "ABCDEFGHIJKLMNOPQRSTUVWZ"
-                                "abcdefghijklmnopqrstuvwz"
-                                "0123456789;=-";
-  return id.size() > 0U && id.size() <= 120U
-      && id.find_first_not_of(acceptable) == std::string::npos;
+  m_writer = std::make_unique<AccessLogWriter>(config);
 }
-} // namespace
 
 void storm::AccessLogger::after_handle(crow::request& req, crow::response& res,
                                        context& ctx)
 {
-  auto const timestamp = [] {
-    auto const t = std::time(nullptr);
-    tm out{};
-    return fmt::format("{:%FT%T%Ez}", *::localtime_r(&t, &out));
-  }();
-  auto const request_id = [&] {
-    auto& id = req.get_header_value("x-request-id");
-    return acceptable_request_id(id) ? id : "-";
-  }();
-  auto const principal = [&] {
-    if (auto sub = req.get_header_value("x-sub"); !sub.empty()) {
-      return sub;
-    } else if (auto voms_user = req.get_header_value("x-voms_user");
-               !voms_user.empty()) {
-      std::ostringstream os;
-      os << std::quoted(voms_user);
-      return os.str();
-    } else {
-      return std::string{"-"};
-    }
-  }();
-  auto files = [&](long space_left) {
-    space_left -= 6; // for the square brackets, a comma and the ellipsis
-
-    std::ostringstream result;
-    result << '[';
-
-    bool first = true;
-    for (auto& file : ctx.files) {
-      std::ostringstream os;
-      os << std::quoted(file.logical_path.string());
-      std::string qs{os.str()};
-      if (std::ssize(qs) + (first ? 0 : 1) > space_left) { // consider the comma
-        qs = "...";
-      }
-      if (first) {
-        result << qs;
-        first = false;
-      } else {
-        result << ',' << qs;
-      }
-      space_left -= std::ssize(qs);
-      if (qs == "...") {
-        break;
-      }
-    }
-    result << ']';
-    return result.str();
-  };
-
-  std::ostringstream os;
-  os << timestamp << ' ' << request_id << ' ' << principal << ' '
-     << ctx.operation << ' ' << res.code;
-  if (ctx.operation == "STAGE" || ctx.operation == "STATUS"
-      || ctx.operation == "CANCEL" || ctx.operation == "RELEASE"
-      || ctx.operation == "DELETE") {
-    os << ' ' << ctx.stage_id;
+  // only what is needed is copied here, the line is formatted by the writer
+  auto const latency = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - ctx.start);
+  AccessLogRecord record{.timestamp      = std::time(nullptr),
+                         .request_id     = req.get_header_value("x-request-id"),
+                         .principal      = req.get_header_value("x-sub"),
+                         .operation      = std::move(ctx.operation),
+                         .code           = res.code,
+                         .latency        = latency,
+                         .request_bytes  = req.body.size(),
+                         .response_bytes = res.body.size(),
+                         .n_files        = ctx.n_files,
+                         .stage_id       = std::move(ctx.stage_id),
+                         .files          = std::move(ctx.files)};
+  if (record.principal.empty()) {
+    record.principal    = req.get_header_value("x-voms_user");
+    record.is_voms_user = true;
   }
-  if (ctx.operation == "STAGE") {
-    constexpr long max_line_length = 2'048;
-    os << ' ' << files(max_line_length - static_cast<long>(os.tellp()));
+
+  if (m_writer != nullptr) {
+    m_writer->push(std::move(record));
+  } else {
+    std::string line;
+    append_access_log_line(line, record);
+    std::cout << line;
   }
-  std::cout << os.str() << '\n';
 }
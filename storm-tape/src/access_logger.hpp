@@ -5,8 +5,12 @@
 #ifndef STORM_ACCESS_LOGGER_HPP
 #define STORM_ACCESS_LOGGER_HPP
 
+#include "access_log_writer.hpp"
+#include "configuration.hpp"
 #include "file.hpp"
 #include <crow.h>
+#include <chrono>
+#include <memory>
 #include <string>
 
 namespace storm {
@@ -18,12 +22,24 @@ struct AccessLogger
     std::string operation{"-"};
     std::string stage_id{"-"};
     Files files;
+    std::size_t n_files{0};
+    std::chrono::steady_clock::time_point start;
   };
 
-  void before_handle(crow::request&, crow::response&, context&)
-  {}
+  // Write the access log in the background, as configured. Until then the
+  // lines are written to the standard output by the threads serving the
+  // requests.
+  void open(AccessLogConfiguration const& config);
+
+  void before_handle(crow::request&, crow::response&, context& ctx)
+  {
+    ctx.start = std::chrono::steady_clock::now();
+  }
 
   void after_handle(crow::request& req, crow::response& res, context& ctx);
+
+ private:
+  std::unique_ptr<AccessLogWriter> m_writer;
 };
 
 } // namespace storm
@@ -16,8 +16,10 @@
 #include <unistd.h>
 #include <algorithm>
 #include <array>
+#include <cctype>
 #include <climits>
 #include <fstream>
+#include <initializer_list>
 #include <iostream>
 #include <numeric>
 #include <optional>
@@ -423,6 +425,32 @@ static std::optional<std::string> load_tracing_endpoint(YAML::Node const& node)
   return endpoint;
 }
 
+static std::optional<TracingLevel> load_tracing_level(YAML::Node const& node)
+{
+  const auto level_key = "tracing-level";
+  const auto& value    = node[level_key];
+  if (!value.IsDefined()) {
+    return std::nullopt;
+  }
+
+  if (value.IsNull()) {
+    throw std::runtime_error{fmt::format("'{}' is null", level_key)};
+  }
+
+  auto const level = value.as<std::string>("");
+  if (level == "off") {
+    return TracingLevel::off;
+  }
+  if (level == "request") {
+    return TracingLevel::request;
+  }
+  if (level == "full") {
+    return TracingLevel::full;
+  }
+  throw std::runtime_error{
+      fmt::format("invalid '{}' entry in configuration", level_key)};
+}
+
 static std::optional<TelemetryConfiguration>
 load_telemetry(YAML::Node const& node)
 {
@@ -442,6 +470,430 @@ load_telemetry(YAML::Node const& node)
     config.tracing_endpoint = std::move(maybe_tracing_endpoint.value());
   }
 
+  const auto maybe_tracing_level = load_tracing_level(node);
+  if (maybe_tracing_level.has_value()) {
+    config.tracing_level = maybe_tracing_level.value();
+  }
+
+  return config;
+}
+
+static std::optional<std::string>
+load_database_enum(YAML::Node const& node, char const* key,
+                   std::initializer_list<std::string_view> allowed)
+{
+  auto const& value = node[key];
+  if (!value.IsDefined()) {
+    return std::nullopt;
+  }
+
+  if (value.IsNull()) {
+    throw std::runtime_error{fmt::format("'{}' is null", key)};
+  }
+
+  auto result = value.as<std::string>("");
+  std::transform(result.begin(), result.end(), result.begin(),
+                 [](unsigned char c) { return std::toupper(c); });
+  if (std::find(allowed.begin(), allowed.end(), result) == allowed.end()) {
+    throw std::runtime_error{
+        fmt::format("invalid '{}' entry in configuration", key)};
+  }
+  return result;
+}
+
+static std::optional<std::int64_t>
+load_non_negative(YAML::Node const& node, char const* key)
+{
+  auto const& value = node[key];
+  if (!value.IsDefined()) {
+    return std::nullopt;
+  }
+
+  if (value.IsNull()) {
+    throw std::runtime_error{fmt::format("'{}' is null", key)};
+  }
+
+  std::int64_t size;
+  if (boost::conversion::try_lexical_convert(value, size)) {
+    if (size >= 0) {
+      return size;
+    }
+  }
+  throw std::runtime_error{
+      fmt::format("invalid '{}' entry in configuration", key)};
+}
+
+static DatabaseConfiguration load_database(YAML::Node const& node)
+{
+  DatabaseConfiguration config;
+
+  if (!node.IsDefined() || node.IsNull()) {
+    return config;
+  }
+
+  if (!node.IsMap()) {
+    throw std::runtime_error{"invalid 'database' entry in configuration"};
+  }
+
+  {
+    auto const key    = "path";
+    auto const& value = node[key];
+    if (value.IsDefined()) {
+      if (value.IsNull()) {
+        throw std::runtime_error{fmt::format("'{}' is null", key)};
+      }
+      auto const path = value.as<std::string>("");
+      if (path.empty()) {
+        throw std::runtime_error{
+            fmt::format("invalid '{}' entry in configuration", key)};
+      }
+      config.path = path;
+    }
+  }
+
+  if (auto maybe = load_database_enum(
+          node, "journal-mode",
+          {"DELETE", "TRUNCATE", "PERSIST", "MEMORY", "WAL", "OFF"});
+      maybe.has_value()) {
+    config.journal_mode = std::move(*maybe);
+  }
+
+  if (auto maybe = load_database_enum(node, "synchronous",
+                                      {"OFF", "NORMAL", "FULL", "EXTRA"});
+      maybe.has_value()) {
+    config.synchronous = std::move(*maybe);
+  }
+
+  if (auto maybe = load_non_negative(node, "mmap-size"); maybe.has_value()) {
+    config.mmap_size = *maybe;
+  }
+
+  if (auto maybe = load_non_negative(node, "cache-size"); maybe.has_value()) {
+    config.cache_size = *maybe;
+  }
+
+  if (auto maybe = load_non_negative(node, "busy-timeout");
+      maybe.has_value()) {
+    config.busy_timeout = std::chrono::milliseconds{*maybe};
+  }
+
+  if (auto maybe = load_non_negative(node, "lease-timeout");
+      maybe.has_value()) {
+    config.lease_timeout = std::chrono::milliseconds{*maybe};
+  }
+
+  return config;
+}
+
+static std::optional<GroupCommitConfiguration>
+load_group_commit(YAML::Node const& node)
+{
+  if (!node.IsDefined() || node.IsNull()) {
+    return std::nullopt;
+  }
+
+  if (!node.IsMap()) {
+    throw std::runtime_error{"invalid 'group-commit' entry in configuration"};
+  }
+
+  GroupCommitConfiguration config;
+
+  if (auto maybe = load_non_negative(node, "max-batch-size");
+      maybe.has_value()) {
+    if (*maybe == 0) {
+      throw std::runtime_error{
+          "invalid 'max-batch-size' entry in configuration"};
+    }
+    config.max_batch_size = static_cast<std::size_t>(*maybe);
+  }
+
+  if (auto maybe = load_non_negative(node, "max-batch-latency");
+      maybe.has_value()) {
+    config.max_batch_latency = std::chrono::milliseconds{*maybe};
+  }
+
+  if (auto maybe = load_non_negative(node, "queue-capacity");
+      maybe.has_value()) {
+    if (*maybe == 0) {
+      throw std::runtime_error{
+          "invalid 'queue-capacity' entry in configuration"};
+    }
+    config.queue_capacity = static_cast<std::size_t>(*maybe);
+  }
+
+  return config;
+}
+
+static std::optional<StageCacheConfiguration>
+load_stage_cache(YAML::Node const& node)
+{
+  if (!node.IsDefined() || node.IsNull()) {
+    return std::nullopt;
+  }
+
+  if (!node.IsMap()) {
+    throw std::runtime_error{"invalid 'stage-cache' entry in configuration"};
+  }
+
+  StageCacheConfiguration config;
+
+  // the budget is expressed in MiB
+  if (auto maybe = load_non_negative(node, "memory-budget");
+      maybe.has_value()) {
+    config.memory_budget = static_cast<std::size_t>(*maybe) * 1024 * 1024;
+  }
+
+  return config;
+}
+
+static std::optional<ReconcilerConfiguration>
+load_reconciler(YAML::Node const& node)
+{
+  if (!node.IsDefined() || node.IsNull()) {
+    return std::nullopt;
+  }
+
+  if (!node.IsMap()) {
+    throw std::runtime_error{"invalid 'reconciler' entry in configuration"};
+  }
+
+  ReconcilerConfiguration config;
+
+  if (auto maybe = load_non_negative(node, "threads"); maybe.has_value()) {
+    if (*maybe == 0) {
+      throw std::runtime_error{"invalid 'threads' entry in configuration"};
+    }
+    config.threads = static_cast<std::size_t>(*maybe);
+  }
+
+  // the interval is expressed in seconds
+  if (auto maybe = load_non_negative(node, "interval"); maybe.has_value()) {
+    if (*maybe == 0) {
+      throw std::runtime_error{"invalid 'interval' entry in configuration"};
+    }
+    config.interval = std::chrono::seconds{*maybe};
+  }
+
+  return config;
+}
+
+static std::optional<RecallWatcherConfiguration>
+load_recall_watcher(YAML::Node const& node)
+{
+  if (!node.IsDefined() || node.IsNull()) {
+    return std::nullopt;
+  }
+
+  if (!node.IsMap()) {
+    throw std::runtime_error{
+        "invalid 'recall-watcher' entry in configuration"};
+  }
+
+  RecallWatcherConfiguration config;
+
+  if (auto maybe = load_non_negative(node, "max-directories");
+      maybe.has_value()) {
+    if (*maybe == 0) {
+      throw std::runtime_error{
+          "invalid 'max-directories' entry in configuration"};
+    }
+    config.max_directories = static_cast<std::size_t>(*maybe);
+  }
+
+  if (auto maybe = load_non_negative(node, "max-files"); maybe.has_value()) {
+    if (*maybe == 0) {
+      throw std::runtime_error{"invalid 'max-files' entry in configuration"};
+    }
+    config.max_files = static_cast<std::size_t>(*maybe);
+  }
+
+  return config;
+}
+
+static void load_parallelism_operation(
+    YAML::Node const& node, char const* key,
+    ParallelismConfiguration::Operation& operation)
+{
+  auto const& value = node[key];
+
+  if (!value.IsDefined() || value.IsNull()) {
+    return;
+  }
+
+  if (!value.IsMap()) {
+    throw std::runtime_error{
+        fmt::format("invalid '{}' entry in configuration", key)};
+  }
+
+  if (auto maybe = load_non_negative(value, "threads"); maybe.has_value()) {
+    operation.threads = static_cast<std::size_t>(*maybe);
+  }
+
+  if (auto maybe = load_non_negative(value, "files-per-task");
+      maybe.has_value()) {
+    if (*maybe == 0) {
+      throw std::runtime_error{
+          "invalid 'files-per-task' entry in configuration"};
+    }
+    operation.files_per_task = static_cast<std::size_t>(*maybe);
+  }
+}
+
+static std::optional<ParallelismConfiguration>
+load_parallelism(YAML::Node const& node)
+{
+  if (!node.IsDefined() || node.IsNull()) {
+    return std::nullopt;
+  }
+
+  if (!node.IsMap()) {
+    throw std::runtime_error{"invalid 'parallelism' entry in configuration"};
+  }
+
+  ParallelismConfiguration config;
+
+  if (auto maybe = load_non_negative(node, "threads"); maybe.has_value()) {
+    if (*maybe == 0) {
+      throw std::runtime_error{"invalid 'threads' entry in configuration"};
+    }
+    config.threads = static_cast<std::size_t>(*maybe);
+  }
+
+  load_parallelism_operation(node, "status", config.status);
+  load_parallelism_operation(node, "stage", config.stage);
+  load_parallelism_operation(node, "archive-info", config.archive_info);
+  load_parallelism_operation(node, "take-over", config.take_over);
+
+  return config;
+}
+
+static std::optional<IoUringConfiguration>
+load_io_uring(YAML::Node const& node)
+{
+  if (!node.IsDefined() || node.IsNull()) {
+    return std::nullopt;
+  }
+
+  if (!node.IsMap()) {
+    throw std::runtime_error{"invalid 'io-uring' entry in configuration"};
+  }
+
+  IoUringConfiguration config;
+
+  // the kernel doesn't accept more entries
+  constexpr std::int64_t max_queue_depth = 32'768;
+  if (auto maybe = load_non_negative(node, "queue-depth"); maybe.has_value()) {
+    if (*maybe == 0 || *maybe > max_queue_depth) {
+      throw std::runtime_error{"invalid 'queue-depth' entry in configuration"};
+    }
+    config.queue_depth = static_cast<unsigned>(*maybe);
+  }
+
+  return config;
+}
+
+static std::optional<DirectoryProbingConfiguration>
+load_directory_probing(YAML::Node const& node)
+{
+  if (!node.IsDefined() || node.IsNull()) {
+    return std::nullopt;
+  }
+
+  if (!node.IsMap()) {
+    throw std::runtime_error{
+        "invalid 'directory-probing' entry in configuration"};
+  }
+
+  DirectoryProbingConfiguration config;
+
+  if (auto maybe = load_non_negative(node, "max-open-directories");
+      maybe.has_value()) {
+    if (*maybe == 0) {
+      throw std::runtime_error{
+          "invalid 'max-open-directories' entry in configuration"};
+    }
+    config.max_open_directories = static_cast<std::size_t>(*maybe);
+  }
+
+  return config;
+}
+
+static std::optional<FileStatusCacheConfiguration>
+load_file_status_cache(YAML::Node const& node)
+{
+  if (!node.IsDefined() || node.IsNull()) {
+    return std::nullopt;
+  }
+
+  if (!node.IsMap()) {
+    throw std::runtime_error{
+        "invalid 'file-status-cache' entry in configuration"};
+  }
+
+  FileStatusCacheConfiguration config;
+
+  if (auto maybe = load_non_negative(node, "ttl"); maybe.has_value()) {
+    if (*maybe == 0) {
+      throw std::runtime_error{"invalid 'ttl' entry in configuration"};
+    }
+    config.ttl = std::chrono::milliseconds{*maybe};
+  }
+
+  if (auto maybe = load_non_negative(node, "max-files"); maybe.has_value()) {
+    if (*maybe == 0) {
+      throw std::runtime_error{"invalid 'max-files' entry in configuration"};
+    }
+    config.max_files = static_cast<std::size_t>(*maybe);
+  }
+
+  return config;
+}
+
+static AccessLogConfiguration load_access_log(YAML::Node const& node)
+{
+  AccessLogConfiguration config;
+
+  if (!node.IsDefined() || node.IsNull()) {
+    return config;
+  }
+
+  if (!node.IsMap()) {
+    throw std::runtime_error{"invalid 'access-log' entry in configuration"};
+  }
+
+  {
+    auto const key    = "file";
+    auto const& value = node[key];
+    if (value.IsDefined()) {
+      if (value.IsNull()) {
+        throw std::runtime_error{fmt::format("'{}' is null", key)};
+      }
+      auto const file = value.as<std::string>("");
+      if (file.empty()) {
+        throw std::runtime_error{
+            fmt::format("invalid '{}' entry in configuration", key)};
+      }
+      config.file = file;
+    }
+  }
+
+  if (auto maybe = load_non_negative(node, "buffer-size");
+      maybe.has_value()) {
+    if (*maybe == 0) {
+      throw std::runtime_error{"invalid 'buffer-size' entry in configuration"};
+    }
+    config.buffer_size = static_cast<std::size_t>(*maybe);
+  }
+
+  if (auto maybe = load_non_negative(node, "flush-interval");
+      maybe.has_value()) {
+    if (*maybe == 0) {
+      throw std::runtime_error{
+          "invalid 'flush-interval' entry in configuration"};
+    }
+    config.flush_interval = std::chrono::milliseconds{*maybe};
+  }
+
   return config;
 }
 
@@ -495,6 +947,74 @@ static Configuration load(YAML::Node const& node)
     config.concurrency = *maybe_concurrency;
   }
 
+  {
+    auto const key    = "database";
+    auto const& value = node[key];
+    config.database   = load_database(value);
+  }
+
+  {
+    auto const key      = "group-commit";
+    auto const& value   = node[key];
+    config.group_commit = load_group_commit(value);
+  }
+
+  {
+    auto const key     = "stage-cache";
+    auto const& value  = node[key];
+    config.stage_cache = load_stage_cache(value);
+  }
+
+  // The group commit queues the status updates, which the cache applies at
+  // once: a stage read from the database before they are committed would be
+  // cached stale
+  if (config.stage_cache.has_value() && config.group_commit.has_value()) {
+    throw std::runtime_error{
+        "'stage-cache' and 'group-commit' cannot be used together"};
+  }
+
+  {
+    auto const key    = "reconciler";
+    auto const& value = node[key];
+    config.reconciler = load_reconciler(value);
+  }
+
+  {
+    auto const key        = "recall-watcher";
+    auto const& value     = node[key];
+    config.recall_watcher = load_recall_watcher(value);
+  }
+
+  {
+    auto const key     = "parallelism";
+    auto const& value  = node[key];
+    config.parallelism = load_parallelism(value);
+  }
+
+  {
+    auto const key    = "io-uring";
+    auto const& value = node[key];
+    config.io_uring   = load_io_uring(value);
+  }
+
+  {
+    auto const key           = "directory-probing";
+    auto const& value        = node[key];
+    config.directory_probing = load_directory_probing(value);
+  }
+
+  {
+    auto const key           = "file-status-cache";
+    auto const& value        = node[key];
+    config.file_status_cache = load_file_status_cache(value);
+  }
+
+  {
+    auto const key    = "access-log";
+    auto const& value = node[key];
+    config.access_log = load_access_log(value);
+  }
+
   return config;
 }
 
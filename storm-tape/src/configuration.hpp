@@ -6,6 +6,8 @@
 #define STORM_CONFIGURATION_HPP
 
 #include "types.hpp"
+#include <chrono>
+#include <cstdint>
 #include <iosfwd>
 #include <optional>
 #include <string>
@@ -20,10 +22,128 @@ struct StorageArea
   LogicalPaths access_points;
 };
 
+// what is traced: nothing, only the requests served by the routes, or also
+// the functions called while serving them
+enum class TracingLevel : unsigned char
+{
+  off,
+  request,
+  full
+};
+
 struct TelemetryConfiguration
 {
   std::string service_name = "storm-tape";
   std::string tracing_endpoint;
+  TracingLevel tracing_level = TracingLevel::full;
+};
+
+// SQLite settings, applied to every session of the connection pool
+struct DatabaseConfiguration
+{
+  fs::path path            = "storm-tape.sqlite";
+  std::string journal_mode = "WAL";
+  std::string synchronous  = "NORMAL";
+  // bytes of the database file mapped in memory
+  std::int64_t mmap_size = 256 * 1024 * 1024;
+  // KiB of page cache per session
+  std::int64_t cache_size = 64 * 1024;
+  // how long a session waits for a lock held by another session
+  std::chrono::milliseconds busy_timeout{5'000};
+  // how long an operation waits for a session of the pool to be available
+  std::chrono::milliseconds lease_timeout{30'000};
+};
+
+// database writes are applied by a single thread, many per transaction
+struct GroupCommitConfiguration
+{
+  std::size_t max_batch_size = 256;
+  // how long the first write of a batch can wait for others to join it
+  std::chrono::milliseconds max_batch_latency{1};
+  // the writes waiting to be applied; when full, new writes wait
+  std::size_t queue_capacity = 4'096;
+};
+
+// the most recently used stages are kept in memory
+struct StageCacheConfiguration
+{
+  // bytes
+  std::size_t memory_budget = 64 * 1024 * 1024;
+};
+
+// the files of the incomplete stages are probed in the background, so that a
+// status only reads the database
+struct ReconcilerConfiguration
+{
+  std::size_t threads = 2;
+  // how often the incomplete stages are visited
+  std::chrono::seconds interval{10};
+};
+
+// the completion of the recalls is detected from the inotify events of the
+// directories containing the started files
+struct RecallWatcherConfiguration
+{
+  // maximum number of directories watched at the same time
+  std::size_t max_directories = 8192;
+  // maximum number of files watched at the same time
+  std::size_t max_files = 1'000'000;
+};
+
+// the loops over the files of a request can run in parallel, on a pool of
+// threads shared by the whole process
+struct ParallelismConfiguration
+{
+  struct Operation
+  {
+    // the maximum number of threads of the pool working on the operation at
+    // the same time; 0 means all of them
+    std::size_t threads = 0;
+    // a request is served in parallel if it has more files than a task takes
+    std::size_t files_per_task = 1'000;
+  };
+  // the size of the pool
+  std::size_t threads = 4;
+  Operation status;
+  Operation stage;
+  Operation archive_info;
+  Operation take_over;
+};
+
+// the storage is probed through io_uring, many operations per submission
+struct IoUringConfiguration
+{
+  // the number of entries of the submission queue of each ring
+  unsigned queue_depth = 256;
+};
+
+// the files are probed relative to their directory, which is kept open
+struct DirectoryProbingConfiguration
+{
+  // the maximum number of directories kept open
+  std::size_t max_open_directories = 64;
+};
+
+// the probes of the files are kept in memory for a short time, shared by all
+// the requests
+struct FileStatusCacheConfiguration
+{
+  // how long a probe is valid
+  std::chrono::milliseconds ttl{2'000};
+  // the maximum number of files remembered
+  std::size_t max_files = 1'000'000;
+};
+
+// the access log is written by a background thread, which collects the records
+// buffered by the threads serving the requests
+struct AccessLogConfiguration
+{
+  // if empty, the standard output
+  fs::path file;
+  // the records buffered per thread; when full, new records are dropped
+  std::size_t buffer_size = 4'096;
+  // how often the buffered records are written
+  std::chrono::milliseconds flush_interval{100};
 };
 
 using StorageAreas = std::vector<StorageArea>;
@@ -39,6 +159,21 @@ struct Configuration
   bool mirror_mode                                = false;
   std::optional<TelemetryConfiguration> telemetry = std::nullopt;
   int concurrency                                 = 1;
+  DatabaseConfiguration database;
+  std::optional<GroupCommitConfiguration> group_commit = std::nullopt;
+  std::optional<StageCacheConfiguration> stage_cache   = std::nullopt;
+  // if not set, a status probes the files of the stage on demand
+  std::optional<ReconcilerConfiguration> reconciler        = std::nullopt;
+  std::optional<RecallWatcherConfiguration> recall_watcher = std::nullopt;
+  // if not set, the loops are sequential
+  std::optional<ParallelismConfiguration> parallelism = std::nullopt;
+  // if not set, the storage is probed with plain syscalls
+  std::optional<IoUringConfiguration> io_uring = std::nullopt;
+  // if not set, the storage is probed by absolute path
+  std::optional<DirectoryProbingConfiguration> directory_probing = std::nullopt;
+  // if not set, every request probes the storage
+  std::optional<FileStatusCacheConfiguration> file_status_cache = std::nullopt;
+  AccessLogConfiguration access_log;
 };
 
 Configuration load_configuration(std::istream& is);
@@ -72,6 +72,9 @@ class Database
   virtual bool update(StageUpdate const& stage_update)              = 0;
   virtual bool erase(StageId const& id)                             = 0;
   virtual std::size_t count_files(File::State state) const          = 0;
+  // the number of stages having the file at path in the given state
+  virtual std::size_t count_stages(PhysicalPath const& path,
+                                   File::State state) const         = 0;
   virtual PhysicalPaths get_files(File::State state,
                                   std::size_t n_files) const        = 0;
 };
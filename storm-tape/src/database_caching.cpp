@@ -0,0 +1,367 @@
+// SPDX-FileCopyrightText: 2025 Istituto Nazionale di Fisica Nucleare
+//
+// SPDX-License-Identifier: EUPL-1.2
+
+#include "database_caching.hpp"
+#include "trace_span.hpp"
+
+#include <boost/assert.hpp>
+#include <algorithm>
+#include <functional>
+
+namespace storm {
+
+namespace {
+
+// an estimate of the memory taken by a cached stage, including the nodes of
+// the containers that refer to it
+std::size_t footprint(StageId const& id, StageRequest const& stage)
+{
+  constexpr std::size_t node_overhead{4 * sizeof(void*)};
+  auto result = sizeof(StageRequest) + 2 * (id.capacity() + node_overhead)
+              + stage.files.capacity() * sizeof(File);
+  for (auto const& file : stage.files) {
+    result += file.logical_path.native().capacity()
+            + file.physical_path.native().capacity() + node_overhead;
+  }
+  return result;
+}
+
+// the files of a stage are kept in the same order as the database returns
+// them, i.e. by logical path as a string
+bool by_logical_path(File const& f1, File const& f2)
+{
+  return f1.logical_path.native() < f2.logical_path.native();
+}
+
+File* find_file(StageRequest& stage, LogicalPath const& path)
+{
+  auto& files = stage.files;
+  auto it     = std::lower_bound(files.begin(), files.end(), path.native(),
+                                 [](File const& file, std::string const& p) {
+                                   return file.logical_path.native() < p;
+                                 });
+  return it != files.end() && it->logical_path.native() == path.native()
+           ? &*it
+           : nullptr;
+}
+
+// the same transitions as the updates of SociDatabase
+void set_state(File& file, File::State state, TimePoint tp)
+{
+  switch (state) {
+  case File::State::started:
+    file.state      = state;
+    file.started_at = tp;
+    break;
+  case File::State::completed:
+  case File::State::cancelled:
+  case File::State::failed:
+    file.state = state;
+    if (file.started_at == 0) {
+      file.started_at = tp;
+    }
+    file.finished_at = tp;
+    break;
+  case File::State::submitted:
+    // this transition is not foreseen, ignore
+    break;
+  }
+}
+
+// an update by physical path only moves a file forward
+bool can_move(File::State from, File::State to)
+{
+  switch (to) {
+  case File::State::started:
+    return from == File::State::submitted;
+  case File::State::completed:
+  case File::State::cancelled:
+  case File::State::failed:
+    return from == File::State::submitted || from == File::State::started;
+  case File::State::submitted:
+    return false;
+  }
+  return false;
+}
+
+} // namespace
+
+CachingDatabase::CachingDatabase(Database& db,
+                                 StageCacheConfiguration const& config)
+    : m_db{db}
+    , m_shard_budget{config.memory_budget / n_shards}
+{}
+
+CachingDatabase::Stats CachingDatabase::stats() const
+{
+  return {m_hits.load(), m_misses.load(), m_evictions.load()};
+}
+
+CachingDatabase::Shard& CachingDatabase::shard(StageId const& id) const
+{
+  return m_shards[std::hash<StageId>{}(id) % n_shards];
+}
+
+// to be called with the lock of the shard held
+void CachingDatabase::put(Shard& shard, StageId const& id,
+                          StageRequest stage) const
+{
+  auto const size = footprint(id, stage);
+  if (size > m_shard_budget) {
+    return;
+  }
+
+  while (shard.size + size > m_shard_budget) {
+    BOOST_ASSERT(!shard.lru.empty());
+    erase(shard, shard.entries.find(shard.lru.back()));
+    ++m_evictions;
+  }
+
+  shard.lru.push_front(id);
+  auto [it, inserted] = shard.entries.emplace(
+      id, Entry{std::move(stage), size, shard.lru.begin()});
+  BOOST_ASSERT(inserted);
+  for (auto& file : it->second.stage.files) {
+    shard.files.emplace(file.physical_path.native(), &file);
+  }
+  shard.size += size;
+}
+
+// to be called with the lock of the shard held
+void CachingDatabase::erase(
+    Shard& shard, std::unordered_map<StageId, Entry>::iterator it) const
+{
+  auto& entry = it->second;
+  for (auto& file : entry.stage.files) {
+    auto [first, last] = shard.files.equal_range(file.physical_path.native());
+    auto const f       = std::find_if(
+        first, last, [&](auto const& e) { return e.second == &file; });
+    BOOST_ASSERT(f != last);
+    shard.files.erase(f);
+  }
+  shard.size -= entry.size;
+  shard.lru.erase(entry.lru);
+  shard.entries.erase(it);
+}
+
+// apply f to the cached files, in any stage, that have the physical path of
+// one of the items
+template<typename Items, typename Proj, typename F>
+void CachingDatabase::update_files(Items const& items, Proj proj, F f)
+{
+  for (auto& shard : m_shards) {
+    std::lock_guard lock{shard.mutex};
+    ++shard.generation;
+    if (shard.files.empty()) {
+      continue;
+    }
+    for (auto const& item : items) {
+      PhysicalPath const& path = proj(item);
+      auto [first, last]       = shard.files.equal_range(path.native());
+      std::for_each(first, last, [&](auto const& e) { f(*e.second, item); });
+    }
+  }
+}
+
+bool CachingDatabase::insert(StageId const& id, StageRequest const& stage)
+{
+  TRACE_FUNCTION();
+  if (!m_db.insert(id, stage)) {
+    return false;
+  }
+
+  auto copy = stage;
+  std::sort(copy.files.begin(), copy.files.end(), by_logical_path);
+  auto& s = shard(id);
+  std::lock_guard lock{s.mutex};
+  ++s.generation;
+  put(s, id, std::move(copy));
+  return true;
+}
+
+std::optional<StageRequest> CachingDatabase::find(StageId const& id) const
+{
+  TRACE_FUNCTION();
+  auto& s = shard(id);
+  std::uint64_t generation{};
+  {
+    std::lock_guard lock{s.mutex};
+    if (auto it = s.entries.find(id); it != s.entries.end()) {
+      ++m_hits;
+      s.lru.splice(s.lru.begin(), s.lru, it->second.lru);
+      return it->second.stage;
+    }
+    generation = s.generation;
+  }
+
+  ++m_misses;
+  auto result = m_db.find(id);
+  if (result.has_value()) {
+    std::lock_guard lock{s.mutex};
+    // another thread may have cached it in the meantime
+    if (s.generation == generation && !s.entries.contains(id)) {
+      put(s, id, *result);
+    }
+  }
+  return result;
+}
+
+std::vector<StageId> CachingDatabase::find_incomplete_stages() const
+{
+  TRACE_FUNCTION();
+  return m_db.find_incomplete_stages();
+}
+
+bool CachingDatabase::update(StageId const& id, LogicalPath const& path,
+                             File::State state)
+{
+  TRACE_FUNCTION();
+  if (!m_db.update(id, path, state)) {
+    return false;
+  }
+
+  auto& s = shard(id);
+  std::lock_guard lock{s.mutex};
+  ++s.generation;
+  if (auto it = s.entries.find(id); it != s.entries.end()) {
+    if (auto file = find_file(it->second.stage, path); file != nullptr) {
+      file->state = state;
+    }
+  }
+  return true;
+}
+
+bool CachingDatabase::update(StageId const& id, LogicalPath const& path,
+                             File::State state, TimePoint tp)
+{
+  TRACE_FUNCTION();
+  return update(id, std::span{&path, 1}, state, tp);
+}
+
+bool CachingDatabase::update(PhysicalPath const& path, File::State state,
+                             TimePoint tp)
+{
+  TRACE_FUNCTION();
+  return update(std::span{&path, 1}, state, tp);
+}
+
+bool CachingDatabase::update(StageId const& id,
+                             std::span<LogicalPath const> paths,
+                             File::State state, TimePoint tp)
+{
+  TRACE_FUNCTION();
+  if (!m_db.update(id, paths, state, tp)) {
+    return false;
+  }
+
+  auto& s = shard(id);
+  std::lock_guard lock{s.mutex};
+  ++s.generation;
+  if (auto it = s.entries.find(id); it != s.entries.end()) {
+    for (auto const& path : paths) {
+      if (auto file = find_file(it->second.stage, path); file != nullptr) {
+        set_state(*file, state, tp);
+      }
+    }
+  }
+  return true;
+}
+
+bool CachingDatabase::update(std::span<PhysicalPath const> paths,
+                             File::State state, TimePoint tp)
+{
+  TRACE_FUNCTION();
+  if (!m_db.update(paths, state, tp)) {
+    return false;
+  }
+
+  update_files(
+      paths, [](PhysicalPath const& path) -> auto const& { return path; },
+      [&](File& file, PhysicalPath const&) {
+        if (can_move(file.state, state)) {
+          set_state(file, state, tp);
+        }
+      });
+  return true;
+}
+
+bool CachingDatabase::update(
+    std::span<std::pair<PhysicalPath, File::State>> path_states, TimePoint tp)
+{
+  return update(StageUpdate{std::nullopt, path_states, tp});
+}
+
+bool CachingDatabase::update(StageEntity const& entity)
+{
+  return update(StageUpdate{entity, {}, 0});
+}
+
+bool CachingDatabase::update(StageUpdate const& stage_update)
+{
+  TRACE_FUNCTION();
+  if (!m_db.update(stage_update)) {
+    return false;
+  }
+
+  if (auto const& entity = stage_update.stage; entity.has_value()) {
+    auto& s = shard(entity->id);
+    std::lock_guard lock{s.mutex};
+    ++s.generation;
+    if (auto it = s.entries.find(entity->id); it != s.entries.end()) {
+      auto& stage        = it->second.stage;
+      stage.created_at   = entity->created_at;
+      stage.started_at   = entity->started_at;
+      stage.completed_at = entity->completed_at;
+    }
+  }
+
+  auto const tp = stage_update.tp;
+  update_files(
+      stage_update.files,
+      [](auto const& path_state) -> auto const& { return path_state.first; },
+      [&](File& file, auto const& path_state) {
+        if (can_move(file.state, path_state.second)) {
+          set_state(file, path_state.second, tp);
+        }
+      });
+  return true;
+}
+
+bool CachingDatabase::erase(StageId const& id)
+{
+  TRACE_FUNCTION();
+  if (!m_db.erase(id)) {
+    return false;
+  }
+
+  auto& s = shard(id);
+  std::lock_guard lock{s.mutex};
+  ++s.generation;
+  if (auto it = s.entries.find(id); it != s.entries.end()) {
+    erase(s, it);
+  }
+  return true;
+}
+
+std::size_t CachingDatabase::count_files(File::State state) const
+{
+  TRACE_FUNCTION();
+  return m_db.count_files(state);
+}
+
+std::size_t CachingDatabase::count_stages(PhysicalPath const& path,
+                                          File::State state) const
+{
+  TRACE_FUNCTION();
+  return m_db.count_stages(path, state);
+}
+
+PhysicalPaths CachingDatabase::get_files(File::State state,
+                                         std::size_t n_files) const
+{
+  TRACE_FUNCTION();
+  return m_db.get_files(state, n_files);
+}
+
+} // namespace storm
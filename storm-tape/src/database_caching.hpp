@@ -0,0 +1,109 @@
+// SPDX-FileCopyrightText: 2025 Istituto Nazionale di Fisica Nucleare
+//
+// SPDX-License-Identifier: EUPL-1.2
+
+#ifndef STORM_DATABASE_CACHING_HPP
+#define STORM_DATABASE_CACHING_HPP
+
+#include "configuration.hpp"
+#include "database.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+
+namespace storm {
+
+// A Database that keeps the most recently used stages in memory, within a
+// memory budget. All the writes go through it and are applied also to the
+// cached stages, so that a cached stage is always the same as the one stored
+// in the underlying database and a find that hits the cache does not run any
+// query. The writes of the underlying database must be committed when they
+// return, so it cannot be a GroupCommitDatabase.
+class CachingDatabase : public Database
+{
+ public:
+  struct Stats
+  {
+    std::size_t hits;
+    std::size_t misses;
+    std::size_t evictions;
+  };
+
+ private:
+  struct Entry
+  {
+    StageRequest stage;
+    std::size_t size;
+    std::list<StageId>::iterator lru;
+  };
+
+  // The stages are partitioned in shards, each with its own lock and LRU list
+  struct Shard
+  {
+    std::mutex mutex;
+    // the most recently used stage is at the front
+    std::list<StageId> lru;
+    std::unordered_map<StageId, Entry> entries;
+    // the cached files by physical path, for the updates by physical path
+    std::unordered_multimap<std::string_view, File*> files;
+    std::size_t size{0};
+    // incremented by every write; a stage read from the underlying database is
+    // cached only if no write has happened in the meantime
+    std::uint64_t generation{0};
+  };
+
+  static constexpr std::size_t n_shards{16};
+
+  Database& m_db;
+  std::size_t m_shard_budget;
+  mutable std::array<Shard, n_shards> m_shards;
+  mutable std::atomic<std::size_t> m_hits{0};
+  mutable std::atomic<std::size_t> m_misses{0};
+  mutable std::atomic<std::size_t> m_evictions{0};
+
+  Shard& shard(StageId const& id) const;
+  void put(Shard& shard, StageId const& id, StageRequest stage) const;
+  void erase(Shard& shard,
+             std::unordered_map<StageId, Entry>::iterator it) const;
+  template<typename Items, typename Proj, typename F>
+  void update_files(Items const& items, Proj proj, F f);
+
+  bool update(std::span<std::pair<PhysicalPath, File::State>> path_states,
+              TimePoint tp) override;
+  bool update(StageEntity const& entity) override;
+
+ public:
+  CachingDatabase(Database& db, StageCacheConfiguration const& config);
+
+  Stats stats() const;
+
+  bool insert(StageId const& id, StageRequest const& stage) override;
+  std::optional<StageRequest> find(StageId const& id) const override;
+  std::vector<StageId> find_incomplete_stages() const override;
+  bool update(StageId const& id, LogicalPath const& path,
+              File::State state) override;
+  bool update(StageId const& id, LogicalPath const& path, File::State state,
+              TimePoint tp) override;
+  bool update(PhysicalPath const& path, File::State state,
+              TimePoint tp) override;
+  bool update(StageId const& id, std::span<LogicalPath const> paths,
+              File::State state, TimePoint tp) override;
+  bool update(std::span<PhysicalPath const> paths, File::State state,
+              TimePoint tp) override;
+  bool update(StageUpdate const& stage_update) override;
+  bool erase(StageId const& id) override;
+  std::size_t count_files(File::State state) const override;
+  std::size_t count_stages(PhysicalPath const& path,
+                           File::State state) const override;
+  PhysicalPaths get_files(File::State state,
+                          std::size_t n_files) const override;
+};
+
+} // namespace storm
+
+#endif
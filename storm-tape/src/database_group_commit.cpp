@@ -0,0 +1,267 @@
+// SPDX-FileCopyrightText: 2025 Istituto Nazionale di Fisica Nucleare
+//
+// SPDX-License-Identifier: EUPL-1.2
+
+#include "database_group_commit.hpp"
+#include "database_soci.hpp"
+#include "trace_span.hpp"
+
+#include <crow/logging.h>
+#include <fmt/core.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+namespace storm {
+
+GroupCommitDatabase::GroupCommitDatabase(SociDatabase& db,
+                                         GroupCommitConfiguration config)
+    : m_db{db}
+    , m_config{config}
+    , m_writer{[this] { run(); }}
+{}
+
+GroupCommitDatabase::~GroupCommitDatabase()
+{
+  // an empty intent stops the writer, after the intents queued before it have
+  // been committed
+  push(nullptr);
+}
+
+// wait while the queue is full
+void GroupCommitDatabase::push(IntentPtr intent)
+{
+  {
+    std::unique_lock lock{m_queue_mutex};
+    m_not_full.wait(
+        lock, [this] { return m_queue.size() < m_config.queue_capacity; });
+    m_queue.push_back(std::move(intent));
+  }
+  m_not_empty.notify_one();
+}
+
+std::future<bool>
+GroupCommitDatabase::enqueue(std::function<bool(SociDatabase&)> apply)
+{
+  auto intent = std::make_unique<Intent>(Intent{std::move(apply), {}});
+  auto result = intent->done.get_future();
+  push(std::move(intent));
+  return result;
+}
+
+bool GroupCommitDatabase::write(std::function<bool(SociDatabase&)> apply)
+{
+  return enqueue(std::move(apply)).get();
+}
+
+// Wait for the writes queued by the calling thread to be committed, so that it
+// reads them. The queue is FIFO, so it is enough to wait for the last one. The
+// writes of the other threads are not waited for.
+void GroupCommitDatabase::sync() const
+{
+  std::shared_future<bool> ticket;
+  {
+    std::lock_guard lock{m_mutex};
+    auto it = m_tickets.find(std::this_thread::get_id());
+    if (it == m_tickets.end()) {
+      return;
+    }
+    ticket = std::move(it->second);
+    m_tickets.erase(it);
+  }
+  ticket.wait();
+}
+
+void GroupCommitDatabase::run()
+{
+  using Clock = std::chrono::steady_clock;
+
+  std::vector<IntentPtr> batch;
+  batch.reserve(m_config.max_batch_size);
+  // a batch cannot wait for more intents than the queue can hold
+  auto const full_size =
+      std::min(m_config.max_batch_size, m_config.queue_capacity);
+  bool stop{false};
+
+  while (!stop) {
+    {
+      std::unique_lock lock{m_queue_mutex};
+      m_not_empty.wait(lock, [this] { return !m_queue.empty(); });
+
+      // let other intents join the batch, until it is full or its first
+      // intent has waited long enough
+      auto const deadline = Clock::now() + m_config.max_batch_latency;
+      m_not_empty.wait_until(lock, deadline, [&] {
+        return m_queue.size() >= full_size || m_queue.back() == nullptr;
+      });
+
+      while (!m_queue.empty() && batch.size() != m_config.max_batch_size) {
+        auto intent = std::move(m_queue.front());
+        m_queue.pop_front();
+        if (intent == nullptr) {
+          stop = true;
+          break;
+        }
+        batch.push_back(std::move(intent));
+      }
+    }
+    m_not_full.notify_all();
+
+    if (!batch.empty()) {
+      commit(batch);
+      batch.clear();
+    }
+  }
+}
+
+// Apply a batch of intents in a single transaction. Each intent is applied in a
+// nested transaction, rolled back if the intent fails or throws, so that a
+// failing one leaves no partial changes and does not affect the others.
+void GroupCommitDatabase::commit(std::vector<IntentPtr>& batch)
+{
+  std::vector<char> results(batch.size(), false);
+
+  try {
+    auto tr = m_db.transaction();
+    for (std::size_t i{0}; i != batch.size(); ++i) {
+      try {
+        auto nested = m_db.transaction();
+        results[i]  = batch[i]->apply(m_db);
+        if (results[i]) {
+          nested.commit();
+        }
+      } catch (std::exception const& e) {
+        CROW_LOG_ERROR << fmt::format("Database write failed: {}", e.what());
+      }
+    }
+    tr.commit();
+  } catch (soci::soci_error const& e) {
+    std::cerr << "Soci error: " << e.what() << '\n';
+    std::fill(results.begin(), results.end(), false);
+  }
+
+  CROW_LOG_DEBUG << fmt::format("Committed {} database writes", batch.size());
+
+  for (std::size_t i{0}; i != batch.size(); ++i) {
+    batch[i]->done.set_value(results[i] != 0);
+  }
+}
+
+bool GroupCommitDatabase::insert(StageId const& id, StageRequest const& stage)
+{
+  TRACE_FUNCTION();
+  return write([&](SociDatabase& db) { return db.insert(id, stage); });
+}
+
+std::optional<StageRequest> GroupCommitDatabase::find(StageId const& id) const
+{
+  TRACE_FUNCTION();
+  sync();
+  return m_db.find(id);
+}
+
+std::vector<StageId> GroupCommitDatabase::find_incomplete_stages() const
+{
+  TRACE_FUNCTION();
+  sync();
+  return m_db.find_incomplete_stages();
+}
+
+bool GroupCommitDatabase::update(StageId const& id, LogicalPath const& path,
+                                 File::State state)
+{
+  TRACE_FUNCTION();
+  return write(
+      [&](SociDatabase& db) { return db.update(id, path, state); });
+}
+
+bool GroupCommitDatabase::update(StageId const& id, LogicalPath const& path,
+                                 File::State state, TimePoint tp)
+{
+  TRACE_FUNCTION();
+  return write(
+      [&](SociDatabase& db) { return db.update(id, path, state, tp); });
+}
+
+bool GroupCommitDatabase::update(PhysicalPath const& path, File::State state,
+                                 TimePoint tp)
+{
+  TRACE_FUNCTION();
+  return write([&](SociDatabase& db) { return db.update(path, state, tp); });
+}
+
+bool GroupCommitDatabase::update(StageId const& id,
+                                 std::span<LogicalPath const> paths,
+                                 File::State state, TimePoint tp)
+{
+  TRACE_FUNCTION();
+  return write(
+      [&](SociDatabase& db) { return db.update(id, paths, state, tp); });
+}
+
+bool GroupCommitDatabase::update(std::span<PhysicalPath const> paths,
+                                 File::State state, TimePoint tp)
+{
+  TRACE_FUNCTION();
+  return write(
+      [&](SociDatabase& db) { return db.update(paths, state, tp); });
+}
+
+bool GroupCommitDatabase::update(
+    std::span<std::pair<PhysicalPath, File::State>> path_states, TimePoint tp)
+{
+  return update(StageUpdate{std::nullopt, path_states, tp});
+}
+
+bool GroupCommitDatabase::update(StageEntity const& entity)
+{
+  return update(StageUpdate{entity, {}, 0});
+}
+
+// A status update reflects the state of the storage, which the next status
+// would find again, so the caller does not wait for it, until it reads. The
+// files are copied, since they outlive the call.
+bool GroupCommitDatabase::update(StageUpdate const& stage_update)
+{
+  TRACE_FUNCTION();
+  std::vector<std::pair<PhysicalPath, File::State>> files(
+      stage_update.files.begin(), stage_update.files.end());
+  auto ticket = enqueue([stage = stage_update.stage, files = std::move(files),
+                         tp = stage_update.tp](SociDatabase& db) mutable {
+    return db.update(StageUpdate{stage, files, tp});
+  });
+  std::lock_guard lock{m_mutex};
+  m_tickets.insert_or_assign(std::this_thread::get_id(), ticket.share());
+  return true;
+}
+
+bool GroupCommitDatabase::erase(StageId const& id)
+{
+  TRACE_FUNCTION();
+  return write([&](SociDatabase& db) { return db.erase(id); });
+}
+
+std::size_t GroupCommitDatabase::count_files(File::State state) const
+{
+  TRACE_FUNCTION();
+  sync();
+  return m_db.count_files(state);
+}
+
+std::size_t GroupCommitDatabase::count_stages(PhysicalPath const& path,
+                                              File::State state) const
+{
+  TRACE_FUNCTION();
+  sync();
+  return m_db.count_stages(path, state);
+}
+
+PhysicalPaths GroupCommitDatabase::get_files(File::State state,
+                                             std::size_t n_files) const
+{
+  TRACE_FUNCTION();
+  sync();
+  return m_db.get_files(state, n_files);
+}
+
+} // namespace storm
@@ -0,0 +1,95 @@
+// SPDX-FileCopyrightText: 2025 Istituto Nazionale di Fisica Nucleare
+//
+// SPDX-License-Identifier: EUPL-1.2
+
+#ifndef STORM_DATABASE_GROUP_COMMIT_HPP
+#define STORM_DATABASE_GROUP_COMMIT_HPP
+
+#include "configuration.hpp"
+#include "database.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace storm {
+
+class SociDatabase;
+
+// A Database that applies all the writes from a single thread, committing
+// many of them in the same transaction. The callers of the writes whose
+// outcome is needed before responding wait for their batch to be committed;
+// the status updates are instead just queued. Reads are served directly by the
+// underlying database, after the status updates queued by the same thread
+// have been committed. When the queue is full, the writers wait.
+class GroupCommitDatabase : public Database
+{
+  struct Intent
+  {
+    std::function<bool(SociDatabase&)> apply;
+    std::promise<bool> done;
+  };
+  using IntentPtr = std::unique_ptr<Intent>;
+
+  SociDatabase& m_db;
+  GroupCommitConfiguration m_config;
+  std::mutex m_queue_mutex;
+  std::condition_variable m_not_empty;
+  std::condition_variable m_not_full;
+  std::deque<IntentPtr> m_queue;
+  mutable std::mutex m_mutex;
+  // the last write queued by each thread without waiting for it
+  mutable std::unordered_map<std::thread::id, std::shared_future<bool>>
+      m_tickets;
+  std::jthread m_writer;
+
+  void push(IntentPtr intent);
+  std::future<bool> enqueue(std::function<bool(SociDatabase&)> apply);
+  bool write(std::function<bool(SociDatabase&)> apply);
+  void sync() const;
+  void run();
+  void commit(std::vector<IntentPtr>& batch);
+
+  bool update(std::span<std::pair<PhysicalPath, File::State>> path_states,
+              TimePoint tp) override;
+  bool update(StageEntity const& entity) override;
+
+ public:
+  GroupCommitDatabase(SociDatabase& db, GroupCommitConfiguration config);
+  ~GroupCommitDatabase() override;
+  GroupCommitDatabase(GroupCommitDatabase const&)            = delete;
+  GroupCommitDatabase& operator=(GroupCommitDatabase const&) = delete;
+  GroupCommitDatabase(GroupCommitDatabase&&)                 = delete;
+  GroupCommitDatabase& operator=(GroupCommitDatabase&&)      = delete;
+
+  bool insert(StageId const& id, StageRequest const& stage) override;
+  std::optional<StageRequest> find(StageId const& id) const override;
+  std::vector<StageId> find_incomplete_stages() const override;
+  bool update(StageId const& id, LogicalPath const& path,
+              File::State state) override;
+  bool update(StageId const& id, LogicalPath const& path, File::State state,
+              TimePoint tp) override;
+  bool update(PhysicalPath const& path, File::State state,
+              TimePoint tp) override;
+  bool update(StageId const& id, std::span<LogicalPath const> paths,
+              File::State state, TimePoint tp) override;
+  bool update(std::span<PhysicalPath const> paths, File::State state,
+              TimePoint tp) override;
+  bool update(StageUpdate const& stage_update) override;
+  bool erase(StageId const& id) override;
+  std::size_t count_files(File::State state) const override;
+  std::size_t count_stages(PhysicalPath const& path,
+                           File::State state) const override;
+  PhysicalPaths get_files(File::State state,
+                          std::size_t n_files) const override;
+};
+
+} // namespace storm
+
+#endif
@@ -3,114 +3,273 @@
 // SPDX-License-Identifier: EUPL-1.2
 
 #include "database_soci.hpp"
+#include "configuration.hpp"
 #include "io.hpp"
+#include "statement_cache.hpp"
 #include "trace_span.hpp"
+#include <boost/algorithm/string/predicate.hpp>
 #include <crow/logging.h>
+#include <soci/sqlite3/soci-sqlite3.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <iostream>
+#include <string_view>
+#include <utility>
 
-namespace soci {
+namespace storm {
+
+// maximum number of rows bound at once to a bulk statement
+static constexpr std::size_t bulk_size{1'000};
 
-template<>
-struct type_conversion<storm::StageEntity>
+struct SociDatabase::Connection
 {
-  using base_type = soci::values;
-  static void from_base(const soci::values& v, soci::indicator,
-                        storm::StageEntity& req)
-  {
-    req.id = v.get<storm::StageId>("id");
+  soci::session& sql;
+  std::size_t position;
+  StatementCache statements{sql};
+  // the leases held on the session by the thread using it
+  std::size_t n_leases{0};
+};
 
-    req.created_at   = v.get<storm::TimePoint>("created_at");
-    req.started_at   = v.get<storm::TimePoint>("started_at");
-    req.completed_at = v.get<storm::TimePoint>("completed_at");
+void open_session(soci::session& sql, DatabaseConfiguration const& config)
+{
+  sql.open(soci::sqlite3, config.path.string());
+
+  // the busy timeout comes first, switching to WAL may need a lock
+  sql << fmt::format("PRAGMA busy_timeout = {};", config.busy_timeout.count());
+
+  // journal_mode returns the mode actually in use, e.g. an in-memory database
+  // stays in MEMORY mode
+  std::string journal_mode;
+  sql << fmt::format("PRAGMA journal_mode = {};", config.journal_mode),
+      soci::into(journal_mode);
+  if (!boost::iequals(journal_mode, config.journal_mode)) {
+    CROW_LOG_WARNING << fmt::format(
+        "SQLite journal mode is '{}' instead of '{}'", journal_mode,
+        config.journal_mode);
   }
 
-  static void to_base(const storm::StageEntity& req, soci::values& v,
-                      soci::indicator& ind)
-  {
-    v.set("id", req.id);
-    v.set("created_at", req.created_at);
-    v.set("started_at", req.started_at);
-    v.set("completed_at", req.completed_at);
-    ind = i_ok;
-  }
-};
+  sql << fmt::format("PRAGMA synchronous = {};", config.synchronous);
+  sql << fmt::format("PRAGMA mmap_size = {};", config.mmap_size);
+  // a negative value is interpreted by SQLite as KiB rather than pages
+  sql << fmt::format("PRAGMA cache_size = -{};", config.cache_size);
+}
 
-template<>
-struct type_conversion<storm::FileEntity>
+// The number of distinct physical paths of the submitted files, polled by the
+// readyTakeOver API, is kept up to date by triggers, within the same
+// transaction that changes the File table. SubmittedPath counts the submitted
+// files for each physical path and Counter holds the number of its rows.
+static void create_submitted_counter(soci::session& sql)
 {
-  using base_type = values;
-  static void from_base(const soci::values& v, soci::indicator,
-                        storm::FileEntity& file)
-  {
-    file.stage_id      = v.get<storm::StageId>("stage_id");
-    file.logical_path  = v.get<storm::Filename>("logical_path");
-    file.physical_path = v.get<storm::Filename>("physical_path");
-    file.state         = static_cast<storm::File::State>(v.get<int>("state"));
-    file.locality      = storm::Locality::unavailable;
-    file.started_at    = v.get<storm::TimePoint>("started_at");
-    file.finished_at   = v.get<storm::TimePoint>("finished_at");
+  // the triggers rely on the value of the submitted state
+  static_assert(to_underlying(File::State::submitted) == 0);
+
+  soci::transaction tr{sql};
+  sql << "CREATE TABLE IF NOT EXISTS SubmittedPath ("
+         "physical_path TEXT    PRIMARY KEY,"
+         "n             INTEGER NOT NULL) WITHOUT ROWID;";
+  sql << "CREATE TABLE IF NOT EXISTS Counter ("
+         "name  TEXT    PRIMARY KEY,"
+         "value INTEGER NOT NULL) WITHOUT ROWID;";
+
+  sql << "CREATE TRIGGER IF NOT EXISTS SubmittedPath_insert "
+         "AFTER INSERT ON SubmittedPath BEGIN "
+         "UPDATE Counter SET value = value + 1 WHERE name = 'submitted_paths'; "
+         "END;";
+  sql << "CREATE TRIGGER IF NOT EXISTS SubmittedPath_delete "
+         "AFTER DELETE ON SubmittedPath BEGIN "
+         "UPDATE Counter SET value = value - 1 WHERE name = 'submitted_paths'; "
+         "END;";
+  sql << "CREATE TRIGGER IF NOT EXISTS SubmittedPath_unused "
+         "AFTER UPDATE OF n ON SubmittedPath WHEN NEW.n = 0 BEGIN "
+         "DELETE FROM SubmittedPath WHERE physical_path = NEW.physical_path; "
+         "END;";
+
+  sql << "CREATE TRIGGER IF NOT EXISTS File_insert_submitted "
+         "AFTER INSERT ON File WHEN NEW.state = 0 BEGIN "
+         "INSERT INTO SubmittedPath VALUES (NEW.physical_path, 1) "
+         "ON CONFLICT(physical_path) DO UPDATE SET n = n + 1; "
+         "END;";
+  sql << "CREATE TRIGGER IF NOT EXISTS File_delete_submitted "
+         "AFTER DELETE ON File WHEN OLD.state = 0 BEGIN "
+         "UPDATE SubmittedPath SET n = n - 1 "
+         "WHERE physical_path = OLD.physical_path; "
+         "END;";
+  sql << "CREATE TRIGGER IF NOT EXISTS File_update_from_submitted "
+         "AFTER UPDATE OF state, physical_path ON File WHEN OLD.state = 0 "
+         "BEGIN "
+         "UPDATE SubmittedPath SET n = n - 1 "
+         "WHERE physical_path = OLD.physical_path; "
+         "END;";
+  sql << "CREATE TRIGGER IF NOT EXISTS File_update_to_submitted "
+         "AFTER UPDATE OF state, physical_path ON File WHEN NEW.state = 0 "
+         "BEGIN "
+         "INSERT INTO SubmittedPath VALUES (NEW.physical_path, 1) "
+         "ON CONFLICT(physical_path) DO UPDATE SET n = n + 1; "
+         "END;";
+
+  // rebuild the counters, the database may have been created by a previous
+  // version without them
+  sql << "DELETE FROM SubmittedPath;";
+  sql << "INSERT INTO SubmittedPath "
+         "SELECT physical_path, COUNT(*) FROM File WHERE state = 0 "
+         "GROUP BY physical_path;";
+  sql << "INSERT OR REPLACE INTO Counter VALUES ('submitted_paths', "
+         "(SELECT COUNT(*) FROM SubmittedPath));";
+  tr.commit();
+}
+
+// The stage ids are stored in their 16-byte binary form. Their string form is
+// converted in the statements, with unhex(:id, '-'), which accepts also
+// upper-case digits and hyphens anywhere; so only the canonical form, as
+// generated by UuidGenerator, is bound and any other string matches no stage.
+static bool is_canonical_stage_id(std::string_view id)
+{
+  if (id.size() != 36) {
+    return false;
+  }
+  for (std::size_t i{0}; i != id.size(); ++i) {
+    auto const c = id[i];
+    if (i == 8 || i == 13 || i == 18 || i == 23) {
+      if (c != '-') {
+        return false;
+      }
+    } else if ((c < '0' || c > '9') && (c < 'a' || c > 'f')) {
+      return false;
+    }
   }
+  return true;
+}
 
-  static void to_base(const storm::FileEntity& file, soci::values& v,
-                      soci::indicator& ind)
-  {
-    v.set("stage_id", file.stage_id);
-    v.set("logical_path", file.logical_path);
-    v.set("physical_path", file.physical_path);
-    v.set("state", storm::to_underlying(file.state));
-    using uchar = unsigned char;
-    v.set("locality", uchar{});
-    v.set("started_at", file.started_at);
-    v.set("finished_at", file.finished_at);
-    ind = i_ok;
+static bool has_text_stage_ids(soci::session& sql)
+{
+  std::string type;
+  sql << "SELECT type FROM pragma_table_info('Stage') WHERE name = 'id';",
+      soci::into(type);
+  return boost::iequals(type, "TEXT");
+}
+
+// the canonical string form of a stage id, from the hex digits of its binary
+// form
+static StageId to_stage_id(std::string_view hex)
+{
+  BOOST_ASSERT(hex.size() == 32);
+  return fmt::format("{}-{}-{}-{}-{}", hex.substr(0, 8), hex.substr(8, 4),
+                     hex.substr(12, 4), hex.substr(16, 4), hex.substr(20));
+}
+
+// Load the paths in the temporary table PathKey of the session, so that they
+// can be updated with a single statement
+template<typename Path>
+static void load_path_keys(StatementCache& statements,
+                           std::span<Path const> paths)
+{
+  std::vector<Filename> keys;
+  keys.reserve(std::min(paths.size(), bulk_size));
+  auto st = statements.bind(
+      "INSERT OR IGNORE INTO temp.PathKey VALUES (:path);", soci::use(keys));
+  for (auto first = paths.begin(); first != paths.end();) {
+    auto const last =
+        std::next(first, std::min(std::distance(first, paths.end()),
+                                  static_cast<std::ptrdiff_t>(bulk_size)));
+    keys.clear();
+    std::transform(first, last, std::back_inserter(keys),
+                   [](Path const& path) { return path.string(); });
+    st.execute(true);
+    first = last;
   }
-};
+}
 
-} // namespace soci
+// ---------------------
+// SociTransaction
 
-namespace storm {
+SociTransaction::SociTransaction(SociDatabase::Lease lease)
+    : m_lease{std::move(lease)}
+{
+  m_lease.statements().bind("SAVEPOINT storm;").execute(true);
+}
 
-std::vector<FileEntity> find_file_entities(const StageId& id,
-                                           soci::session& sql)
+SociTransaction::~SociTransaction()
 {
-  TRACE_FUNCTION();
-  size_t n_files{0};
-  std::vector<FileEntity> files{};
-  sql << "SELECT COUNT(*) FROM File WHERE stage_id = :stage_id;", soci::use(id),
-      soci::into(n_files);
+  if (m_committed) {
+    return;
+  }
+  try {
+    auto& statements = m_lease.statements();
+    statements.bind("ROLLBACK TO storm;").execute(true);
+    statements.bind("RELEASE storm;").execute(true);
+  } catch (soci::soci_error const& e) {
+    std::cerr << "Soci error: " << e.what() << '\n';
+  }
+}
+
+void SociTransaction::commit()
+{
+  m_lease.statements().bind("RELEASE storm;").execute(true);
+  m_committed = true;
+}
+
+// ---------------------
+// SociDatabase::Lease
 
-  if (n_files == 0) {
-    return files;
+SociDatabase::Lease::Lease(SociDatabase const& db)
+    : m_db{&db}
+    , m_connection{&db.acquire()}
+{}
+
+SociDatabase::Lease::~Lease()
+{
+  if (m_connection != nullptr) {
+    m_db->release(*m_connection);
   }
-  files.reserve(n_files);
+}
 
-  soci::rowset<FileEntity> const rs_f =
-      (sql.prepare << "SELECT * FROM File WHERE stage_id = :stage_id ORDER BY "
-                      "logical_path",
-       soci::use(id));
-  std::for_each(rs_f.begin(), rs_f.end(),
-                [&](auto& f) { files.push_back(std::move(f)); });
-  return files;
+SociDatabase::Lease::Lease(Lease&& other) noexcept
+    : m_db{other.m_db}
+    , m_connection{std::exchange(other.m_connection, nullptr)}
+{}
+
+StatementCache& SociDatabase::Lease::statements() const
+{
+  return m_connection->statements;
 }
 
 // ---------------------
 // SociDatabase
 
-SociDatabase::SociDatabase(soci::connection_pool& pool)
+SociDatabase::SociDatabase(soci::connection_pool& pool,
+                           std::chrono::milliseconds lease_timeout)
     : m_pool{pool}
+    , m_lease_timeout{lease_timeout}
+    , m_instance{[] {
+      static std::atomic<std::uint64_t> instances{0};
+      return ++instances;
+    }()}
 {
   // here we are still single-threaded, just use the first session
   auto& sql = m_pool.at(0);
   BOOST_ASSERT(sql.is_connected());
-  // Create Stage table
+
+  soci::transaction tr{sql};
+  // A database created by a previous version stores the stage ids as text: its
+  // tables are renamed, copied into the new ones and dropped, together with
+  // their indexes and triggers, which are then created again below
+  bool const convert_ids = has_text_stage_ids(sql);
+  if (convert_ids) {
+    CROW_LOG_INFO << "Converting the stage ids to their binary form";
+    sql << "ALTER TABLE Stage RENAME TO Stage_text;";
+    sql << "ALTER TABLE File RENAME TO File_text;";
+  }
+  // Create Stage table. The ids are time-ordered, so new stages are appended
+  // at the end of the table.
   sql << "CREATE TABLE IF NOT EXISTS Stage ("
-         "id           TEXT   PRIMARY KEY,"
+         "id           BLOB   NOT NULL PRIMARY KEY,"
          "created_at   BIGINT NOT NULL,"
          "started_at   BIGINT NOT NULL,"
-         "completed_at BIGINT NOT NULL);";
+         "completed_at BIGINT NOT NULL) WITHOUT ROWID;";
   // Create File table
   sql << "CREATE TABLE IF NOT EXISTS File ("
-         "stage_id      TEXT    NOT NULL,"
+         "stage_id      BLOB    NOT NULL,"
          "logical_path  TEXT    NOT NULL,"
          "physical_path TEXT    NOT NULL,"
          "state         INTEGER NOT NULL,"
@@ -119,42 +278,195 @@ SociDatabase::SociDatabase(soci::connection_pool& pool)
          "finished_at   BIGINT  NOT NULL,"
          "PRIMARY KEY (stage_id, logical_path),"
          "FOREIGN KEY(stage_id) REFERENCES Stage(id));";
+  if (convert_ids) {
+    sql << "INSERT INTO Stage SELECT unhex(id, '-'), created_at, started_at, "
+           "completed_at FROM Stage_text;";
+    sql << "INSERT INTO File SELECT unhex(stage_id, '-'), logical_path, "
+           "physical_path, state, locality, started_at, finished_at "
+           "FROM File_text;";
+    sql << "DROP TABLE File_text;";
+    sql << "DROP TABLE Stage_text;";
+  }
+  // Create the indexes for the queries not driven by the stage id, i.e. the
+  // take-over (state) and the recall completion (physical path) ones. They are
+  // also added to databases created by previous versions.
+  sql << "CREATE INDEX IF NOT EXISTS File_state_physical_path "
+         "ON File(state, physical_path);";
+  sql << "CREATE INDEX IF NOT EXISTS File_physical_path "
+         "ON File(physical_path);";
+  sql << "CREATE INDEX IF NOT EXISTS Stage_completed_at "
+         "ON Stage(completed_at);";
+  tr.commit();
+
+  create_submitted_counter(sql);
+}
+
+SociDatabase::~SociDatabase()
+{
+  // finalize the prepared statements; the sessions are back in the pool
+  BOOST_ASSERT(std::none_of(
+      m_connections.begin(), m_connections.end(),
+      [](auto const& connection) { return connection.second->n_leases != 0; }));
+  m_connections.clear();
+}
+
+SociDatabase::Leases& SociDatabase::thread_leases()
+{
+  static thread_local Leases leases;
+  return leases;
+}
+
+// A thread leases a session from the pool for the duration of an operation, or
+// of a transaction, so that the number of sessions bounds the concurrent
+// accesses to the database, not the threads that access it. The prepared
+// statements stay with the session, for whichever thread leases it next.
+SociDatabase::Connection& SociDatabase::acquire() const
+{
+  auto& leases = thread_leases();
+  if (auto it = std::find_if(
+          leases.begin(), leases.end(),
+          [this](auto const& lease) { return lease.first == m_instance; });
+      it != leases.end()) {
+    ++it->second->n_leases;
+    return *it->second;
+  }
+
+  std::size_t position{};
+  if (!m_pool.try_lease(position, static_cast<int>(m_lease_timeout.count()))) {
+    throw soci::soci_error{
+        fmt::format("no database session available within {}ms",
+                    m_lease_timeout.count())};
+  }
+
+  Connection* connection{};
+  {
+    std::lock_guard lock{m_mutex};
+    if (auto it = m_connections.find(position); it != m_connections.end()) {
+      connection = it->second.get();
+    }
+  }
+
+  if (connection == nullptr) {
+    auto& sql = m_pool.at(position);
+    BOOST_ASSERT(sql.is_connected());
+    CROW_LOG_DEBUG << fmt::format("SOCI session: {}\n",
+                                  static_cast<void*>(&sql));
+    try {
+      // the keys of the bulk updates; temporary tables are private to a
+      // session
+      sql << "CREATE TEMP TABLE IF NOT EXISTS PathKey ("
+             "path TEXT PRIMARY KEY) WITHOUT ROWID;";
+      sql << "CREATE TEMP TABLE IF NOT EXISTS PathState ("
+             "path  TEXT    NOT NULL,"
+             "state INTEGER NOT NULL);";
+    } catch (...) {
+      m_pool.give_back(position);
+      throw;
+    }
+    // the session is not in the map, no other thread can have leased it
+    std::lock_guard lock{m_mutex};
+    connection = m_connections
+                     .emplace(position,
+                              std::make_unique<Connection>(sql, position))
+                     .first->second.get();
+  }
+
+  connection->n_leases = 1;
+  leases.emplace_back(m_instance, connection);
+  return *connection;
+}
+
+void SociDatabase::release(Connection& connection) const noexcept
+{
+  if (--connection.n_leases != 0) {
+    return;
+  }
+  auto& leases = thread_leases();
+  std::erase_if(leases, [this](auto const& lease) {
+    return lease.first == m_instance;
+  });
+  m_pool.give_back(connection.position);
 }
 
-static soci::session& get_session(soci::connection_pool& pool)
+SociTransaction SociDatabase::transaction()
 {
-  static thread_local soci::session& session{pool.at(pool.lease())};
-  BOOST_ASSERT(session.is_connected());
-  CROW_LOG_DEBUG << fmt::format("SOCI session: {}\n",
-                                static_cast<void*>(&session));
-  return session;
+  return SociTransaction{Lease{*this}};
 }
 
 bool SociDatabase::insert(StageId const& id, StageRequest const& stage)
 {
   TRACE_FUNCTION();
-  StageEntity s_entity{id, stage.created_at, stage.started_at,
-                       stage.completed_at};
+  if (!is_canonical_stage_id(id)) {
+    return false;
+  }
 
   try {
-    auto& sql = get_session(m_pool);
-    soci::transaction tr{sql};
+    SociTransaction tr{Lease{*this}};
+    auto& statements = tr.statements();
+
+    using soci::use;
 
     // Insert stage
-    sql << "INSERT INTO Stage VALUES (:id, :created_at, :started_at, "
-           ":completed_at);",
-        soci::use(s_entity);
-
-    // Insert files
-    const auto& files = stage.files;
-    std::for_each(files.begin(), files.end(), [&](auto const& f) {
-      FileEntity const entity{id,           f.logical_path, f.physical_path,
-                              f.state,      f.locality,     f.started_at,
-                              f.finished_at};
-      sql << "INSERT INTO File VALUES (:stage_id, :logical_path, "
-             ":physical_path, :state, :locality, :started_at, :finished_at);",
-          soci::use(entity);
-    });
+    {
+      auto st = statements.bind(
+          "INSERT INTO Stage VALUES (unhex(:id, '-'), :created_at, "
+          ":started_at, :completed_at);",
+          use(id), use(stage.created_at), use(stage.started_at),
+          use(stage.completed_at));
+      st.execute(true);
+    }
+
+    // Insert files, in chunks of at most bulk_size rows, all bound to the same
+    // prepared statement
+    auto const& files = stage.files;
+    if (!files.empty()) {
+      auto const n_rows = std::min(files.size(), bulk_size);
+      std::vector<StageId> stage_ids;
+      std::vector<Filename> logical_paths;
+      std::vector<Filename> physical_paths;
+      std::vector<int> states;
+      std::vector<int> localities;
+      std::vector<TimePoint> started_ats;
+      std::vector<TimePoint> finished_ats;
+      stage_ids.reserve(n_rows);
+      logical_paths.reserve(n_rows);
+      physical_paths.reserve(n_rows);
+      states.reserve(n_rows);
+      localities.reserve(n_rows);
+      started_ats.reserve(n_rows);
+      finished_ats.reserve(n_rows);
+
+      auto st = statements.bind(
+          "INSERT INTO File VALUES (unhex(:stage_id, '-'), :logical_path, "
+          ":physical_path, :state, :locality, :started_at, :finished_at);",
+          use(stage_ids), use(logical_paths), use(physical_paths), use(states),
+          use(localities), use(started_ats), use(finished_ats));
+
+      for (auto first = files.begin(); first != files.end();) {
+        auto const last =
+            std::next(first, std::min(std::distance(first, files.end()),
+                                      static_cast<std::ptrdiff_t>(bulk_size)));
+        stage_ids.clear();
+        logical_paths.clear();
+        physical_paths.clear();
+        states.clear();
+        localities.clear();
+        started_ats.clear();
+        finished_ats.clear();
+        std::for_each(first, last, [&](File const& f) {
+          stage_ids.push_back(id);
+          logical_paths.push_back(f.logical_path.string());
+          physical_paths.push_back(f.physical_path.string());
+          states.push_back(to_underlying(f.state));
+          // the locality is not stored, see FileEntity
+          localities.push_back(0);
+          started_ats.push_back(f.started_at);
+          finished_ats.push_back(f.finished_at);
+        });
+        st.execute(true);
+        first = last;
+      }
+    }
 
     tr.commit();
   } catch (soci::soci_error const& e) {
@@ -164,47 +476,70 @@ bool SociDatabase::insert(StageId const& id, StageRequest const& stage)
   return true;
 }
 
+// The stage and its files are read with a single query, the files ordered by
+// logical path. The values fetched for each row are moved into the Files.
 std::optional<StageRequest> SociDatabase::find(StageId const& id) const
 {
   TRACE_FUNCTION();
-  StageEntity s_entity{};
-  auto& sql = get_session(m_pool);
-  sql << "SELECT * FROM Stage WHERE id = :id;", soci::into(s_entity),
-      soci::use(id);
-
-  if (s_entity.id != id) {
+  if (!is_canonical_stage_id(id)) {
     return std::nullopt;
   }
+  StageRequest stage{};
+  Filename logical_path;
+  Filename physical_path;
+  int state{};
+  TimePoint started_at{};
+  TimePoint finished_at{};
+  // the file columns are null for a stage without files
+  std::array<soci::indicator, 5> inds{};
+
+  using soci::into;
+  Lease const lease{*this};
+  auto& statements = lease.statements();
+  auto st          = statements.bind(
+      "SELECT s.created_at, s.started_at, s.completed_at, f.logical_path, "
+      "f.physical_path, f.state, f.started_at, f.finished_at "
+      "FROM Stage AS s LEFT JOIN File AS f ON f.stage_id = s.id "
+      "WHERE s.id = unhex(:id, '-') ORDER BY f.logical_path;",
+      into(stage.created_at), into(stage.started_at),
+      into(stage.completed_at), into(logical_path, inds[0]),
+      into(physical_path, inds[1]), into(state, inds[2]),
+      into(started_at, inds[3]), into(finished_at, inds[4]), soci::use(id));
+
+  if (!st.execute(true)) {
+    return std::nullopt;
+  }
+
+  if (inds[0] == soci::i_null) {
+    return stage;
+  }
 
-  const auto f_entities = find_file_entities(id, sql);
-  Files files;
-  files.reserve(f_entities.size());
-  std::transform(f_entities.begin(), f_entities.end(),
-                 std::back_inserter(files), [](auto& fe) {
-                   return File{fe.logical_path, fe.physical_path,
-                               fe.state,        fe.locality,
-                               fe.started_at,   fe.finished_at};
-                 });
+  do {
+    stage.files.push_back(File{LogicalPath{std::move(logical_path)},
+                               PhysicalPath{std::move(physical_path)},
+                               static_cast<File::State>(state),
+                               Locality::unavailable, started_at,
+                               finished_at});
+  } while (st.fetch());
 
-  return StageRequest{std::move(files), s_entity.created_at,
-                      s_entity.started_at, s_entity.completed_at};
+  return stage;
 }
 
 std::vector<StageId> SociDatabase::find_incomplete_stages() const
 {
   TRACE_FUNCTION();
-  std::size_t n_stages{0};
-  auto& sql = get_session(m_pool);
-  sql << "SELECT COUNT(*) FROM Stage WHERE completed_at = 0;",
-      soci::into(n_stages);
-
-  if (n_stages == 0) {
-    return {};
+  std::vector<StageId> result;
+  std::string hex_id;
+  Lease const lease{*this};
+  auto& statements = lease.statements();
+  auto st          = statements.bind(
+      "SELECT lower(hex(id)) FROM Stage WHERE completed_at = 0;",
+      soci::into(hex_id));
+  st.execute();
+  while (st.fetch()) {
+    result.push_back(to_stage_id(hex_id));
   }
 
-  std::vector<StageId> result(n_stages);
-  sql << "SELECT id FROM Stage WHERE completed_at = 0;", soci::into(result);
-
   // NB an incomplete stage is a stage whose files are not all in a final state;
   // in such cases the completed_at timestamp is 0. Since the DB contains stale
   // information, which is reconciled with reality only when a status is called,
@@ -219,13 +554,19 @@ bool SociDatabase::update(StageId const& id, LogicalPath const& path,
                           File::State state)
 {
   TRACE_FUNCTION();
+  if (!is_canonical_stage_id(id)) {
+    return false;
+  }
   try {
     auto const cstate = to_underlying(state);
     auto const cpath  = path.string();
-    auto& sql         = get_session(m_pool);
-    sql << "UPDATE File SET state = :state WHERE stage_id = :id AND "
-           "logical_path = :logical_path;",
-        soci::use(cstate), soci::use(id), soci::use(cpath);
+    Lease const lease{*this};
+    auto& statements = lease.statements();
+    auto st          = statements.bind(
+        "UPDATE File SET state = :state WHERE stage_id = unhex(:id, '-') AND "
+        "logical_path = :logical_path;",
+        soci::use(cstate), soci::use(id), soci::use(cpath));
+    st.execute(true);
   } catch (soci::soci_error const& e) {
     std::cerr << "Soci error: " << e.what() << '\n';
     return false;
@@ -237,27 +578,35 @@ bool SociDatabase::update(StageId const& id, LogicalPath const& path,
                           File::State state, TimePoint tp)
 {
   TRACE_FUNCTION();
+  if (!is_canonical_stage_id(id)) {
+    return false;
+  }
   try {
     auto const cstate = to_underlying(state);
     auto const cpath  = path.string();
-    auto& sql         = get_session(m_pool);
+    Lease const lease{*this};
+    auto& statements = lease.statements();
     switch (state) {
     case File::State::started: {
-      sql << "UPDATE File SET state = :state, started_at = :tp "
-             "WHERE stage_id = :id AND logical_path = :logical_path;",
-          soci::use(cstate), soci::use(tp), soci::use(id), soci::use(cpath);
+      auto st = statements.bind(
+          "UPDATE File SET state = :state, started_at = :tp "
+          "WHERE stage_id = unhex(:id, '-') AND logical_path = :logical_path;",
+          soci::use(cstate), soci::use(tp), soci::use(id), soci::use(cpath));
+      st.execute(true);
       break;
     }
     case File::State::completed:
     case File::State::cancelled:
     case File::State::failed: {
-      sql << "UPDATE File SET state = :state, "
-             "started_at = CASE WHEN started_at = 0 THEN :tp_start ELSE "
-             "started_at END, "
-             "finished_at = :tp_end "
-             "WHERE stage_id = :id AND logical_path = :logical_path;",
+      auto st = statements.bind(
+          "UPDATE File SET state = :state, "
+          "started_at = CASE WHEN started_at = 0 THEN :tp_start ELSE "
+          "started_at END, "
+          "finished_at = :tp_end "
+          "WHERE stage_id = unhex(:id, '-') AND logical_path = :logical_path;",
           soci::use(cstate), soci::use(tp), soci::use(tp), soci::use(id),
-          soci::use(cpath);
+          soci::use(cpath));
+      st.execute(true);
       break;
     }
     case File::State::submitted:
@@ -283,28 +632,33 @@ bool SociDatabase::update(PhysicalPath const& path, File::State state,
     auto const submitted_state = to_underlying(File::State::submitted);
     auto const started_state   = to_underlying(File::State::started);
     auto const cpath           = path.string();
-    auto& sql                  = get_session(m_pool);
+    Lease const lease{*this};
+    auto& statements = lease.statements();
 
     switch (state) {
     case File::State::started: {
       using soci::use;
-      sql << "UPDATE File SET state = :state, started_at = :tp WHERE "
-             "physical_path = :physical_path AND state = :submitted;",
-          use(new_state), use(tp), use(cpath), use(submitted_state);
+      auto st = statements.bind(
+          "UPDATE File SET state = :state, started_at = :tp WHERE "
+          "physical_path = :physical_path AND state = :submitted;",
+          use(new_state), use(tp), use(cpath), use(submitted_state));
+      st.execute(true);
       break;
     }
     case File::State::completed:
     case File::State::cancelled:
     case File::State::failed: {
       using soci::use;
-      sql << "UPDATE File SET state = :state, "
-             "started_at = CASE WHEN started_at = 0 THEN :tp_start ELSE "
-             "started_at END, "
-             "finished_at = :tp_end "
-             "WHERE physical_path = :physical_path AND state IN (:submitted, "
-             ":started);",
+      auto st = statements.bind(
+          "UPDATE File SET state = :state, "
+          "started_at = CASE WHEN started_at = 0 THEN :tp_start ELSE "
+          "started_at END, "
+          "finished_at = :tp_end "
+          "WHERE physical_path = :physical_path AND state IN (:submitted, "
+          ":started);",
           use(new_state), use(tp), use(tp), use(cpath), use(submitted_state),
-          use(started_state);
+          use(started_state));
+      st.execute(true);
       break;
     }
     case File::State::submitted:
@@ -324,11 +678,52 @@ bool SociDatabase::update(StageId const& id, std::span<LogicalPath const> paths,
                           File::State state, TimePoint tp)
 {
   TRACE_FUNCTION();
-  auto& sql = get_session(m_pool);
-  soci::transaction tr{sql};
-  std::for_each(paths.begin(), paths.end(),
-                [&](auto& p) { update(id, p, state, tp); });
-  tr.commit();
+  if (!is_canonical_stage_id(id)) {
+    return false;
+  }
+  try {
+    auto const cstate = to_underlying(state);
+    SociTransaction tr{Lease{*this}};
+    auto& statements = tr.statements();
+    load_path_keys(statements, paths);
+
+    switch (state) {
+    case File::State::started: {
+      auto st = statements.bind(
+          "UPDATE File SET state = :state, started_at = :tp "
+          "WHERE stage_id = unhex(:id, '-') AND logical_path IN "
+          "(SELECT path FROM temp.PathKey);",
+          soci::use(cstate), soci::use(tp), soci::use(id));
+      st.execute(true);
+      break;
+    }
+    case File::State::completed:
+    case File::State::cancelled:
+    case File::State::failed: {
+      auto st = statements.bind(
+          "UPDATE File SET state = :state, "
+          "started_at = CASE WHEN started_at = 0 THEN :tp_start ELSE "
+          "started_at END, "
+          "finished_at = :tp_end "
+          "WHERE stage_id = unhex(:id, '-') AND logical_path IN "
+          "(SELECT path FROM temp.PathKey);",
+          soci::use(cstate), soci::use(tp), soci::use(tp), soci::use(id));
+      st.execute(true);
+      break;
+    }
+    case File::State::submitted:
+      // this transition is not foreseen, ignore
+      break;
+    default:
+      assert(false && "invalid state");
+    }
+
+    statements.bind("DELETE FROM temp.PathKey;").execute(true);
+    tr.commit();
+  } catch (soci::soci_error const& e) {
+    std::cerr << "Soci error: " << e.what() << '\n';
+    return false;
+  }
   return true;
 }
 
@@ -336,11 +731,54 @@ bool SociDatabase::update(std::span<PhysicalPath const> paths,
                           File::State state, TimePoint tp)
 {
   TRACE_FUNCTION();
-  auto& sql = get_session(m_pool);
-  soci::transaction tr{sql};
-  std::for_each(paths.begin(), paths.end(),
-                [&](auto& p) { update(p, state, tp); });
-  tr.commit();
+  try {
+    auto const new_state       = to_underlying(state);
+    auto const submitted_state = to_underlying(File::State::submitted);
+    auto const started_state   = to_underlying(File::State::started);
+    SociTransaction tr{Lease{*this}};
+    auto& statements = tr.statements();
+    load_path_keys(statements, paths);
+
+    switch (state) {
+    case File::State::started: {
+      using soci::use;
+      auto st = statements.bind(
+          "UPDATE File SET state = :state, started_at = :tp "
+          "WHERE state = :submitted AND physical_path IN "
+          "(SELECT path FROM temp.PathKey);",
+          use(new_state), use(tp), use(submitted_state));
+      st.execute(true);
+      break;
+    }
+    case File::State::completed:
+    case File::State::cancelled:
+    case File::State::failed: {
+      using soci::use;
+      auto st = statements.bind(
+          "UPDATE File SET state = :state, "
+          "started_at = CASE WHEN started_at = 0 THEN :tp_start ELSE "
+          "started_at END, "
+          "finished_at = :tp_end "
+          "WHERE state IN (:submitted, :started) AND physical_path IN "
+          "(SELECT path FROM temp.PathKey);",
+          use(new_state), use(tp), use(tp), use(submitted_state),
+          use(started_state));
+      st.execute(true);
+      break;
+    }
+    case File::State::submitted:
+      // this transition is not foreseen, ignore
+      break;
+    default:
+      assert(false && "invalid state");
+    }
+
+    statements.bind("DELETE FROM temp.PathKey;").execute(true);
+    tr.commit();
+  } catch (soci::soci_error const& e) {
+    std::cerr << "Soci error: " << e.what() << '\n';
+    return false;
+  }
   return true;
 }
 
@@ -348,8 +786,75 @@ bool SociDatabase::update(
     std::span<std::pair<PhysicalPath, File::State>> path_states, TimePoint tp)
 {
   TRACE_FUNCTION();
-  for (auto const& [path, state] : path_states) {
-    update(path, state, tp);
+  if (path_states.empty()) {
+    return true;
+  }
+
+  try {
+    using soci::use;
+    auto const submitted_state = to_underlying(File::State::submitted);
+    auto const started_state   = to_underlying(File::State::started);
+    auto const cancelled_state = to_underlying(File::State::cancelled);
+    auto const failed_state    = to_underlying(File::State::failed);
+    auto const completed_state = to_underlying(File::State::completed);
+    SociTransaction tr{Lease{*this}};
+    auto& statements = tr.statements();
+
+    {
+      std::vector<Filename> paths;
+      std::vector<int> states;
+      auto const n_rows = std::min(path_states.size(), bulk_size);
+      paths.reserve(n_rows);
+      states.reserve(n_rows);
+      auto st = statements.bind("INSERT INTO temp.PathState VALUES (:path, "
+                                ":state);",
+                                use(paths), use(states));
+      for (auto first = path_states.begin(); first != path_states.end();) {
+        auto const last = std::next(
+            first, std::min(std::distance(first, path_states.end()),
+                            static_cast<std::ptrdiff_t>(bulk_size)));
+        paths.clear();
+        states.clear();
+        std::for_each(first, last, [&](auto const& path_state) {
+          paths.push_back(path_state.first.string());
+          states.push_back(to_underlying(path_state.second));
+        });
+        st.execute(true);
+        first = last;
+      }
+    }
+
+    // the unary + keeps SQLite from driving the join with the state index
+    // instead of the few paths being updated
+    {
+      auto st = statements.bind(
+          "UPDATE File SET state = p.state, started_at = :tp "
+          "FROM temp.PathState AS p "
+          "WHERE File.physical_path = p.path AND p.state = :started "
+          "AND +File.state = :submitted;",
+          use(tp), use(started_state), use(submitted_state));
+      st.execute(true);
+    }
+    {
+      auto st = statements.bind(
+          "UPDATE File SET state = p.state, "
+          "started_at = CASE WHEN File.started_at = 0 THEN :tp_start ELSE "
+          "File.started_at END, "
+          "finished_at = :tp_end "
+          "FROM temp.PathState AS p "
+          "WHERE File.physical_path = p.path "
+          "AND p.state IN (:cancelled, :failed, :completed) "
+          "AND +File.state IN (:submitted, :started);",
+          use(tp), use(tp), use(cancelled_state), use(failed_state),
+          use(completed_state), use(submitted_state), use(started_state));
+      st.execute(true);
+    }
+
+    statements.bind("DELETE FROM temp.PathState;").execute(true);
+    tr.commit();
+  } catch (soci::soci_error const& e) {
+    std::cerr << "Soci error: " << e.what() << '\n';
+    return false;
   }
   return true;
 }
@@ -357,21 +862,26 @@ bool SociDatabase::update(
 bool SociDatabase::update(StageEntity const& entity)
 {
   TRACE_FUNCTION();
-  using namespace soci;
-  auto& sql = get_session(m_pool);
-  sql << "UPDATE Stage SET created_at = :created_at, "
-         "started_at = :started_at, completed_at = :completed_at "
-         "WHERE id = :id;",
+  if (!is_canonical_stage_id(entity.id)) {
+    return false;
+  }
+  using soci::use;
+  Lease const lease{*this};
+  auto& statements = lease.statements();
+  auto st          = statements.bind(
+      "UPDATE Stage SET created_at = :created_at, "
+      "started_at = :started_at, completed_at = :completed_at "
+      "WHERE id = unhex(:id, '-');",
       use(entity.created_at), use(entity.started_at), use(entity.completed_at),
-      use(entity.id);
+      use(entity.id));
+  st.execute(true);
   return true;
 }
 
 bool SociDatabase::update(StageUpdate const& stage_update)
 {
   TRACE_FUNCTION();
-  auto& sql = get_session(m_pool);
-  soci::transaction tr{sql};
+  SociTransaction tr{Lease{*this}};
   if (stage_update.stage.has_value()) {
     update(*stage_update.stage);
   }
@@ -384,13 +894,40 @@ std::size_t SociDatabase::count_files(File::State state) const
 {
   TRACE_FUNCTION();
   std::size_t count{};
-  auto const cstate = to_underlying(state);
-  auto& sql         = get_session(m_pool);
-  sql << "SELECT COUNT(DISTINCT physical_path) FROM File WHERE state = :state;",
-      soci::into(count), soci::use(cstate);
+  Lease const lease{*this};
+  auto& statements = lease.statements();
+  if (state == File::State::submitted) {
+    auto st = statements.bind(
+        "SELECT value FROM Counter WHERE name = 'submitted_paths';",
+        soci::into(count));
+    st.execute(true);
+  } else {
+    auto const cstate = to_underlying(state);
+    auto st           = statements.bind(
+        "SELECT COUNT(DISTINCT physical_path) FROM File WHERE state = :state;",
+        soci::into(count), soci::use(cstate));
+    st.execute(true);
+  }
   return std::size_t{count};
 }
 
+std::size_t SociDatabase::count_stages(PhysicalPath const& path,
+                                       File::State state) const
+{
+  TRACE_FUNCTION();
+  std::size_t count{};
+  auto const cpath  = path.string();
+  auto const cstate = to_underlying(state);
+  Lease const lease{*this};
+  auto& statements = lease.statements();
+  auto st          = statements.bind(
+      "SELECT COUNT(DISTINCT stage_id) FROM File WHERE state = :state AND "
+      "physical_path = :physical_path;",
+      soci::into(count), soci::use(cstate), soci::use(cpath));
+  st.execute(true);
+  return count;
+}
+
 PhysicalPaths SociDatabase::get_files(File::State state,
                                       std::size_t n_files) const
 {
@@ -398,10 +935,15 @@ PhysicalPaths SociDatabase::get_files(File::State state,
   std::vector<Filename> filenames(n_files);
   auto const cstate = to_underlying(state);
 
-  auto& sql = get_session(m_pool);
-  sql << "SELECT DISTINCT physical_path FROM File WHERE state = :state LIMIT "
-         ":n_files;",
-      soci::into(filenames), soci::use(cstate), soci::use(n_files);
+  Lease const lease{*this};
+  auto& statements = lease.statements();
+  {
+    auto st = statements.bind(
+        "SELECT DISTINCT physical_path FROM File WHERE state = :state LIMIT "
+        ":n_files;",
+        soci::into(filenames), soci::use(cstate), soci::use(n_files));
+    st.execute(true);
+  }
 
   PhysicalPaths result;
   result.reserve(filenames.size());
@@ -414,17 +956,34 @@ PhysicalPaths SociDatabase::get_files(File::State state,
 bool SociDatabase::erase(StageId const& id)
 {
   TRACE_FUNCTION();
+  if (!is_canonical_stage_id(id)) {
+    return false;
+  }
   try {
-    auto& sql = get_session(m_pool);
+    Lease const lease{*this};
+    auto& statements = lease.statements();
     int count{0};
-    sql << "SELECT count(*) FROM Stage WHERE id = :id;", soci::into(count),
-        soci::use(id);
+    {
+      auto st = statements.bind(
+          "SELECT count(*) FROM Stage WHERE id = unhex(:id, '-');",
+          soci::into(count), soci::use(id));
+      st.execute(true);
+    }
     if (count == 0) {
       return false;
     }
 
-    sql << "DELETE FROM File WHERE stage_id = :stage_id;", soci::use(id);
-    sql << "DELETE FROM Stage WHERE id = :id;", soci::use(id);
+    {
+      auto st = statements.bind(
+          "DELETE FROM File WHERE stage_id = unhex(:stage_id, '-');",
+          soci::use(id));
+      st.execute(true);
+    }
+    {
+      auto st = statements.bind(
+          "DELETE FROM Stage WHERE id = unhex(:id, '-');", soci::use(id));
+      st.execute(true);
+    }
 
   } catch (soci::soci_error const& e) {
     std::cerr << "Soci error: " << e.what() << '\n';
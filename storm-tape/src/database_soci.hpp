@@ -5,21 +5,84 @@
 #ifndef STORM_TAPE_DATABASE_SOCI_HPP
 #define STORM_TAPE_DATABASE_SOCI_HPP
 
+#include "configuration.hpp"
 #include "database.hpp"
 
 #include <soci/soci.h>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace storm {
 
+class StatementCache;
+
+// open a session on the SQLite database and tune it according to config
+void open_session(soci::session& sql, DatabaseConfiguration const& config);
+
+class SociTransaction;
+
 class SociDatabase : public Database
 {
+  // a session of the pool, with its prepared statements
+  struct Connection;
+  // the sessions leased by a thread, with the databases they are leased for
+  using Leases = std::vector<std::pair<std::uint64_t, Connection*>>;
+
   soci::connection_pool& m_pool;
+  std::chrono::milliseconds m_lease_timeout;
+  std::uint64_t m_instance;
+  mutable std::mutex m_mutex;
+  // by position in the pool, created the first time the session is leased
+  mutable std::unordered_map<std::size_t, std::unique_ptr<Connection>>
+      m_connections;
+
+  static Leases& thread_leases();
+  Connection& acquire() const;
+  void release(Connection& connection) const noexcept;
 
   bool update(std::span<std::pair<PhysicalPath, File::State>> path_states, TimePoint tp) override;
   bool update(StageEntity const& entity) override;
-  
+
  public:
-  explicit SociDatabase(soci::connection_pool& pool);
+  // A session leased by a thread for the duration of an operation or of a
+  // transaction. The leases taken by a thread that already holds one share its
+  // session, so that the operations of a transaction run on it; the session
+  // goes back to the pool when the outermost lease ends. If no session becomes
+  // available within the lease timeout, a soci::soci_error is thrown.
+  class Lease
+  {
+    SociDatabase const* m_db;
+    Connection* m_connection;
+
+   public:
+    explicit Lease(SociDatabase const& db);
+    ~Lease();
+    Lease(Lease&& other) noexcept;
+    Lease(Lease const&)            = delete;
+    Lease& operator=(Lease const&) = delete;
+    Lease& operator=(Lease&&)      = delete;
+
+    StatementCache& statements() const;
+  };
+
+  explicit SociDatabase(soci::connection_pool& pool,
+                        std::chrono::milliseconds lease_timeout =
+                            DatabaseConfiguration{}.lease_timeout);
+  ~SociDatabase() override;
+  SociDatabase(SociDatabase const&)            = delete;
+  SociDatabase& operator=(SociDatabase const&) = delete;
+  SociDatabase(SociDatabase&&)                 = delete;
+  SociDatabase& operator=(SociDatabase&&)      = delete;
+
+  // start a transaction on a session leased by the calling thread; the
+  // operations done by the same thread until it ends are part of it
+  SociTransaction transaction();
+
   bool insert(StageId const& id, StageRequest const& stage) override;
   std::optional<StageRequest> find(std::string const& id) const override;
   std::vector<StageId> find_incomplete_stages() const override;
@@ -35,9 +98,34 @@ class SociDatabase : public Database
   bool update(StageUpdate const& stage_update) override;
   bool erase(std::string const& id) override;
   std::size_t count_files(File::State state) const override;
+  std::size_t count_stages(PhysicalPath const& path,
+                           File::State state) const override;
   PhysicalPaths get_files(File::State state, std::size_t n_files) const override;
 };
 
+// A transaction on a leased session, implemented with a savepoint so that it
+// can be nested in another one. If not committed, its changes are rolled back
+// on destruction. The session is kept until the transaction ends.
+class SociTransaction
+{
+  SociDatabase::Lease m_lease;
+  bool m_committed{false};
+
+ public:
+  explicit SociTransaction(SociDatabase::Lease lease);
+  ~SociTransaction();
+  SociTransaction(SociTransaction const&)            = delete;
+  SociTransaction& operator=(SociTransaction const&) = delete;
+  SociTransaction(SociTransaction&&)                 = delete;
+  SociTransaction& operator=(SociTransaction&&)      = delete;
+
+  void commit();
+  StatementCache& statements() const
+  {
+    return m_lease.statements();
+  }
+};
+
 } // namespace storm
 
 #endif // STORM_TAPE_DATABASE_SOCI_HPP
@@ -0,0 +1,89 @@
+// SPDX-FileCopyrightText: 2025 Istituto Nazionale di Fisica Nucleare
+//
+// SPDX-License-Identifier: EUPL-1.2
+
+#include "directory_cache.hpp"
+#include <boost/assert.hpp>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+
+namespace storm {
+
+DirectoryCache::Directory::~Directory()
+{
+  ::close(m_fd);
+}
+
+DirectoryCache::DirectoryCache(std::size_t capacity)
+    : m_capacity{capacity}
+{
+  BOOST_ASSERT(m_capacity > 0);
+}
+
+Result<DirectoryCache::DirectoryPtr>
+DirectoryCache::open(std::string const& path)
+{
+  {
+    std::lock_guard lock{m_mutex};
+    if (auto it = m_index.find(path); it != m_index.end()) {
+      m_lru.splice(m_lru.begin(), m_lru, it->second);
+      return it->second->second;
+    }
+  }
+
+  // open outside the lock, the file system can be slow
+  auto const fd = ::open(path.c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC);
+  if (fd == -1) {
+    return std::error_code{errno, std::generic_category()};
+  }
+  auto directory = std::make_shared<Directory const>(fd);
+
+  std::lock_guard lock{m_mutex};
+  // another thread could have opened the same directory meanwhile
+  if (auto it = m_index.find(path); it != m_index.end()) {
+    m_lru.splice(m_lru.begin(), m_lru, it->second);
+    return it->second->second;
+  }
+  m_lru.emplace_front(path, directory);
+  m_index.emplace(path, m_lru.begin());
+  if (m_lru.size() > m_capacity) {
+    m_index.erase(m_lru.back().first);
+    // closed when the last user releases it
+    m_lru.pop_back();
+  }
+  return directory;
+}
+
+Result<DirectoryCache::DirectoryPtr>
+DirectoryCache::revalidate(std::string const& path,
+                           DirectoryPtr const& directory)
+{
+  struct stat cached  = {};
+  struct stat current = {};
+  if (::fstat(directory->fd(), &cached) == 0
+      && ::stat(path.c_str(), &current) == 0 && cached.st_dev == current.st_dev
+      && cached.st_ino == current.st_ino) {
+    return directory;
+  }
+
+  {
+    std::lock_guard lock{m_mutex};
+    // another thread could have replaced it meanwhile
+    if (auto it = m_index.find(path);
+        it != m_index.end() && it->second->second == directory) {
+      m_lru.erase(it->second);
+      m_index.erase(it);
+    }
+  }
+  return open(path);
+}
+
+std::size_t DirectoryCache::size() const
+{
+  std::lock_guard lock{m_mutex};
+  return m_lru.size();
+}
+
+} // namespace storm
@@ -0,0 +1,68 @@
+// SPDX-FileCopyrightText: 2025 Istituto Nazionale di Fisica Nucleare
+//
+// SPDX-License-Identifier: EUPL-1.2
+
+#ifndef STORM_DIRECTORY_CACHE_HPP
+#define STORM_DIRECTORY_CACHE_HPP
+
+#include "types.hpp"
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace storm {
+
+// The directories most recently used, opened with O_PATH, so that the files
+// in them can be looked up without resolving the whole path every time.
+// A directory stays open while it is cached or used.
+class DirectoryCache
+{
+ public:
+  class Directory
+  {
+    int m_fd;
+
+   public:
+    explicit Directory(int fd)
+        : m_fd{fd}
+    {}
+    ~Directory();
+    Directory(Directory const&)            = delete;
+    Directory& operator=(Directory const&) = delete;
+
+    int fd() const noexcept
+    {
+      return m_fd;
+    }
+  };
+  using DirectoryPtr = std::shared_ptr<Directory const>;
+
+ private:
+  using Entry = std::pair<std::string, DirectoryPtr>;
+
+  std::size_t m_capacity;
+  mutable std::mutex m_mutex;
+  // the most recently used first
+  std::list<Entry> m_lru;
+  std::unordered_map<std::string, std::list<Entry>::iterator> m_index;
+
+ public:
+  explicit DirectoryCache(std::size_t capacity);
+
+  // The directory at path, opened if not cached
+  Result<DirectoryPtr> open(std::string const& path);
+  // The directory at path, if still the same as directory, as returned by
+  // open(). Otherwise, e.g. if it was removed and created again, directory
+  // is evicted and the one now at path is opened.
+  Result<DirectoryPtr> revalidate(std::string const& path,
+                                  DirectoryPtr const& directory);
+  std::size_t size() const;
+};
+
+} // namespace storm
+
+#endif
@@ -5,10 +5,6 @@
 #ifndef STORM_HTTP_TEXT_MAP_CARRIER
 #define STORM_HTTP_TEXT_MAP_CARRIER
 
-#include <string>
-#include <string_view>
-#include <utility>
-
 #include <opentelemetry/context/propagation/text_map_propagator.h>
 #include <opentelemetry/nostd/string_view.h>
 #include <opentelemetry/trace/propagation/http_trace_context.h>
@@ -16,17 +12,19 @@
 namespace storm {
 
 // https://github.com/open-telemetry/opentelemetry-cpp/blob/4998eb178601f69481e1629e5464d0272532ec9e/examples/http/tracer_common.h#L29
+// The carrier is a view over the headers of a request, which must outlive it.
+// It is only used to extract the context of an incoming request, so the
+// headers are never modified.
 template<typename T>
 class HttpTextMapCarrier
     : public opentelemetry::context::propagation::TextMapCarrier
 {
-  T m_headers;
+  T const& m_headers;
 
  public:
-  HttpTextMapCarrier(T const& headers)
+  explicit HttpTextMapCarrier(T const& headers)
       : m_headers(headers)
   {}
-  HttpTextMapCarrier() = default;
 
   opentelemetry::nostd::string_view
   Get(opentelemetry::nostd::string_view key) const noexcept override
@@ -38,11 +36,9 @@ class HttpTextMapCarrier
     return "";
   }
 
-  void Set(opentelemetry::nostd::string_view key,
-           opentelemetry::nostd::string_view value) noexcept override
-  {
-    m_headers.insert(std::pair{std::string{key}, std::string{value}});
-  }
+  void Set(opentelemetry::nostd::string_view,
+           opentelemetry::nostd::string_view) noexcept override
+  {}
 };
 
 } // namespace storm
@@ -18,6 +18,7 @@
 #include "takeover_response.hpp"
 #include "types.hpp"
 #include <boost/algorithm/string/join.hpp>
+#include <boost/json/basic_parser_impl.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/url/parse.hpp>
 #include <boost/variant2.hpp>
@@ -57,29 +58,95 @@ crow::response to_crow_response(StageResponse const& resp)
   }
 }
 
+namespace {
+
+// Append a JSON string to out, escaped as by boost::json::serialize
+void append_json_string(std::string& out, std::string_view s)
+{
+  out += '"';
+  auto first = s.begin();
+  for (auto it = s.begin(); it != s.end(); ++it) {
+    auto const c = static_cast<unsigned char>(*it);
+    if (c >= 0x20 && c != '"' && c != '\\') {
+      continue;
+    }
+    out.append(first, it);
+    first = std::next(it);
+    switch (c) {
+    case '"':
+      out += "\\\"";
+      break;
+    case '\\':
+      out += "\\\\";
+      break;
+    case '\b':
+      out += "\\b";
+      break;
+    case '\f':
+      out += "\\f";
+      break;
+    case '\n':
+      out += "\\n";
+      break;
+    case '\r':
+      out += "\\r";
+      break;
+    case '\t':
+      out += "\\t";
+      break;
+    default:
+      fmt::format_to(std::back_inserter(out), "\\u{:04x}", c);
+    }
+  }
+  out.append(first, s.end());
+  out += '"';
+}
+
+// The size of the body, assuming that no character needs escaping
+template<typename Range, typename Path>
+std::size_t estimate_size(Range const& range, Path path,
+                          std::size_t per_element)
+{
+  return std::accumulate(range.begin(), range.end(), std::size_t{64},
+                         [&](std::size_t acc, auto const& e) {
+                           return acc + path(e).native().size() + per_element;
+                         });
+}
+
+} // namespace
+
+// The body is written directly into a single string, which is then moved
+// into the response
 crow::response to_crow_response(StatusResponse const& resp)
 {
-  auto const& stage   = resp.stage();
-  auto const& id      = resp.id();
-  auto const& m_files = stage.files;
-
-  boost::json::array files;
-  files.reserve(m_files.size());
-  std::transform( //
-      m_files.begin(), m_files.end(), std::back_inserter(files),
-      [](File const& file) {
-        return boost::json::object{{"path", file.logical_path.c_str()},
-                                   {"state", to_string(file.state)}};
-      });
-  boost::json::object jbody;
-  jbody["id"]          = id;
-  jbody["createdAt"]   = stage.created_at;
-  jbody["startedAt"]   = stage.started_at;
-  jbody["completedAt"] = stage.completed_at;
-  jbody["files"]       = files;
-
-  return crow::response{crow::status::OK, "json",
-                        boost::json::serialize(jbody)};
+  auto const& stage = resp.stage();
+  auto const& files = stage.files;
+
+  static auto constexpr file_overhead =
+      std::string_view{R"({"path":"","state":"SUBMITTED"},)"}.size();
+  std::string body;
+  body.reserve(estimate_size(
+      files, [](File const& file) -> auto& { return file.logical_path; },
+      file_overhead));
+
+  body += R"({"id":)";
+  append_json_string(body, resp.id());
+  fmt::format_to(std::back_inserter(body),
+                 R"(,"createdAt":{},"startedAt":{},"completedAt":{},"files":[)",
+                 stage.created_at, stage.started_at, stage.completed_at);
+  for (auto const& file : files) {
+    if (&file != files.data()) {
+      body += ',';
+    }
+    body += R"({"path":)";
+    append_json_string(body, file.logical_path.native());
+    body += R"(,"state":)";
+    append_json_string(body, to_string(file.state));
+    body += '}';
+  }
+  body += "]}";
+
+  return crow::response{crow::status::OK, "json", std::move(body)};
 }
 
 // Creates a JSON object when one or more files targeted for cancellation do
@@ -124,34 +191,36 @@ crow::response to_crow_response(ReleaseResponse const& resp)
           fmt::format("{}\n", boost::json::serialize(jbody))};
 }
 
-struct PathInfoVisitor
+crow::response to_crow_response(ArchiveInfoResponse const& resp)
 {
-  std::string logical_path;
-  auto operator()(Locality locality) const
-  {
-    return boost::json::object{{"path", logical_path},
-                               {"locality", to_string(locality)}};
-  }
-  auto operator()(std::string const& msg) const
-  {
-    return boost::json::object{{"path", logical_path}, {"error", msg}};
+  auto const& infos = resp.infos;
+
+  static auto constexpr info_overhead =
+      std::string_view{R"({"path":"","locality":"DISK_AND_TAPE"},)"}.size();
+  std::string body;
+  body.reserve(estimate_size(
+      infos, [](PathInfo const& info) -> auto& { return info.path; },
+      info_overhead));
+
+  body += '[';
+  for (auto const& info : infos) {
+    if (&info != infos.data()) {
+      body += ',';
+    }
+    body += R"({"path":)";
+    append_json_string(body, info.path.native());
+    if (auto const* locality = boost::variant2::get_if<Locality>(&info.info)) {
+      body += R"(,"locality":)";
+      append_json_string(body, to_string(*locality));
+    } else {
+      body += R"(,"error":)";
+      append_json_string(body, boost::variant2::get<std::string>(info.info));
+    }
+    body += '}';
   }
-};
+  body += "]\n";
 
-crow::response to_crow_response(ArchiveInfoResponse const& resp)
-{
-  boost::json::array jbody;
-  auto& infos = resp.infos;
-  jbody.reserve(infos.size());
-
-  std::transform(infos.begin(), infos.end(), std::back_inserter(jbody),
-                 [&](PathInfo const& info) {
-                   PathInfoVisitor visitor{info.path};
-                   return boost::variant2::visit(visitor, info.info);
-                 });
-
-  return crow::response{crow::status::OK, "json",
-                        fmt::format("{}\n", boost::json::serialize(jbody))};
+  return crow::response{crow::status::OK, "json", std::move(body)};
 }
 
 crow::response
@@ -161,24 +230,37 @@ to_crow_response(ReadyTakeOverResponse const& resp) //-V835 for uniformity
                         fmt::format("{}\n", resp.n_ready)};
 }
 
+// One line per path, after the given prefix. The body is allocated at its
+// exact size and each line is written once.
+static std::string make_text_body(PhysicalPaths const& paths,
+                                  std::string_view prefix)
+{
+  auto const size = std::accumulate(
+      paths.begin(), paths.end(), std::size_t{0},
+      [&](std::size_t acc, PhysicalPath const& path) {
+        return acc + prefix.size() + path.native().size() + 1;
+      });
+  std::string body;
+  body.reserve(size);
+  for (auto const& path : paths) {
+    body += prefix;
+    body += path.native();
+    body += '\n';
+  }
+  BOOST_ASSERT(body.size() == size);
+  return body;
+}
+
 crow::response to_crow_response(TakeOverResponse const& resp)
 {
-  auto const body =
-      std::accumulate(resp.paths.begin(), resp.paths.end(), std::string{}, //
-                      [](std::string const& acc, PhysicalPath const& path) {
-                        return fmt::format("{}unused {}\n", acc, path);
-                      });
-  return crow::response{crow::status::OK, "txt", body};
+  return crow::response{crow::status::OK, "txt",
+                        make_text_body(resp.paths, "unused ")};
 }
 
 crow::response to_crow_response(InProgressResponse const& resp)
 {
-  auto const body =
-      std::accumulate(resp.paths.begin(), resp.paths.end(), std::string{}, //
-                      [](std::string const& acc, PhysicalPath const& path) {
-                        return fmt::format("{}{}\n", acc, path);
-                      });
-  return crow::response{crow::status::OK, "txt", body};
+  return crow::response{crow::status::OK, "txt",
+                        make_text_body(resp.paths, "")};
 }
 
 crow::response to_crow_response(storm::HttpError const& e)
@@ -190,70 +272,305 @@ crow::response to_crow_response(storm::HttpError const& e)
   return response;
 }
 
-Files from_json(std::string_view body, StageRequest::Tag)
+namespace {
+
+// Collects the paths of a request while its JSON body is parsed, without
+// building a document. The paths are normalized as they are collected; the
+// rest of the body is skipped, but it must be valid JSON.
+class PathsHandler
 {
-  try {
-    auto const value =
-        boost::json::parse(boost::json::string_view{body.data(), body.size()});
-    auto& jfiles = value.as_object().at("files").as_array();
-    Files files;
-    files.reserve(jfiles.size());
-
-    std::transform(                   //
-        jfiles.begin(), jfiles.end(), //
-        std::back_inserter(files),    //
-        [](auto& jfile) {
-          std::string_view sv = jfile.as_object().at("path").as_string();
-          return File{LogicalPath{fs::path{sv}.lexically_normal()}};
-        } //
-    );
-    return files;
-  } catch (boost::system::system_error const&) {
+ public:
+  enum class Schema : unsigned char
+  {
+    // {"files":[{"path":"..."},...]}
+    files,
+    // {"paths":["...",...]}, or as above if "paths" is missing
+    paths_or_files
+  };
+
+ private:
+  // where the parser is in the expected structure
+  enum class Where : unsigned char
+  {
+    document,
+    top,
+    paths,
+    files,
+    file,
+    done
+  };
+  // the last key read in the top object or in a file object
+  enum class Key : unsigned char
+  {
+    other,
+    paths,
+    files,
+    path
+  };
+
+  Schema m_schema;
+  Where m_where{Where::document};
+  Key m_key{Key::other};
+  // the nesting level inside a value that is skipped
+  std::size_t m_skipped{0};
+  bool m_file_has_path{false};
+  // a key or a string received in parts
+  std::string m_buffer;
+  LogicalPaths m_paths;
+  LogicalPaths m_files;
+  bool m_has_paths{false};
+  bool m_has_files{false};
+
+  static bool fail(boost::json::error_code& ec, boost::json::error e)
+  {
+    ec = e;
+    return false;
+  }
+
+  bool is_skipping() const
+  {
+    return m_skipped != 0
+        || ((m_where == Where::top || m_where == Where::file)
+            && m_key == Key::other);
+  }
+
+  // a scalar is accepted only where it is skipped
+  bool on_scalar(boost::json::error_code& ec)
+  {
+    return is_skipping() || fail(ec, boost::json::error::not_string);
+  }
+
+  std::string_view take(boost::json::string_view s)
+  {
+    if (m_buffer.empty()) {
+      return {s.data(), s.size()};
+    }
+    m_buffer.append(s.data(), s.size());
+    return m_buffer;
+  }
+
+ public:
+  static constexpr std::size_t max_object_size = std::size_t(-1);
+  static constexpr std::size_t max_array_size  = std::size_t(-1);
+  static constexpr std::size_t max_key_size    = std::size_t(-1);
+  static constexpr std::size_t max_string_size = std::size_t(-1);
+
+  explicit PathsHandler(Schema schema)
+      : m_schema{schema}
+  {}
+
+  LogicalPaths release()
+  {
+    if (m_has_paths) {
+      return std::move(m_paths);
+    }
+    if (m_has_files) {
+      return std::move(m_files);
+    }
     throw BadRequest("Invalid JSON");
   }
-}
 
-LogicalPaths from_json(std::string_view body, RequestWithPaths::Tag)
-{
-  try {
-    LogicalPaths paths;
-    auto const value =
-        boost::json::parse(boost::json::string_view{body.data(), body.size()});
-
-    auto const& o = value.as_object();
-
-    if (auto const* p = o.if_contains("paths"); p != nullptr) {
-      auto const& ja = p->as_array();
-      paths.reserve(ja.size());
-
-      std::transform(                //
-          ja.begin(), ja.end(),      //
-          std::back_inserter(paths), //
-          [](auto& jpath) {
-            std::string_view sv = jpath.as_string();
-            return LogicalPath{fs::path{sv}.lexically_normal()};
-          } //
-      );
+  bool on_document_begin(boost::json::error_code&)
+  {
+    return true;
+  }
+  bool on_document_end(boost::json::error_code&)
+  {
+    return true;
+  }
 
+  bool on_object_begin(boost::json::error_code& ec)
+  {
+    if (is_skipping()) {
+      ++m_skipped;
+      return true;
+    }
+    switch (m_where) {
+    case Where::document:
+      m_where = Where::top;
+      return true;
+    case Where::files:
+      m_where         = Where::file;
+      m_key           = Key::other;
+      m_file_has_path = false;
+      return true;
+    default:
+      return fail(ec, boost::json::error::not_array);
+    }
+  }
+
+  bool on_object_end(std::size_t, boost::json::error_code& ec)
+  {
+    if (m_skipped != 0) {
+      --m_skipped;
+      return true;
+    }
+    if (m_where == Where::file) {
+      m_where = Where::files;
+      return m_file_has_path || fail(ec, boost::json::error::not_found);
+    }
+    m_where = Where::done;
+    return true;
+  }
+
+  bool on_array_begin(boost::json::error_code& ec)
+  {
+    if (is_skipping()) {
+      ++m_skipped;
+      return true;
+    }
+    if (m_where == Where::top && m_key == Key::paths) {
+      m_where     = Where::paths;
+      m_has_paths = true;
+      m_paths.clear();
+      return true;
+    }
+    if (m_where == Where::top && m_key == Key::files) {
+      m_where     = Where::files;
+      m_has_files = true;
+      m_files.clear();
+      return true;
+    }
+    return fail(ec, m_where == Where::files ? boost::json::error::not_object
+                                            : boost::json::error::not_string);
+  }
+
+  bool on_array_end(std::size_t, boost::json::error_code&)
+  {
+    if (m_skipped != 0) {
+      --m_skipped;
+      return true;
+    }
+    m_where = Where::top;
+    m_key   = Key::other;
+    return true;
+  }
+
+  bool on_key_part(boost::json::string_view s, std::size_t,
+                   boost::json::error_code&)
+  {
+    if (m_skipped == 0) {
+      m_buffer.append(s.data(), s.size());
+    }
+    return true;
+  }
+
+  bool on_key(boost::json::string_view s, std::size_t,
+              boost::json::error_code&)
+  {
+    if (m_skipped != 0) {
+      return true;
+    }
+    auto const key = take(s);
+    if (m_where == Where::top) {
+      m_key = key == "files" ? Key::files
+            : key == "paths" && m_schema == Schema::paths_or_files
+                ? Key::paths
+                : Key::other;
+    } else {
+      m_key = key == "path" ? Key::path : Key::other;
+    }
+    m_buffer.clear();
+    return true;
+  }
+
+  bool on_string_part(boost::json::string_view s, std::size_t,
+                      boost::json::error_code&)
+  {
+    if (!is_skipping()) {
+      m_buffer.append(s.data(), s.size());
+    }
+    return true;
+  }
+
+  bool on_string(boost::json::string_view s, std::size_t,
+                 boost::json::error_code& ec)
+  {
+    if (is_skipping()) {
+      return true;
+    }
+    if (m_where == Where::paths) {
+      m_paths.emplace_back(lexically_normal(take(s)));
+    } else if (m_where == Where::file) {
+      // the last "path" wins, as in a parsed document
+      if (m_file_has_path) {
+        m_files.back() = LogicalPath{lexically_normal(take(s))};
+      } else {
+        m_files.emplace_back(lexically_normal(take(s)));
+      }
+      m_file_has_path = true;
     } else {
-      auto& ja = o.at("files").as_array();
-      paths.reserve(ja.size());
-
-      std::transform(                //
-          ja.begin(), ja.end(),      //
-          std::back_inserter(paths), //
-          [](auto& jfile) {
-            std::string_view sv = jfile.as_object().at("path").as_string();
-            return LogicalPath{fs::path{sv}.lexically_normal()};
-          } //
-      );
+      return fail(ec, boost::json::error::not_array);
     }
+    m_buffer.clear();
+    return true;
+  }
 
-    return paths;
+  bool on_number_part(boost::json::string_view, boost::json::error_code&)
+  {
+    return true;
+  }
+  bool on_int64(std::int64_t, boost::json::string_view,
+                boost::json::error_code& ec)
+  {
+    return on_scalar(ec);
+  }
+  bool on_uint64(std::uint64_t, boost::json::string_view,
+                 boost::json::error_code& ec)
+  {
+    return on_scalar(ec);
+  }
+  bool on_double(double, boost::json::string_view, boost::json::error_code& ec)
+  {
+    return on_scalar(ec);
+  }
+  bool on_bool(bool, boost::json::error_code& ec)
+  {
+    return on_scalar(ec);
+  }
+  bool on_null(boost::json::error_code& ec)
+  {
+    return on_scalar(ec);
+  }
+  bool on_comment_part(boost::json::string_view, boost::json::error_code&)
+  {
+    return true;
+  }
+  bool on_comment(boost::json::string_view, boost::json::error_code&)
+  {
+    return true;
+  }
+};
 
-  } catch (boost::system::system_error const&) {
+LogicalPaths parse_paths(std::string_view body, PathsHandler::Schema schema)
+{
+  boost::json::basic_parser<PathsHandler> parser{boost::json::parse_options{},
+                                                 schema};
+  boost::json::error_code ec;
+  auto const n = parser.write_some(false, body.data(), body.size(), ec);
+  // only whitespace can follow the document
+  if (ec || body.find_first_not_of(" \t\r\n", n) != std::string_view::npos) {
     throw BadRequest("Invalid JSON");
   }
+  return parser.handler().release();
+}
+
+} // namespace
+
+Files from_json(std::string_view body, StageRequest::Tag)
+{
+  auto paths = parse_paths(body, PathsHandler::Schema::files);
+  Files files;
+  files.reserve(paths.size());
+  for (auto& path : paths) {
+    files.push_back(File{std::move(path)});
+  }
+  return files;
+}
+
+LogicalPaths from_json(std::string_view body, RequestWithPaths::Tag)
+{
+  return parse_paths(body, PathsHandler::Schema::paths_or_files);
 }
 
 std::size_t from_body_params(std::string_view body, TakeOverRequest::Tag)
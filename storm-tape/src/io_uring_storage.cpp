@@ -0,0 +1,356 @@
+// SPDX-FileCopyrightText: 2025 Istituto Nazionale di Fisica Nucleare
+//
+// SPDX-License-Identifier: EUPL-1.2
+
+#include "io_uring_storage.hpp"
+#include "configuration.hpp"
+#include "trace_span.hpp"
+#include <boost/assert.hpp>
+#include <crow/logging.h>
+#include <fmt/core.h>
+#include <liburing.h>
+#include <sys/stat.h>
+#include <sys/xattr.h>
+#include <fcntl.h>
+#include <algorithm>
+#include <cerrno>
+#include <initializer_list>
+
+namespace storm {
+
+class IoUringStorage::Ring
+{
+  // the tag of the cancellation submitted by drain()
+  static constexpr __u64 cancel_tag = ~__u64{0};
+
+  io_uring m_ring{};
+  // the operations submitted whose completion has not been seen yet; the
+  // kernel may still write to their buffers
+  unsigned m_in_flight{0};
+
+  int submit_and_wait(unsigned wait_nr)
+  {
+    int submitted;
+    do {
+      submitted = io_uring_submit_and_wait(&m_ring, wait_nr);
+    } while (submitted == -EINTR);
+    if (submitted > 0) {
+      m_in_flight += static_cast<unsigned>(submitted);
+    }
+    return submitted;
+  }
+
+  // Cancel the operations in flight and wait for all their completions,
+  // whose results are discarded. The errors of the wait are transient (e.g.
+  // -EBADR while the overflown completions are flushed), so it is retried
+  // until nothing is in flight.
+  void drain() noexcept
+  {
+    if (m_in_flight == 0) {
+      return;
+    }
+    if (auto sqe = io_uring_get_sqe(&m_ring); sqe != nullptr) {
+      io_uring_prep_cancel64(sqe, 0, IORING_ASYNC_CANCEL_ANY);
+      io_uring_sqe_set_data64(sqe, cancel_tag);
+    }
+    // the submissions prepared but not taken by the kernel go in too
+    submit_and_wait(0);
+    while (m_in_flight != 0) {
+      io_uring_cqe* cqe{nullptr};
+      if (io_uring_wait_cqe(&m_ring, &cqe) < 0) {
+        continue;
+      }
+      io_uring_cqe_seen(&m_ring, cqe);
+      --m_in_flight;
+    }
+  }
+
+ public:
+  explicit Ring(unsigned entries)
+  {
+    if (auto const res = io_uring_queue_init(entries, &m_ring, 0); res < 0) {
+      throw std::system_error(-res, std::generic_category(),
+                              "io_uring_queue_init");
+    }
+  }
+  ~Ring()
+  {
+    drain();
+    io_uring_queue_exit(&m_ring);
+  }
+  Ring(Ring const&)            = delete;
+  Ring& operator=(Ring const&) = delete;
+
+  bool supports(std::initializer_list<int> ops)
+  {
+    auto probe = io_uring_get_probe_ring(&m_ring);
+    if (probe == nullptr) {
+      return false;
+    }
+    auto const result = std::all_of(ops.begin(), ops.end(), [&](int op) {
+      return io_uring_opcode_supported(probe, op) != 0;
+    });
+    io_uring_free_probe(probe);
+    return result;
+  }
+
+  // Run n operations, as many at a time as fit in the submission queue.
+  // prepare(sqe, i) fills the submission of the i-th operation, complete(i,
+  // res) receives its result. If the ring fails, the operations are not all
+  // complete and the ring must not be used any more; the operations still in
+  // flight are cancelled and waited for nonetheless, so that their buffers can
+  // be released.
+  template<typename Prepare, typename Complete>
+  std::error_code run(std::size_t n, Prepare prepare, Complete complete)
+  {
+    BOOST_ASSERT(m_in_flight == 0);
+    std::size_t i{0};
+    while (i != n) {
+      unsigned batch{0};
+      for (; i != n; ++i, ++batch) {
+        auto sqe = io_uring_get_sqe(&m_ring);
+        if (sqe == nullptr) {
+          break;
+        }
+        prepare(sqe, i);
+        io_uring_sqe_set_data64(sqe, i);
+      }
+
+      auto const submitted = submit_and_wait(batch);
+      if (submitted < 0) {
+        drain();
+        return {-submitted, std::generic_category()};
+      }
+
+      while (m_in_flight != 0) {
+        io_uring_cqe* cqe{nullptr};
+        int res;
+        do {
+          res = io_uring_wait_cqe(&m_ring, &cqe);
+        } while (res == -EINTR);
+        if (res < 0) {
+          drain();
+          return {-res, std::generic_category()};
+        }
+        complete(static_cast<std::size_t>(io_uring_cqe_get_data64(cqe)),
+                 cqe->res);
+        io_uring_cqe_seen(&m_ring, cqe);
+        --m_in_flight;
+      }
+
+      if (static_cast<unsigned>(submitted) != batch) {
+        drain();
+        return std::make_error_code(std::errc::resource_unavailable_try_again);
+      }
+    }
+    return {};
+  }
+};
+
+IoUringStorage::IoUringStorage(IoUringConfiguration const& config)
+    : m_queue_depth{config.queue_depth}
+{
+  init();
+}
+
+IoUringStorage::IoUringStorage(
+    IoUringConfiguration const& config,
+    DirectoryProbingConfiguration const& directory_probing)
+    : LocalStorage{directory_probing}
+    , m_queue_depth{config.queue_depth}
+{
+  init();
+  if (m_supported) {
+    CROW_LOG_INFO << "The batches probed through io_uring resolve the whole "
+                     "paths, the directories are used by the syscalls only";
+  }
+}
+
+// check that the kernel supports the operations, keeping the ring for the
+// first batch
+void IoUringStorage::init()
+{
+  try {
+    auto ring = std::make_unique<Ring>(m_queue_depth);
+    m_supported = ring->supports(
+        {IORING_OP_STATX, IORING_OP_GETXATTR, IORING_OP_SETXATTR});
+    if (m_supported) {
+      m_rings.push_back(std::move(ring));
+    } else {
+      CROW_LOG_WARNING << "The kernel doesn't support the io_uring operations "
+                          "on xattrs, the storage is probed with syscalls";
+    }
+  } catch (std::system_error const& e) {
+    CROW_LOG_WARNING << fmt::format(
+        "io_uring is not available ({}), the storage is probed with syscalls",
+        e.what());
+  }
+}
+
+IoUringStorage::~IoUringStorage() = default;
+
+std::unique_ptr<IoUringStorage::Ring> IoUringStorage::acquire()
+{
+  {
+    std::lock_guard lock{m_mutex};
+    if (!m_rings.empty()) {
+      auto ring = std::move(m_rings.back());
+      m_rings.pop_back();
+      return ring;
+    }
+  }
+  try {
+    return std::make_unique<Ring>(m_queue_depth);
+  } catch (std::system_error const& e) {
+    // e.g. out of locked memory; the batch is served by the syscalls
+    CROW_LOG_DEBUG << fmt::format("Cannot create an io_uring ring ({})",
+                                  e.what());
+    return nullptr;
+  }
+}
+
+void IoUringStorage::release(std::unique_ptr<Ring> ring)
+{
+  std::lock_guard lock{m_mutex};
+  m_rings.push_back(std::move(ring));
+}
+
+// A statx and two getxattr per path. They complete in any order, so the xattrs
+// are interpreted only at the end, as LocalStorage::probe does.
+FileProbes IoUringStorage::probe(std::span<PhysicalPath const> paths)
+{
+  TRACE_FUNCTION();
+
+  if (!m_supported) {
+    return LocalStorage::probe(paths);
+  }
+
+  enum Operation : std::size_t
+  {
+    status,
+    in_progress,
+    migrated,
+    n_operations
+  };
+
+  // the buffers written by the kernel are declared before the ring, so that
+  // they outlive its operations
+  FileProbes probes(paths.size());
+  std::vector<struct statx> statx_buffers(paths.size());
+  std::vector<std::error_code> xattr_errors(paths.size());
+
+  auto ring = acquire();
+  if (ring == nullptr) {
+    return LocalStorage::probe(paths);
+  }
+
+  auto prepare = [&](io_uring_sqe* sqe, std::size_t op) {
+    auto const i    = op / n_operations;
+    auto const path = paths[i].c_str();
+    switch (op % n_operations) {
+    case status:
+      io_uring_prep_statx(sqe, AT_FDCWD, path, AT_STATX_SYNC_AS_STAT,
+                          STATX_TYPE | STATX_SIZE | STATX_BLOCKS,
+                          &statx_buffers[i]);
+      break;
+    case in_progress:
+      io_uring_prep_getxattr(sqe, "user.TSMRecT", nullptr, path, 0);
+      break;
+    case migrated:
+      io_uring_prep_getxattr(sqe, "user.storm.migrated", nullptr, path, 0);
+      break;
+    }
+  };
+
+  auto complete = [&](std::size_t op, int res) {
+    auto const i = op / n_operations;
+    auto& probe  = probes[i];
+    switch (op % n_operations) {
+    case status:
+      if (res < 0) {
+        set_stat_error(probe, -res);
+      } else {
+        auto const& sb = statx_buffers[i];
+        probe.type     = to_file_type(sb.stx_mode);
+        probe.size     = static_cast<std::size_t>(sb.stx_size);
+        probe.blocks   = static_cast<std::size_t>(sb.stx_blocks);
+      }
+      break;
+    case in_progress:
+    case migrated: {
+      auto& flag = op % n_operations == in_progress ? probe.in_progress
+                                                    : probe.migrated;
+      if (res >= 0) {
+        flag = true;
+      } else if (res != -ENODATA) {
+        xattr_errors[i].assign(-res, std::generic_category());
+      }
+      break;
+    }
+    }
+  };
+
+  if (auto ec = ring->run(paths.size() * n_operations, prepare, complete);
+      ec != std::error_code{}) {
+    CROW_LOG_WARNING << fmt::format(
+        "io_uring failed ({}), the batch is probed with syscalls",
+        ec.message());
+    return LocalStorage::probe(paths);
+  }
+  release(std::move(ring));
+
+  for (std::size_t i{0}; i != probes.size(); ++i) {
+    auto& probe = probes[i];
+    if (!probe) {
+      continue;
+    }
+    if (probe.type != fs::file_type::regular) {
+      probe.in_progress = false;
+      probe.migrated    = false;
+    } else if (xattr_errors[i] != std::error_code{}) {
+      probe.error = xattr_errors[i];
+    }
+  }
+
+  return probes;
+}
+
+std::vector<std::error_code>
+IoUringStorage::request_recall(std::span<PhysicalPath const> paths)
+{
+  TRACE_FUNCTION();
+
+  if (!m_supported) {
+    return LocalStorage::request_recall(paths);
+  }
+  auto ring = acquire();
+  if (ring == nullptr) {
+    return LocalStorage::request_recall(paths);
+  }
+
+  std::vector<std::error_code> errors(paths.size());
+
+  auto prepare = [&](io_uring_sqe* sqe, std::size_t i) {
+    io_uring_prep_setxattr(sqe, "user.TSMRecT", "", paths[i].c_str(),
+                           XATTR_CREATE, 0);
+  };
+  auto complete = [&](std::size_t i, int res) {
+    if (res < 0 && res != -EEXIST) {
+      errors[i].assign(-res, std::generic_category());
+    }
+  };
+
+  if (auto ec = ring->run(paths.size(), prepare, complete);
+      ec != std::error_code{}) {
+    // creating the xattr is idempotent, so the whole batch can be redone
+    CROW_LOG_WARNING << fmt::format(
+        "io_uring failed ({}), the recalls are requested with syscalls",
+        ec.message());
+    return LocalStorage::request_recall(paths);
+  }
+  release(std::move(ring));
+
+  return errors;
+}
+
+} // namespace storm
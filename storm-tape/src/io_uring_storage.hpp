@@ -0,0 +1,62 @@
+// SPDX-FileCopyrightText: 2025 Istituto Nazionale di Fisica Nucleare
+//
+// SPDX-License-Identifier: EUPL-1.2
+
+#ifndef STORM_IO_URING_STORAGE_HPP
+#define STORM_IO_URING_STORAGE_HPP
+
+#include "local_storage.hpp"
+#include <memory>
+#include <mutex>
+#include <span>
+#include <system_error>
+#include <vector>
+
+namespace storm {
+
+struct IoUringConfiguration;
+struct DirectoryProbingConfiguration;
+
+// A local storage that submits the statx and xattr operations of a batch of
+// files through io_uring, instead of issuing the syscalls one after the other.
+// If the kernel doesn't support the needed operations, the batches are served
+// by the syscalls of LocalStorage, as the per-path calls always are. With
+// directory probing, those batches are probed relative to the directories of
+// the files; the operations submitted through io_uring resolve the whole
+// paths.
+class IoUringStorage : public LocalStorage
+{
+  class Ring;
+
+  unsigned m_queue_depth;
+  bool m_supported{false};
+  std::mutex m_mutex;
+  // the rings not in use; each batch takes one, so that batches can be served
+  // concurrently
+  std::vector<std::unique_ptr<Ring>> m_rings;
+
+  void init();
+  std::unique_ptr<Ring> acquire();
+  void release(std::unique_ptr<Ring> ring);
+
+ public:
+  explicit IoUringStorage(IoUringConfiguration const& config);
+  IoUringStorage(IoUringConfiguration const& config,
+                 DirectoryProbingConfiguration const& directory_probing);
+  ~IoUringStorage() override;
+  IoUringStorage(IoUringStorage const&)            = delete;
+  IoUringStorage& operator=(IoUringStorage const&) = delete;
+
+  bool uses_io_uring() const noexcept
+  {
+    return m_supported;
+  }
+
+  FileProbes probe(std::span<PhysicalPath const> paths) override;
+  std::vector<std::error_code>
+  request_recall(std::span<PhysicalPath const> paths) override;
+};
+
+} // namespace storm
+
+#endif
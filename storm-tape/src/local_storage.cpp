@@ -3,12 +3,33 @@
 // SPDX-License-Identifier: EUPL-1.2
 
 #include "local_storage.hpp"
+#include "configuration.hpp"
+#include "directory_cache.hpp"
 #include "extended_attributes.hpp"
 #include "trace_span.hpp"
+#include <fmt/core.h>
+#include <fcntl.h>
 #include <sys/stat.h>
+#include <sys/xattr.h>
+#include <unistd.h>
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <string_view>
 
 namespace storm {
 
+LocalStorage::LocalStorage() = default;
+
+LocalStorage::LocalStorage(DirectoryProbingConfiguration const& config)
+    : m_directories{
+        std::make_unique<DirectoryCache>(config.max_open_directories)}
+{}
+
+LocalStorage::~LocalStorage()                                 = default;
+LocalStorage::LocalStorage(LocalStorage&&) noexcept            = default;
+LocalStorage& LocalStorage::operator=(LocalStorage&&) noexcept = default;
+
 Result<bool> LocalStorage::is_in_progress(PhysicalPath const& path)
 {
   TRACE_FUNCTION();
@@ -50,4 +71,221 @@ Result<bool> LocalStorage::is_on_tape(PhysicalPath const& path)
   }
 }
 
+fs::file_type to_file_type(unsigned mode)
+{
+  switch (mode & S_IFMT) {
+  case S_IFREG:
+    return fs::file_type::regular;
+  case S_IFDIR:
+    return fs::file_type::directory;
+  case S_IFLNK:
+    return fs::file_type::symlink;
+  case S_IFBLK:
+    return fs::file_type::block;
+  case S_IFCHR:
+    return fs::file_type::character;
+  case S_IFIFO:
+    return fs::file_type::fifo;
+  case S_IFSOCK:
+    return fs::file_type::socket;
+  default:
+    return fs::file_type::unknown;
+  }
+}
+
+void set_stat_error(FileProbe& probe, int error)
+{
+  probe.error.assign(error, std::generic_category());
+  probe.type = error == ENOENT || error == ENOTDIR ? fs::file_type::not_found
+                                                   : fs::file_type::none;
+}
+
+namespace {
+
+// Look for the xattrs of interest in the names listed by listxattr, which are
+// separated by '\0'
+void find_xattrs(std::string_view names, FileProbe& probe)
+{
+  using namespace std::string_view_literals;
+  while (!names.empty()) {
+    auto const name = names.substr(0, names.find('\0'));
+    if (name == "user.TSMRecT"sv) {
+      probe.in_progress = true;
+    } else if (name == "user.storm.migrated"sv) {
+      probe.migrated = true;
+    }
+    names.remove_prefix(std::min(name.size() + 1, names.size()));
+  }
+}
+
+// A single listxattr instead of a getxattr per attribute; the list of a file
+// usually fits in the buffer
+void probe_xattrs(char const* path, FileProbe& probe)
+{
+  std::array<char, 1024> buffer;
+  auto size = ::listxattr(path, buffer.data(), buffer.size());
+  if (size >= 0) {
+    find_xattrs({buffer.data(), static_cast<std::size_t>(size)}, probe);
+    return;
+  }
+  if (errno != ERANGE) {
+    probe.error.assign(errno, std::generic_category());
+    return;
+  }
+  auto const names = list_xattr_names(path, probe.error);
+  probe.in_progress =
+      std::any_of(names.begin(), names.end(), [](XAttrName const& name) {
+        return name.value() == "user.TSMRecT";
+      });
+  probe.migrated =
+      std::any_of(names.begin(), names.end(), [](XAttrName const& name) {
+        return name.value() == "user.storm.migrated";
+      });
+}
+
+void probe_file(PhysicalPath const& path, FileProbe& probe)
+{
+  struct stat sb = {};
+
+  if (::stat(path.c_str(), &sb) == -1) {
+    set_stat_error(probe, errno);
+    return;
+  }
+
+  probe.type   = to_file_type(sb.st_mode);
+  probe.size   = static_cast<std::size_t>(sb.st_size);
+  probe.blocks = static_cast<std::size_t>(sb.st_blocks);
+
+  if (probe.type == fs::file_type::regular) {
+    probe_xattrs(path.c_str(), probe);
+  }
+}
+
+// Probe a file given the directory containing it, without resolving its path
+// again. The attributes may come from the cache of the file system.
+void probe_file_at(int dir_fd, char const* name, FileProbe& probe)
+{
+  struct statx sb = {};
+
+  if (::statx(dir_fd, name, AT_STATX_DONT_SYNC,
+              STATX_TYPE | STATX_SIZE | STATX_BLOCKS, &sb)
+      == -1) {
+    set_stat_error(probe, errno);
+    return;
+  }
+
+  probe.type   = to_file_type(sb.stx_mode);
+  probe.size   = static_cast<std::size_t>(sb.stx_size);
+  probe.blocks = static_cast<std::size_t>(sb.stx_blocks);
+
+  if (probe.type != fs::file_type::regular) {
+    return;
+  }
+
+  // O_PATH only names the file, without opening it for reading; since the
+  // xattr calls don't accept such a descriptor, they go through procfs
+  auto const fd = ::openat(dir_fd, name, O_PATH | O_CLOEXEC);
+  if (fd == -1) {
+    probe.error.assign(errno, std::generic_category());
+    return;
+  }
+  std::array<char, 32> proc_path;
+  *fmt::format_to_n(proc_path.data(), proc_path.size() - 1,
+                    "/proc/self/fd/{}", fd)
+       .out = '\0';
+  probe_xattrs(proc_path.data(), probe);
+  ::close(fd);
+}
+
+// Where the file name starts in a path, npos if the path has no file name
+std::size_t file_name_position(std::string const& path)
+{
+  auto const slash = path.rfind('/');
+  auto const pos   = slash == std::string::npos ? 0 : slash + 1;
+  return pos == path.size() ? std::string::npos : pos;
+}
+
+} // namespace
+
+// One stat and, for regular files, one listxattr per path, instead of the stat
+// and the two getxattr of the calls above. With directory probing the paths
+// are grouped by directory, so that each directory is resolved only once.
+FileProbes LocalStorage::probe(std::span<PhysicalPath const> paths)
+{
+  TRACE_FUNCTION();
+
+  FileProbes probes(paths.size());
+
+  if (m_directories == nullptr) {
+    for (std::size_t i{0}; i != paths.size(); ++i) {
+      probe_file(paths[i], probes[i]);
+    }
+    return probes;
+  }
+
+  // the directory of a path is what precedes its file name
+  std::vector<std::string_view> directories(paths.size());
+  std::vector<std::size_t> indexes;
+  indexes.reserve(paths.size());
+  for (std::size_t i{0}; i != paths.size(); ++i) {
+    auto const& path = paths[i].native();
+    auto const pos   = file_name_position(path);
+    if (pos == std::string::npos || pos == 0) {
+      // no file name or no directory, nothing to share
+      probe_file(paths[i], probes[i]);
+      continue;
+    }
+    // keep the slash of the root
+    directories[i] = std::string_view{path}.substr(0, pos == 1 ? 1 : pos - 1);
+    indexes.push_back(i);
+  }
+  std::stable_sort(indexes.begin(), indexes.end(),
+                   [&](std::size_t a, std::size_t b) {
+                     return directories[a] < directories[b];
+                   });
+
+  for (auto first = indexes.begin(); first != indexes.end();) {
+    auto const directory = directories[*first];
+    auto const last =
+        std::find_if(first, indexes.end(), [&](std::size_t i) {
+          return directories[i] != directory;
+        });
+
+    auto const probe_at = [&](Result<DirectoryCache::DirectoryPtr> const& dir,
+                              std::size_t i) {
+      auto const& path = paths[i].native();
+      if (dir.has_value()) {
+        probe_file_at((*dir)->fd(), path.c_str() + file_name_position(path),
+                      probes[i]);
+      } else {
+        set_stat_error(probes[i], dir.error().value());
+      }
+    };
+    auto const is_missing = [&](std::size_t i) {
+      return probes[i].type == fs::file_type::not_found;
+    };
+
+    auto const dir = m_directories->open(std::string{directory});
+    std::for_each(first, last, [&](std::size_t i) { probe_at(dir, i); });
+
+    // a cached directory may have been removed and created again, in which
+    // case its files look missing through the old descriptor
+    if (dir.has_value() && std::any_of(first, last, is_missing)) {
+      auto const current =
+          m_directories->revalidate(std::string{directory}, *dir);
+      if (!current.has_value() || *current != *dir) {
+        std::for_each(first, last, [&](std::size_t i) {
+          if (is_missing(i)) {
+            probes[i] = FileProbe{};
+            probe_at(current, i);
+          }
+        });
+      }
+    }
+    first = last;
+  }
+
+  return probes;
+}
+
 } // namespace storm
@@ -6,14 +6,34 @@
 #define STORM_LOCALSTORAGE_HPP
 
 #include "storage.hpp"
+#include <memory>
 
 namespace storm {
 
+struct DirectoryProbingConfiguration;
+class DirectoryCache;
+
+// The type of a file given its st_mode, as for fs::status
+fs::file_type to_file_type(unsigned mode);
+// Record in the probe the errno of a failed stat, as for fs::status
+void set_stat_error(FileProbe& probe, int error);
+
 struct LocalStorage : Storage
 {
+  LocalStorage();
+  // the batches are probed relative to the directories of the files
+  explicit LocalStorage(DirectoryProbingConfiguration const& config);
+  ~LocalStorage() override;
+  LocalStorage(LocalStorage&&) noexcept;
+  LocalStorage& operator=(LocalStorage&&) noexcept;
+
   Result<bool> is_in_progress(PhysicalPath const& path) override;
   Result<FileSizeInfo> file_size_info(PhysicalPath const& path) override;
   Result<bool> is_on_tape(PhysicalPath const& path) override;
+  FileProbes probe(std::span<PhysicalPath const> paths) override;
+
+ private:
+  std::unique_ptr<DirectoryCache> m_directories;
 };
 
 } // namespace storm
@@ -5,17 +5,23 @@
 #include "app.hpp"
 #include "configuration.hpp"
 #include "database.hpp"
+#include "database_caching.hpp"
+#include "database_group_commit.hpp"
 #include "database_soci.hpp"
 #include "errors.hpp"
+#include "io_uring_storage.hpp"
 #include "local_storage.hpp"
+#include "recall_watcher.hpp"
+#include "reconciler.hpp"
 #include "routes.hpp"
+#include "storage_caching.hpp"
 #include "tape_service.hpp"
 #include "telemetry.hpp"
 #include <boost/program_options.hpp>
 #include <crow.h>
 #include <fmt/core.h>
-#include <soci/sqlite3/soci-sqlite3.h>
 #include <filesystem>
+#include <optional>
 
 namespace po = boost::program_options;
 namespace fs = std::filesystem;
@@ -48,15 +54,72 @@ int main(int argc, char* argv[])
 
     storm::CrowApp app;
     app.loglevel(crow::LogLevel{config.log_level});
+    app.get_middleware<storm::AccessLogger>().open(config.access_log);
     std::uint16_t concurrency = config.concurrency;
-    soci::connection_pool db_pool{concurrency};
-    for (std::size_t i{0}; i != concurrency; ++i) {
-      db_pool.at(i).open(soci::sqlite3, "storm-tape.sqlite");
+    // a session is leased only for the duration of an operation; there are
+    // enough for the workers, the writer of the group commit, the threads of
+    // the reconciler and the recall watcher not to wait for each other
+    std::size_t const n_sessions =
+        concurrency + (config.group_commit.has_value() ? 1u : 0u)
+        + (config.reconciler.has_value() ? config.reconciler->threads : 0u)
+        + (config.recall_watcher.has_value() ? 1u : 0u);
+    soci::connection_pool db_pool{n_sessions};
+    for (std::size_t i{0}; i != n_sessions; ++i) {
+      storm::open_session(db_pool.at(i), config.database);
     }
-    storm::SociDatabase db{db_pool};
-    storm::LocalStorage storage{};
-    storm::TapeService service{config, db, storage};
+    storm::SociDatabase soci_db{db_pool, config.database.lease_timeout};
+    // the configuration does not allow both the group commit and the stage
+    // cache, which needs the writes to be committed when they return
+    std::optional<storm::GroupCommitDatabase> group_commit_db;
+    if (config.group_commit.has_value()) {
+      group_commit_db.emplace(soci_db, *config.group_commit);
+    }
+    std::optional<storm::CachingDatabase> caching_db;
+    if (config.stage_cache.has_value()) {
+      caching_db.emplace(soci_db, *config.stage_cache);
+    }
+    storm::Database& cached_db =
+        caching_db.has_value() ? static_cast<storm::Database&>(*caching_db)
+                               : soci_db;
+    storm::Database& db = group_commit_db.has_value()
+                            ? static_cast<storm::Database&>(*group_commit_db)
+                            : cached_db;
+    auto local_storage = config.directory_probing.has_value()
+                           ? storm::LocalStorage{*config.directory_probing}
+                           : storm::LocalStorage{};
+    std::optional<storm::IoUringStorage> io_uring_storage;
+    if (config.io_uring.has_value()) {
+      if (config.directory_probing.has_value()) {
+        io_uring_storage.emplace(*config.io_uring, *config.directory_probing);
+      } else {
+        io_uring_storage.emplace(*config.io_uring);
+      }
+    }
+    storm::Storage& probing_storage =
+        io_uring_storage.has_value()
+            ? static_cast<storm::Storage&>(*io_uring_storage)
+            : local_storage;
+    std::optional<storm::CachingStorage> caching_storage;
+    if (config.file_status_cache.has_value()) {
+      caching_storage.emplace(probing_storage, *config.file_status_cache);
+    }
+    storm::Storage& storage =
+        caching_storage.has_value()
+            ? static_cast<storm::Storage&>(*caching_storage)
+            : probing_storage;
+    // the watcher reacts to the changes of the files, it needs fresh probes
+    std::optional<storm::RecallWatcher> recall_watcher;
+    if (config.recall_watcher.has_value()) {
+      recall_watcher.emplace(db, probing_storage, *config.recall_watcher);
+    }
+    storm::TapeService service{
+        config, db, storage,
+        recall_watcher.has_value() ? &*recall_watcher : nullptr};
     storm::Telemetry telemetry{config};
+    std::optional<storm::Reconciler> reconciler;
+    if (config.reconciler.has_value()) {
+      reconciler.emplace(service, db, *config.reconciler);
+    }
 
     storm::create_routes(app, config, service);
     storm::create_internal_routes(app, config, service);
@@ -64,9 +127,20 @@ int main(int argc, char* argv[])
     // TODO add signals?
     app.port(config.port).concurrency(concurrency).run();
 
-    for (std::size_t i{0}; i != concurrency; ++i) {
-      db_pool.at(i).close();
+    if (caching_db.has_value()) {
+      auto const stats = caching_db->stats();
+      CROW_LOG_INFO << fmt::format(
+          "Stage cache: {} hits, {} misses, {} evictions", stats.hits,
+          stats.misses, stats.evictions);
     }
+    if (caching_storage.has_value()) {
+      auto const stats = caching_storage->stats();
+      CROW_LOG_INFO << fmt::format("File status cache: {} hits, {} misses",
+                                   stats.hits, stats.misses);
+    }
+
+    // the sessions are closed by the pool, after the databases have committed
+    // the pending writes and released their prepared statements
 
   } catch (std::exception const& e) {
     CROW_LOG_CRITICAL << fmt::format("Caught exception: {}", e.what());
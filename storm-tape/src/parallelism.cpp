@@ -0,0 +1,41 @@
+// SPDX-FileCopyrightText: 2025 Istituto Nazionale di Fisica Nucleare
+//
+// SPDX-License-Identifier: EUPL-1.2
+
+#include "parallelism.hpp"
+#include "types.hpp"
+
+#include <algorithm>
+
+namespace storm {
+
+namespace {
+
+auto make_arena(ParallelismConfiguration const& config,
+                ParallelismConfiguration::Operation const& op)
+{
+  auto const threads =
+      op.threads == 0 ? config.threads : std::min(op.threads, config.threads);
+  return tbb::task_arena{static_cast<int>(threads)};
+}
+
+} // namespace
+
+ParallelExecution::ParallelExecution(ParallelismConfiguration const& config)
+    : m_pool{tbb::global_control::max_allowed_parallelism, config.threads}
+    , m_arenas{{{make_arena(config, config.status),
+                 config.status.files_per_task},
+                {make_arena(config, config.stage), config.stage.files_per_task},
+                {make_arena(config, config.archive_info),
+                 config.archive_info.files_per_task},
+                {make_arena(config, config.take_over),
+                 config.take_over.files_per_task}}}
+{}
+
+Parallelism ParallelExecution::operator()(Operation op)
+{
+  auto& [arena, files_per_task] = m_arenas[to_underlying(op)];
+  return Parallelism{arena, files_per_task};
+}
+
+} // namespace storm
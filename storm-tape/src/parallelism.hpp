@@ -0,0 +1,81 @@
+// SPDX-FileCopyrightText: 2025 Istituto Nazionale di Fisica Nucleare
+//
+// SPDX-License-Identifier: EUPL-1.2
+
+#ifndef STORM_PARALLELISM_HPP
+#define STORM_PARALLELISM_HPP
+
+#include "configuration.hpp"
+
+#include <tbb/blocked_range.h>
+#include <tbb/global_control.h>
+#include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
+#include <array>
+#include <cstddef>
+#include <optional>
+
+namespace storm {
+
+// How a loop over the files of a request is run in parallel: in the given
+// arena, which bounds the number of threads, and only if there are more files
+// than can be processed by a single task
+struct Parallelism
+{
+  tbb::task_arena& arena;
+  std::size_t files_per_task;
+};
+
+// Call body(first, last) on consecutive ranges of the indexes [0, n), which
+// cover all of them. The ranges are processed in parallel if so configured and
+// if there is more than one of them, otherwise there is a single range.
+template<typename Body>
+void for_each_range(std::size_t n,
+                    std::optional<Parallelism> const& parallelism, Body body)
+{
+  if (parallelism.has_value() && n > parallelism->files_per_task) {
+    parallelism->arena.execute([&] {
+      tbb::parallel_for(tbb::blocked_range<std::size_t>{
+                            0, n, parallelism->files_per_task},
+                        [&](tbb::blocked_range<std::size_t> const& range) {
+                          body(range.begin(), range.end());
+                        });
+    });
+  } else {
+    body(std::size_t{0}, n);
+  }
+}
+
+// The pool of threads shared by the parallel loops of all the requests and the
+// arenas bounding the threads available to each operation. The size of the
+// pool is enforced on the whole process.
+class ParallelExecution
+{
+ public:
+  enum class Operation
+  {
+    status,
+    stage,
+    archive_info,
+    take_over
+  };
+
+ private:
+  struct OperationArena
+  {
+    tbb::task_arena arena;
+    std::size_t files_per_task;
+  };
+
+  tbb::global_control m_pool;
+  std::array<OperationArena, 4> m_arenas;
+
+ public:
+  explicit ParallelExecution(ParallelismConfiguration const& config);
+
+  Parallelism operator()(Operation op);
+};
+
+} // namespace storm
+
+#endif
@@ -0,0 +1,298 @@
+// SPDX-FileCopyrightText: 2025 Istituto Nazionale di Fisica Nucleare
+//
+// SPDX-License-Identifier: EUPL-1.2
+
+#include "recall_watcher.hpp"
+#include "database.hpp"
+#include "extended_file_status.hpp"
+#include "stage_request.hpp"
+#include "storage.hpp"
+#include "trace_span.hpp"
+
+#include <boost/assert.hpp>
+#include <crow/logging.h>
+#include <fmt/std.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <exception>
+#include <system_error>
+#include <vector>
+
+namespace storm {
+
+RecallWatcher::RecallWatcher(Database& db, Storage& storage,
+                             RecallWatcherConfiguration const& config)
+    : m_db{db}
+    , m_storage{storage}
+    , m_config{config}
+{
+  m_fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (m_fd == -1) {
+    throw std::system_error(errno, std::generic_category(), "inotify_init1");
+  }
+  m_stop_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (m_stop_fd == -1) {
+    auto const err = errno;
+    ::close(m_fd);
+    throw std::system_error(err, std::generic_category(), "eventfd");
+  }
+
+  m_thread = std::jthread{[this](std::stop_token stop) { run(stop); }};
+}
+
+RecallWatcher::~RecallWatcher()
+{
+  m_thread.request_stop();
+  std::uint64_t const one{1};
+  [[maybe_unused]] auto _ = ::write(m_stop_fd, &one, sizeof(one));
+  m_thread.join();
+  ::close(m_stop_fd);
+  ::close(m_fd);
+}
+
+std::size_t RecallWatcher::size() const
+{
+  std::lock_guard lock{m_mutex};
+  return m_n_files;
+}
+
+void RecallWatcher::watch(std::span<PhysicalPath const> paths)
+{
+  TRACE_FUNCTION();
+  std::lock_guard lock{m_mutex};
+  for (auto const& path : paths) {
+    auto dir  = path.parent_path().string();
+    auto name = path.filename().string();
+
+    auto it = m_directories.find(dir);
+    if (it != m_directories.end()) {
+      if (auto const file = it->second.files.find(name);
+          file != it->second.files.end()) {
+        ++file->second;
+        continue;
+      }
+    }
+    if (m_n_files == m_config.max_files) {
+      CROW_LOG_DEBUG << fmt::format("Too many watched files, not watching {}",
+                                    path);
+      continue;
+    }
+    if (it == m_directories.end()) {
+      if (m_directories.size() == m_config.max_directories) {
+        CROW_LOG_DEBUG << fmt::format(
+            "Too many watched directories, not watching {}", path);
+        continue;
+      }
+      auto const wd =
+          ::inotify_add_watch(m_fd, dir.c_str(), IN_ATTRIB | IN_CLOSE_WRITE);
+      if (wd == -1) {
+        CROW_LOG_WARNING << fmt::format("Cannot watch directory {}: {}", dir,
+                                        std::strerror(errno));
+        continue;
+      }
+      m_wds.emplace(wd, dir);
+      it = m_directories.emplace(std::move(dir), Directory{wd, {}}).first;
+    }
+    it->second.files.emplace(std::move(name), 1);
+    ++m_n_files;
+  }
+}
+
+// A file started by a take-over or by a status is started at once for all the
+// stages that contain it, but is counted only once. So the last reference is
+// released only if the database confirms that no other stage waits for it.
+void RecallWatcher::unwatch(std::span<PhysicalPath const> paths)
+{
+  TRACE_FUNCTION();
+  PhysicalPaths last;
+  {
+    std::lock_guard lock{m_mutex};
+    for (auto const& path : paths) {
+      if (auto const n = find(path); n != nullptr && *n == 1) {
+        last.push_back(path);
+      } else {
+        unwatch(path, false);
+      }
+    }
+  }
+
+  // if the database cannot be read, the files are left watched until the end
+  // of their recalls
+  std::vector<std::size_t> n_stages(last.size(), 1);
+  try {
+    for (std::size_t i{0}; i != last.size(); ++i) {
+      n_stages[i] = m_db.count_stages(last[i], File::State::started);
+    }
+  } catch (std::exception const& e) {
+    CROW_LOG_ERROR << fmt::format("Cannot count the stages of a file: {}",
+                                  e.what());
+  }
+
+  std::lock_guard lock{m_mutex};
+  for (std::size_t i{0}; i != last.size(); ++i) {
+    if (n_stages[i] == 0) {
+      unwatch(last[i], false);
+    } else if (auto const n = find(last[i]); n != nullptr) {
+      *n = std::max(*n, n_stages[i]);
+    }
+  }
+}
+
+void RecallWatcher::forget(std::span<PhysicalPath const> paths)
+{
+  TRACE_FUNCTION();
+  std::lock_guard lock{m_mutex};
+  for (auto const& path : paths) {
+    unwatch(path, true);
+  }
+}
+
+// The number of stages waiting for the file, if watched; to be called with the
+// lock held
+std::size_t* RecallWatcher::find(PhysicalPath const& path)
+{
+  auto const it = m_directories.find(path.parent_path().string());
+  if (it == m_directories.end()) {
+    return nullptr;
+  }
+  auto const file = it->second.files.find(path.filename().string());
+  return file == it->second.files.end() ? nullptr : &file->second;
+}
+
+// Release one reference to the file, or all of them; to be called with the
+// lock held
+void RecallWatcher::unwatch(PhysicalPath const& path, bool all)
+{
+  auto const it = m_directories.find(path.parent_path().string());
+  if (it == m_directories.end()) {
+    return;
+  }
+  auto& directory = it->second;
+  auto const file = directory.files.find(path.filename().string());
+  if (file == directory.files.end()) {
+    return;
+  }
+  if (!all && --file->second != 0) {
+    return;
+  }
+  directory.files.erase(file);
+  --m_n_files;
+  if (directory.files.empty()) {
+    // the IN_IGNORED event that follows finds no directory for the wd
+    ::inotify_rm_watch(m_fd, directory.wd);
+    m_wds.erase(directory.wd);
+    m_directories.erase(it);
+  }
+}
+
+// A watched file has changed; the logic is the same as for a started file in
+// the status, but a file that cannot be probed is left to the polling.
+void RecallWatcher::on_change(PhysicalPath const& path)
+{
+  TRACE_FUNCTION();
+  ExtendedFileStatus status{m_storage, path};
+  if (status.is_in_progress() || !status) {
+    return;
+  }
+  auto const is_stub = status.is_stub();
+  if (!status) {
+    return;
+  }
+  auto const state = is_stub ? File::State::failed : File::State::completed;
+
+  m_db.update(path, state, std::time(nullptr));
+  CROW_LOG_DEBUG << fmt::format("Recall of {} is over", path);
+
+  std::lock_guard lock{m_mutex};
+  unwatch(path, true);
+}
+
+void RecallWatcher::run(std::stop_token stop)
+{
+  std::array<pollfd, 2> fds{{{m_fd, POLLIN, 0}, {m_stop_fd, POLLIN, 0}}};
+  alignas(inotify_event) std::array<char, 64 * 1024> buffer;
+  std::vector<PhysicalPath> changed;
+
+  // the files started before the service was (re)started; loaded here, so
+  // that the database is accessed only from this thread
+  {
+    PhysicalPaths started;
+    for (auto const& id : m_db.find_incomplete_stages()) {
+      if (auto stage = m_db.find(id); stage.has_value()) {
+        for (auto& file : stage->files) {
+          if (file.state == File::State::started) {
+            started.push_back(std::move(file.physical_path));
+          }
+        }
+      }
+    }
+    watch(started);
+  }
+
+  while (!stop.stop_requested()) {
+    if (::poll(fds.data(), fds.size(), -1) == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      CROW_LOG_ERROR << fmt::format("Recall watcher stopped: {}",
+                                    std::strerror(errno));
+      return;
+    }
+    if (fds[1].revents != 0) {
+      return;
+    }
+
+    auto const n = ::read(m_fd, buffer.data(), buffer.size());
+    if (n <= 0) {
+      continue;
+    }
+
+    changed.clear();
+    {
+      std::lock_guard lock{m_mutex};
+      for (auto p = buffer.data(); p < buffer.data() + n;) {
+        auto const event = reinterpret_cast<inotify_event const*>(p);
+        p += sizeof(inotify_event) + event->len;
+
+        auto const wd_it = m_wds.find(event->wd);
+        if (wd_it == m_wds.end()) {
+          continue;
+        }
+        auto const dir_it = m_directories.find(wd_it->second);
+        BOOST_ASSERT(dir_it != m_directories.end());
+
+        if ((event->mask & IN_IGNORED) != 0) {
+          // the directory has been removed, together with its files
+          m_n_files -= dir_it->second.files.size();
+          m_directories.erase(dir_it);
+          m_wds.erase(wd_it);
+          continue;
+        }
+
+        if (event->len == 0) {
+          continue;
+        }
+        std::string const name{event->name};
+        if (dir_it->second.files.contains(name)) {
+          changed.push_back(PhysicalPath{fs::path{dir_it->first} / name});
+        }
+      }
+    }
+
+    // a recall usually generates many events for the same file
+    std::sort(changed.begin(), changed.end());
+    changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+    for (auto const& path : changed) {
+      on_change(path);
+    }
+  }
+}
+
+} // namespace storm
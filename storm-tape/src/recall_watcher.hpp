@@ -0,0 +1,83 @@
+// SPDX-FileCopyrightText: 2025 Istituto Nazionale di Fisica Nucleare
+//
+// SPDX-License-Identifier: EUPL-1.2
+
+#ifndef STORM_RECALL_WATCHER_HPP
+#define STORM_RECALL_WATCHER_HPP
+
+#include "configuration.hpp"
+#include "types.hpp"
+
+#include <cstddef>
+#include <mutex>
+#include <span>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+namespace storm {
+
+class Database;
+struct Storage;
+
+// Detects the completion of the recalls from the inotify events of the
+// directories containing the started files: a change of the xattrs
+// (IN_ATTRIB) or of the content (IN_CLOSE_WRITE) of a watched file makes it
+// probed again and, if the recall is over, its new state stored.
+//
+// A file is watched once for each stage that waits for it and stops being
+// watched when no stage waits for it anymore, as confirmed by the database, or
+// when its recall is over. A directory is watched as long as it contains at
+// least one watched file. The numbers of watched directories and files are
+// bounded; the files that do not fit are left to the polling of the status and
+// of the reconciler.
+class RecallWatcher
+{
+  struct Directory
+  {
+    int wd;
+    // the names of the watched files, with the number of stages waiting for
+    // each of them
+    std::unordered_map<std::string, std::size_t> files;
+  };
+
+  Database& m_db;
+  Storage& m_storage;
+  RecallWatcherConfiguration m_config;
+  int m_fd{-1};
+  // wakes up the thread when it has to stop
+  int m_stop_fd{-1};
+  mutable std::mutex m_mutex;
+  std::unordered_map<std::string, Directory> m_directories;
+  std::unordered_map<int, std::string> m_wds;
+  std::size_t m_n_files{0};
+  std::jthread m_thread;
+
+  void run(std::stop_token stop);
+  void on_change(PhysicalPath const& path);
+  std::size_t* find(PhysicalPath const& path);
+  void unwatch(PhysicalPath const& path, bool all);
+
+ public:
+  RecallWatcher(Database& db, Storage& storage,
+                RecallWatcherConfiguration const& config);
+  ~RecallWatcher();
+  RecallWatcher(RecallWatcher const&)            = delete;
+  RecallWatcher& operator=(RecallWatcher const&) = delete;
+  RecallWatcher(RecallWatcher&&)                 = delete;
+  RecallWatcher& operator=(RecallWatcher&&)      = delete;
+
+  // a stage waits for the recall of the files
+  void watch(std::span<PhysicalPath const> paths);
+  // a stage does not wait for the recall of the files anymore
+  void unwatch(std::span<PhysicalPath const> paths);
+  // the recalls of the files are over, for all the stages
+  void forget(std::span<PhysicalPath const> paths);
+  // the number of watched files
+  std::size_t size() const;
+};
+
+} // namespace storm
+
+#endif
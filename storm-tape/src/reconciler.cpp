@@ -0,0 +1,67 @@
+// SPDX-FileCopyrightText: 2025 Istituto Nazionale di Fisica Nucleare
+//
+// SPDX-License-Identifier: EUPL-1.2
+
+#include "reconciler.hpp"
+#include "database.hpp"
+#include "stage_request.hpp"
+#include "tape_service.hpp"
+#include "trace_span.hpp"
+
+#include <crow/logging.h>
+#include <fmt/core.h>
+#include <functional>
+
+namespace storm {
+
+// The threads are started here and stopped by the destructor of the jthreads,
+// which also wakes them up if they are waiting for the next visit. They are
+// never replaced, because each of them keeps its own database session.
+Reconciler::Reconciler(TapeService& service, Database const& db,
+                       ReconcilerConfiguration const& config)
+    : m_service{service}
+    , m_db{db}
+    , m_config{config}
+{
+  m_threads.reserve(m_config.threads);
+  for (std::size_t i{0}; i != m_config.threads; ++i) {
+    m_threads.emplace_back(
+        [this, i](std::stop_token stop) { run(std::move(stop), i); });
+  }
+}
+
+std::size_t Reconciler::visit(std::size_t partition, std::size_t n_partitions)
+{
+  TRACE_FUNCTION();
+  std::size_t n_visited{0};
+  for (auto const& id : m_db.find_incomplete_stages()) {
+    if (std::hash<StageId>{}(id) % n_partitions != partition) {
+      continue;
+    }
+    m_service.reconcile(id);
+    ++n_visited;
+  }
+  return n_visited;
+}
+
+void Reconciler::run(std::stop_token stop, std::size_t partition)
+{
+  while (!stop.stop_requested()) {
+    try {
+      auto const n_visited = visit(partition, m_config.threads);
+      CROW_LOG_DEBUG << fmt::format("Reconciled {} stages", n_visited);
+    } catch (std::exception const& e) {
+      CROW_LOG_ERROR << fmt::format("Reconciliation failed: {}", e.what());
+    }
+
+    std::unique_lock lock{m_mutex};
+    m_cv.wait_for(lock, stop, m_config.interval, [] { return false; });
+  }
+}
+
+std::size_t Reconciler::reconcile()
+{
+  return visit(0, 1);
+}
+
+} // namespace storm
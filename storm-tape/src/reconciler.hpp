@@ -0,0 +1,49 @@
+// SPDX-FileCopyrightText: 2025 Istituto Nazionale di Fisica Nucleare
+//
+// SPDX-License-Identifier: EUPL-1.2
+
+#ifndef STORM_RECONCILER_HPP
+#define STORM_RECONCILER_HPP
+
+#include "configuration.hpp"
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+namespace storm {
+
+class Database;
+class TapeService;
+
+// Periodically brings the stored state of the incomplete stages in line with
+// the storage, so that a status does not need to probe it. The incomplete
+// stages are partitioned by id among the threads, each visiting its own
+// partition at the configured interval.
+class Reconciler
+{
+  TapeService& m_service;
+  Database const& m_db;
+  ReconcilerConfiguration m_config;
+  std::mutex m_mutex;
+  std::condition_variable_any m_cv;
+  std::vector<std::jthread> m_threads;
+
+  std::size_t visit(std::size_t partition, std::size_t n_partitions);
+  void run(std::stop_token stop, std::size_t partition);
+
+ public:
+  Reconciler(TapeService& service, Database const& db,
+             ReconcilerConfiguration const& config);
+
+  // visit all the incomplete stages once, from the calling thread; return the
+  // number of stages visited
+  std::size_t reconcile();
+};
+
+} // namespace storm
+
+#endif
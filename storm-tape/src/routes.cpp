@@ -39,6 +39,7 @@ void create_routes(CrowApp& app, [[maybe_unused]] Configuration const& config,
           StageRequest request{from_json(req.body, StageRequest::tag),
                                std::time(nullptr), 0, 0};
           span.set_batch_size(request.files.size());
+          access_logger.n_files = request.files.size();
           auto resp              = service.stage(std::move(request));
           auto crow_resp         = to_crow_response(resp);
           access_logger.stage_id = resp.id();
@@ -63,6 +64,7 @@ void create_routes(CrowApp& app, [[maybe_unused]] Configuration const& config,
     app.get_context<AccessLogger>(req).stage_id  = id;
     try {
       auto resp = service.status(StageId{id});
+      app.get_context<AccessLogger>(req).n_files = resp.stage().files.size();
       return to_crow_response(resp);
     } catch (HttpError const& e) {
       CROW_LOG_ERROR << e.what();
@@ -85,6 +87,7 @@ void create_routes(CrowApp& app, [[maybe_unused]] Configuration const& config,
             try {
               CancelRequest cancel{from_json(req.body, CancelRequest::tag)};
               span.set_batch_size(cancel.paths.size());
+              app.get_context<AccessLogger>(req).n_files = cancel.paths.size();
               auto resp = service.cancel(StageId{id}, std::move(cancel));
               if (resp.invalid.empty()) {
                 return crow::response{crow::status::OK};
@@ -106,7 +109,8 @@ void create_routes(CrowApp& app, [[maybe_unused]] Configuration const& config,
       .methods("DELETE"_method)(
           [&](crow::request const& req, std::string const& id) {
             TraceSpan span{"/stage/{id}", req, "DELETE"};
-            app.get_context<AccessLogger>(req).stage_id = id;
+            app.get_context<AccessLogger>(req).operation = "DELETE";
+            app.get_context<AccessLogger>(req).stage_id  = id;
             try {
               auto const resp = service.erase(StageId{id});
               return to_crow_response(resp);
@@ -131,6 +135,8 @@ void create_routes(CrowApp& app, [[maybe_unused]] Configuration const& config,
             try {
               ReleaseRequest release{from_json(req.body, ReleaseRequest::tag)};
               span.set_batch_size(release.paths.size());
+              app.get_context<AccessLogger>(req).n_files =
+                  release.paths.size();
               auto resp = service.release(StageId{id}, std::move(release));
               if (resp.invalid.empty()) {
                 return crow::response{crow::status::OK};
@@ -155,6 +161,7 @@ void create_routes(CrowApp& app, [[maybe_unused]] Configuration const& config,
         try {
           ArchiveInfoRequest info{from_json(req.body, ArchiveInfoRequest::tag)};
           span.set_batch_size(info.paths.size());
+          app.get_context<AccessLogger>(req).n_files = info.paths.size();
           auto const resp = service.archive_info(std::move(info));
           return to_crow_response(resp);
         } catch (HttpError const& e) {
@@ -202,6 +209,7 @@ void create_internal_routes(CrowApp& app, storm::Configuration const&,
               from_body_params(req.body, TakeOverRequest::tag)};
           auto const resp = service.take_over(take_over);
           span.set_batch_size(resp.paths.size());
+          app.get_context<AccessLogger>(req).n_files = resp.paths.size();
           return to_crow_response(resp);
         } catch (HttpError const& e) {
           CROW_LOG_ERROR << e.what();
@@ -224,6 +232,7 @@ void create_internal_routes(CrowApp& app, storm::Configuration const&,
           from_query_params(req.url_params, InProgressRequest::tag);
       auto resp = service.in_progress(in_progress);
       span.set_batch_size(resp.paths.size());
+      app.get_context<AccessLogger>(req).n_files = resp.paths.size();
       return to_crow_response(resp);
     } catch (HttpError const& e) {
       CROW_LOG_ERROR << e.what();
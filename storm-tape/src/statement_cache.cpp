@@ -0,0 +1,48 @@
+// SPDX-FileCopyrightText: 2025 Istituto Nazionale di Fisica Nucleare
+//
+// SPDX-License-Identifier: EUPL-1.2
+
+#include "statement_cache.hpp"
+#include <soci/sqlite3/soci-sqlite3.h>
+#include <string>
+
+namespace storm {
+
+BoundStatement::BoundStatement(soci::statement& st)
+    : m_st{&st}
+{
+  try {
+    m_st->define_and_bind();
+  } catch (...) {
+    m_st->bind_clean_up();
+    throw;
+  }
+}
+
+BoundStatement::~BoundStatement()
+{
+  // a query stepped to its first row keeps a read transaction open until it is
+  // reset, pinning the session to an old snapshot of the database
+  if (auto const backend = dynamic_cast<soci::sqlite3_statement_backend*>(
+          m_st->get_backend())) {
+    sqlite_api::sqlite3_reset(backend->stmt_);
+  }
+  try {
+    m_st->bind_clean_up();
+  } catch (...) {
+  }
+}
+
+soci::statement& StatementCache::get(std::string_view query)
+{
+  auto it = m_statements.find(query);
+  if (it == m_statements.end()) {
+    auto st = std::make_unique<soci::statement>(m_sql);
+    st->alloc();
+    st->prepare(std::string{query});
+    it = m_statements.emplace(query, std::move(st)).first;
+  }
+  return *it->second;
+}
+
+} // namespace storm
@@ -0,0 +1,78 @@
+// SPDX-FileCopyrightText: 2025 Istituto Nazionale di Fisica Nucleare
+//
+// SPDX-License-Identifier: EUPL-1.2
+
+#ifndef STORM_STATEMENT_CACHE_HPP
+#define STORM_STATEMENT_CACHE_HPP
+
+#include <soci/soci.h>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+namespace storm {
+
+// A statement of a StatementCache with its parameters bound for one execution.
+// The statement is reset and its bindings are released on destruction, leaving
+// it prepared for the next use.
+class BoundStatement
+{
+  soci::statement* m_st;
+
+ public:
+  explicit BoundStatement(soci::statement& st);
+  ~BoundStatement();
+  BoundStatement(BoundStatement const&)            = delete;
+  BoundStatement& operator=(BoundStatement const&) = delete;
+  BoundStatement(BoundStatement&&)                 = delete;
+  BoundStatement& operator=(BoundStatement&&)      = delete;
+
+  bool execute(bool with_data_exchange = false)
+  {
+    return m_st->execute(with_data_exchange);
+  }
+  bool fetch()
+  {
+    return m_st->fetch();
+  }
+  long long affected_rows()
+  {
+    return m_st->get_affected_rows();
+  }
+};
+
+// Prepared statements of a session, keyed by their query. A query is prepared
+// the first time it is requested; afterwards only its parameters are bound
+// again. Queries are expected to be string literals, which outlive the cache.
+// Not thread-safe: a session, and its cache, is used by one thread at a time.
+class StatementCache
+{
+  soci::session& m_sql;
+  std::unordered_map<std::string_view, std::unique_ptr<soci::statement>>
+      m_statements;
+
+  soci::statement& get(std::string_view query);
+
+ public:
+  explicit StatementCache(soci::session& sql)
+      : m_sql{sql}
+  {}
+
+  template<typename... Elements>
+  BoundStatement bind(std::string_view query, Elements&&... elements)
+  {
+    auto& st = get(query);
+    try {
+      (st.exchange(std::forward<Elements>(elements)), ...);
+    } catch (...) {
+      st.bind_clean_up();
+      throw;
+    }
+    return BoundStatement{st};
+  }
+};
+
+} // namespace storm
+
+#endif
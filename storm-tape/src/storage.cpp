@@ -0,0 +1,78 @@
+// SPDX-FileCopyrightText: 2025 Istituto Nazionale di Fisica Nucleare
+//
+// SPDX-License-Identifier: EUPL-1.2
+
+#include "storage.hpp"
+#include "extended_attributes.hpp"
+#include "trace_span.hpp"
+
+namespace storm {
+
+Locality FileProbe::locality() const noexcept
+{
+  if (error != std::error_code{}) {
+    return Locality::unavailable;
+  }
+
+  bool const is_on_disk{!(is_stub() || in_progress)};
+
+  if (is_on_disk) {
+    return migrated ? Locality::disk_and_tape : Locality::disk;
+  } else {
+    return migrated ? Locality::tape : Locality::lost;
+  }
+}
+
+FileProbes Storage::probe(std::span<PhysicalPath const> paths)
+{
+  TRACE_FUNCTION();
+
+  FileProbes probes(paths.size());
+
+  for (std::size_t i{0}; i != paths.size(); ++i) {
+    auto const& path = paths[i];
+    auto& probe      = probes[i];
+
+    probe.type = fs::status(path, probe.error).type();
+    if (probe.error != std::error_code{}) {
+      continue;
+    }
+
+    if (auto result = file_size_info(path)) {
+      // as blocks, round a stub down and a file on disk up
+      probe.size   = result->size;
+      probe.blocks = result->is_stub ? 0 : (result->size + 511) / 512;
+    } else {
+      probe.error = result.error();
+      continue;
+    }
+    if (auto result = is_in_progress(path)) {
+      probe.in_progress = *result;
+    } else {
+      probe.error = result.error();
+      continue;
+    }
+    if (auto result = is_on_tape(path)) {
+      probe.migrated = *result;
+    } else {
+      probe.error = result.error();
+    }
+  }
+
+  return probes;
+}
+
+std::vector<std::error_code>
+Storage::request_recall(std::span<PhysicalPath const> paths)
+{
+  TRACE_FUNCTION();
+
+  XAttrName const tsm_rect{"user.TSMRecT"};
+  std::vector<std::error_code> errors(paths.size());
+  for (std::size_t i{0}; i != paths.size(); ++i) {
+    create_xattr(paths[i], tsm_rect, errors[i]);
+  }
+  return errors;
+}
+
+} // namespace storm
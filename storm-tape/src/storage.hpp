@@ -6,15 +6,52 @@
 #define STORM_STORAGE_HPP
 
 #include "types.hpp"
+#include <cstddef>
+#include <span>
+#include <system_error>
+#include <vector>
 
 namespace storm {
 
+// What is known about a file after probing the storage once
+struct FileProbe
+{
+  // not_found if the file doesn't exist, none if it couldn't be probed
+  fs::file_type type{fs::file_type::none};
+  std::size_t size{0};
+  // 512-byte blocks allocated on disk
+  std::size_t blocks{0};
+  bool in_progress{false};
+  bool migrated{false};
+  std::error_code error{};
+
+  explicit operator bool() const noexcept
+  {
+    return error == std::error_code{};
+  }
+  bool is_stub() const noexcept
+  {
+    return blocks * 512 < size;
+  }
+  Locality locality() const noexcept;
+};
+
+using FileProbes = std::vector<FileProbe>;
+
 struct Storage
 {
   virtual ~Storage()                                            = default;
   virtual Result<bool> is_in_progress(PhysicalPath const& path) = 0;
   virtual Result<FileSizeInfo> file_size_info(PhysicalPath const& path) = 0;
   virtual Result<bool> is_on_tape(PhysicalPath const& path)             = 0;
+  // One probe per path, in the same order. The default implementation
+  // relies on the calls above, one path at a time.
+  virtual FileProbes probe(std::span<PhysicalPath const> paths);
+  // Mark the files for recall, setting the user.TSMRecT xattr that GEMSS
+  // looks for. One error per path, in the same order; a file already marked
+  // is not an error.
+  virtual std::vector<std::error_code>
+  request_recall(std::span<PhysicalPath const> paths);
 };
 
 } // namespace storm
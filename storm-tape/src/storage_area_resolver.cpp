@@ -3,92 +3,161 @@
 // SPDX-License-Identifier: EUPL-1.2
 
 #include "storage_area_resolver.hpp"
-#include "errors.hpp"
-#include "trace_span.hpp"
+#include <boost/assert.hpp>
 #include <algorithm>
-#include <memory>
-#include <numeric>
-#include <optional>
 
 namespace storm {
 
 namespace {
 
-using PrefixMatchOpt = std::optional<std::ptrdiff_t>;
-
-PrefixMatchOpt prefix_match(LogicalPath const& path, LogicalPath const& ap)
+// The next component of a path, starting at pos and skipping the separators
+// before it, if any. An empty component means the end of the path.
+std::string_view next_component(std::string_view path, std::size_t& pos)
 {
-  TRACE_FUNCTION();
-
-  auto [_, it] = std::mismatch(path.begin(), path.end(), ap.begin(), ap.end());
-  if (it == ap.end()) {
-    // full prefix match
-    return std::distance(ap.begin(), it);
-  } else {
-    return std::nullopt;
+  while (pos != path.size() && path[pos] == '/') {
+    ++pos;
   }
+  auto const end = std::min(path.find('/', pos), path.size());
+  auto const component = path.substr(pos, end - pos);
+  pos                  = end;
+  return component;
 }
 
-struct BestMatch
+// Whether a path has "." or ".." components. Repeated separators are instead
+// accepted, as they are by the comparison of std::filesystem paths.
+bool has_dot_components(std::string_view path)
 {
-  std::ptrdiff_t match_size{};
-  LogicalPath const* path{nullptr};
-  StorageArea const* sa{nullptr};
-  friend auto operator<(BestMatch const& bm1, BestMatch const& bm2)
-  {
-    return bm1.match_size < bm2.match_size;
+  for (std::size_t pos{0};;) {
+    auto const component = next_component(path, pos);
+    if (component.empty()) {
+      return false;
+    }
+    if (component == "." || component == "..") {
+      return true;
+    }
   }
-};
-
-using BestMatchOpt = std::optional<BestMatch>;
+}
 
 } // namespace
 
+StorageAreaResolver::StorageAreaResolver(StorageAreas const& sas)
+    : m_nodes(1)
+{
+  BOOST_ASSERT(!sas.empty());
+
+  for (auto const& sa : sas) {
+    auto const root_index = m_roots.size();
+    m_roots.push_back(sa.root);
+
+    for (auto const& ap : sa.access_points) {
+      auto const normal = ap.lexically_normal();
+      std::string_view const ap_view{normal.native()};
+      BOOST_ASSERT(normal.is_absolute());
+
+      std::size_t node{0};
+      for (std::size_t pos{0};;) {
+        auto const component = next_component(ap_view, pos);
+        if (component.empty()) {
+          break;
+        }
+        if (auto child = find_child(node, component); child.has_value()) {
+          node = *child;
+        } else {
+          auto const new_node = m_nodes.size();
+          m_nodes.emplace_back();
+          auto& children = m_nodes[node].children;
+          auto it        = std::lower_bound(
+              children.begin(), children.end(), component,
+              [](auto const& child, std::string_view c) {
+                return child.first < c;
+              });
+          children.emplace(it, std::string{component}, new_node);
+          node = new_node;
+        }
+      }
+      // the configuration rejects access points in common to two storage
+      // areas; in any case the first one wins
+      if (!m_nodes[node].root.has_value()) {
+        m_nodes[node].root = root_index;
+      }
+    }
+  }
+}
+
+std::optional<std::size_t>
+StorageAreaResolver::find_child(std::size_t node,
+                                std::string_view component) const
+{
+  auto const& children = m_nodes[node].children;
+  auto it              = std::lower_bound(
+      children.begin(), children.end(), component,
+      [](auto const& child, std::string_view c) { return child.first < c; });
+  if (it != children.end() && it->first == component) {
+    return it->second;
+  }
+  return std::nullopt;
+}
+
 PhysicalPath StorageAreaResolver::operator()(LogicalPath const& path) const
 {
-  TRACE_FUNCTION();
+  std::string_view const p{path.native()};
 
-  if (path.is_relative() || path != path.lexically_normal()) {
+  if (path.is_relative() || has_dot_components(p)) {
     return PhysicalPath{};
   }
 
-  BOOST_ASSERT(!m_sas.empty());
-
-  // find the access point that is the longest prefix of the path, with the
-  // corresponding SA
-  auto best_match = std::transform_reduce(
-      m_sas.begin(), m_sas.end(), BestMatchOpt{},
-      [](BestMatchOpt const& bm1, BestMatchOpt const& bm2) {
-        return std::max(bm1, bm2);
-      },
-      [&](StorageArea const& sa) -> BestMatchOpt {
-        // find the access point in this SA that is the longest prefix of the
-        // path, if it exists
-        auto ap_it = std::max_element(
-            sa.access_points.begin(), sa.access_points.end(),
-            [&](auto& ap1, auto& ap2) {
-              return prefix_match(path, ap1) < prefix_match(path, ap2);
-            });
-        if (auto m = prefix_match(path, *ap_it); m.has_value()) {
-          return BestMatch{*m, std::to_address(ap_it), std::addressof(sa)};
-        } else {
-          return std::nullopt;
-        }
-      });
+  // walk down the trie, remembering the deepest node that is an access point
+  // and where it ends in the path
+  std::optional<std::size_t> root = m_nodes[0].root;
+  std::size_t match_end{0};
+  std::size_t node{0};
+  for (std::size_t pos{0};;) {
+    auto const component = next_component(p, pos);
+    if (component.empty()) {
+      break;
+    }
+    auto const child = find_child(node, component);
+    if (!child.has_value()) {
+      break;
+    }
+    node = *child;
+    if (m_nodes[node].root.has_value()) {
+      root      = m_nodes[node].root;
+      match_end = pos;
+    }
+  }
 
-  if (!best_match) {
+  if (!root.has_value()) {
     return PhysicalPath{};
   }
 
-  auto const rel_path = path.lexically_relative(*best_match->path);
-  BOOST_ASSERT(!rel_path.empty());
+  auto const& sa_root = m_roots[*root].native();
+  auto rel_path       = p.substr(match_end);
+  rel_path.remove_prefix(
+      std::min(rel_path.find_first_not_of('/'), rel_path.size()));
 
-  if (rel_path == ".") {
+  if (rel_path.empty()) {
     // path is exactly the access point
-    return best_match->sa->root;
+    return m_roots[*root];
   }
 
-  return static_cast<PhysicalPath>(best_match->sa->root / rel_path);
+  std::string result;
+  result.reserve(sa_root.size() + 1 + rel_path.size());
+  result += sa_root;
+  if (result.empty() || result.back() != '/') {
+    result += '/';
+  }
+  if (rel_path.find("//") == std::string_view::npos) {
+    result += rel_path;
+  } else {
+    // the repeated separators are collapsed
+    for (std::size_t i{0}; i != rel_path.size(); ++i) {
+      if (rel_path[i] != '/' || rel_path[i - 1] != '/') {
+        result += rel_path[i];
+      }
+    }
+  }
+  return PhysicalPath{std::move(result)};
 }
 
 } // namespace storm
@@ -6,17 +6,35 @@
 #define STORM_STORAGE_AREA_RESOLVER_HPP
 
 #include "configuration.hpp"
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
 
 namespace storm {
 
+// The access points of the storage areas, compiled in a trie of path
+// components. A logical path is resolved in a single pass over its components,
+// selecting the longest access point that is a prefix of it.
 class StorageAreaResolver
 {
-  StorageAreas const& m_sas;
+  struct Node
+  {
+    // sorted by component
+    std::vector<std::pair<std::string, std::size_t>> children;
+    // the index of the root of the storage area whose access point ends here
+    std::optional<std::size_t> root;
+  };
+
+  // m_nodes[0] corresponds to "/"
+  std::vector<Node> m_nodes;
+  std::vector<PhysicalPath> m_roots;
+
+  std::optional<std::size_t> find_child(std::size_t node,
+                                        std::string_view component) const;
 
  public:
-  StorageAreaResolver(StorageAreas const& sas)
-      : m_sas{sas}
-  {}
+  StorageAreaResolver(StorageAreas const& sas);
   PhysicalPath operator()(LogicalPath const& path) const;
 };
 
@@ -0,0 +1,154 @@
+// SPDX-FileCopyrightText: 2025 Istituto Nazionale di Fisica Nucleare
+//
+// SPDX-License-Identifier: EUPL-1.2
+
+#include "storage_caching.hpp"
+#include "trace_span.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+
+namespace storm {
+
+namespace {
+
+// a probe is worth remembering if it reflects the state of the file, also when
+// the file doesn't exist, but not if the storage failed
+bool is_cacheable(FileProbe const& probe)
+{
+  return probe || probe.type == fs::file_type::not_found;
+}
+
+} // namespace
+
+CachingStorage::CachingStorage(Storage& storage,
+                               FileStatusCacheConfiguration const& config)
+    : m_storage{storage}
+    , m_ttl{config.ttl}
+    , m_shard_capacity{std::max(config.max_files / n_shards, std::size_t{1})}
+{}
+
+CachingStorage::Stats CachingStorage::stats() const
+{
+  return {m_hits.load(), m_misses.load()};
+}
+
+CachingStorage::Shard& CachingStorage::shard(PhysicalPath const& path)
+{
+  return m_shards[std::hash<std::string>{}(path.native()) % n_shards];
+}
+
+// To be called with the lock of the shard held. The expired entries are at
+// the front, so are those evicted when the shard is full: each insertion
+// removes only what it has to.
+void CachingStorage::put(Shard& shard, PhysicalPath const& path,
+                         FileProbe const& probe, Clock::time_point now)
+{
+  auto& entries = shard.entries;
+  if (auto it = shard.index.find(path.native()); it != shard.index.end()) {
+    auto const entry  = it->second;
+    entry->probe      = probe;
+    entry->expires_at = now + m_ttl;
+    entries.splice(entries.end(), entries, entry);
+    return;
+  }
+
+  while (!entries.empty()
+         && (entries.front().expires_at <= now
+             || entries.size() >= m_shard_capacity)) {
+    shard.index.erase(entries.front().path);
+    entries.pop_front();
+  }
+  entries.push_back(Entry{path.native(), probe, now + m_ttl});
+  shard.index.emplace(entries.back().path, std::prev(entries.end()));
+}
+
+void CachingStorage::forget(std::span<PhysicalPath const> paths)
+{
+  for (auto const& path : paths) {
+    auto& shard = this->shard(path);
+    std::lock_guard lock{shard.mutex};
+    if (auto it = shard.index.find(path.native()); it != shard.index.end()) {
+      shard.entries.erase(it->second);
+      shard.index.erase(it);
+    }
+    ++shard.generation;
+  }
+}
+
+Result<bool> CachingStorage::is_in_progress(PhysicalPath const& path)
+{
+  return m_storage.is_in_progress(path);
+}
+
+Result<FileSizeInfo> CachingStorage::file_size_info(PhysicalPath const& path)
+{
+  return m_storage.file_size_info(path);
+}
+
+Result<bool> CachingStorage::is_on_tape(PhysicalPath const& path)
+{
+  return m_storage.is_on_tape(path);
+}
+
+// The paths not found in the cache, or expired, are probed in a single batch
+FileProbes CachingStorage::probe(std::span<PhysicalPath const> paths)
+{
+  TRACE_FUNCTION();
+
+  FileProbes probes(paths.size());
+  PhysicalPaths missed_paths;
+  std::vector<std::size_t> missed;
+  std::vector<std::uint64_t> generations;
+
+  auto const now = Clock::now();
+  for (std::size_t i{0}; i != paths.size(); ++i) {
+    auto& shard = this->shard(paths[i]);
+    std::lock_guard lock{shard.mutex};
+    auto it = shard.index.find(paths[i].native());
+    if (it != shard.index.end() && it->second->expires_at > now) {
+      probes[i] = it->second->probe;
+    } else {
+      missed_paths.push_back(paths[i]);
+      missed.push_back(i);
+      generations.push_back(shard.generation);
+    }
+  }
+  m_hits += paths.size() - missed.size();
+  m_misses += missed.size();
+
+  if (missed.empty()) {
+    return probes;
+  }
+
+  auto missed_probes = m_storage.probe(missed_paths);
+  auto const later   = Clock::now();
+  for (std::size_t j{0}; j != missed.size(); ++j) {
+    auto const& probe = missed_probes[j];
+    if (is_cacheable(probe)) {
+      auto& shard = this->shard(missed_paths[j]);
+      std::lock_guard lock{shard.mutex};
+      if (shard.generation == generations[j]) {
+        put(shard, missed_paths[j], probe, later);
+      }
+    }
+    probes[missed[j]] = std::move(missed_probes[j]);
+  }
+
+  return probes;
+}
+
+// The probes are forgotten after the xattrs are set, so that a probe that
+// started before can't be cached
+std::vector<std::error_code>
+CachingStorage::request_recall(std::span<PhysicalPath const> paths)
+{
+  TRACE_FUNCTION();
+
+  auto errors = m_storage.request_recall(paths);
+  forget(paths);
+  return errors;
+}
+
+} // namespace storm
@@ -0,0 +1,91 @@
+// SPDX-FileCopyrightText: 2025 Istituto Nazionale di Fisica Nucleare
+//
+// SPDX-License-Identifier: EUPL-1.2
+
+#ifndef STORM_STORAGE_CACHING_HPP
+#define STORM_STORAGE_CACHING_HPP
+
+#include "configuration.hpp"
+#include "storage.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace storm {
+
+// A Storage that remembers the probes of the files for a short time, shared by
+// all the requests, so that the stages referring to the same files don't probe
+// them again. The files that don't exist are remembered too. The probe of a
+// file marked for recall through it is forgotten.
+class CachingStorage : public Storage
+{
+ public:
+  struct Stats
+  {
+    std::size_t hits;
+    std::size_t misses;
+  };
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Entry
+  {
+    std::string path;
+    FileProbe probe;
+    Clock::time_point expires_at;
+  };
+  using Entries = std::list<Entry>;
+
+  // The files are partitioned in shards, each with its own lock
+  struct Shard
+  {
+    std::mutex mutex;
+    // in order of expiration, which is the order of insertion since all the
+    // entries live for the same time; the first ones are evicted first
+    Entries entries;
+    // the keys refer to the paths of the entries
+    std::unordered_map<std::string_view, Entries::iterator> index;
+    // incremented by every invalidation; a probe is cached only if no
+    // invalidation has happened since the lookup that missed it
+    std::uint64_t generation{0};
+  };
+
+  static constexpr std::size_t n_shards{16};
+
+  Storage& m_storage;
+  Clock::duration m_ttl;
+  std::size_t m_shard_capacity;
+  std::array<Shard, n_shards> m_shards;
+  std::atomic<std::size_t> m_hits{0};
+  std::atomic<std::size_t> m_misses{0};
+
+  Shard& shard(PhysicalPath const& path);
+  void put(Shard& shard, PhysicalPath const& path, FileProbe const& probe,
+           Clock::time_point now);
+  void forget(std::span<PhysicalPath const> paths);
+
+ public:
+  CachingStorage(Storage& storage, FileStatusCacheConfiguration const& config);
+
+  Stats stats() const;
+
+  // the calls for a single path are not cached
+  Result<bool> is_in_progress(PhysicalPath const& path) override;
+  Result<FileSizeInfo> file_size_info(PhysicalPath const& path) override;
+  Result<bool> is_on_tape(PhysicalPath const& path) override;
+  FileProbes probe(std::span<PhysicalPath const> paths) override;
+  std::vector<std::error_code>
+  request_recall(std::span<PhysicalPath const> paths) override;
+};
+
+} // namespace storm
+
+#endif
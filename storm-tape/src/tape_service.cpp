@@ -9,11 +9,10 @@
 #include "database.hpp"
 #include "delete_response.hpp"
 #include "errors.hpp"
-#include "extended_attributes.hpp"
-#include "extended_file_status.hpp"
 #include "in_progress_response.hpp"
 #include "io.hpp"
 #include "readytakeover_response.hpp"
+#include "recall_watcher.hpp"
 #include "release_response.hpp"
 #include "requests_with_paths.hpp"
 #include "stage_response.hpp"
@@ -35,6 +34,28 @@
 
 namespace storm {
 
+TapeService::TapeService(Configuration const& config, Database& db,
+                         Storage& storage, RecallWatcher* watcher)
+    : m_config{config}
+    , m_db(db)
+    , m_storage(storage)
+    , m_resolve{config.storage_areas}
+    , m_watcher{watcher}
+{
+  if (m_config.parallelism.has_value()) {
+    m_parallel.emplace(*m_config.parallelism);
+  }
+}
+
+std::optional<Parallelism>
+TapeService::parallelism(ParallelExecution::Operation op)
+{
+  if (!m_parallel.has_value()) {
+    return std::nullopt;
+  }
+  return (*m_parallel)(op);
+}
+
 StageResponse TapeService::stage(StageRequest stage_request)
 {
   TRACE_FUNCTION();
@@ -51,7 +72,8 @@ StageResponse TapeService::stage(StageRequest stage_request)
                           }),
               files.end());
 
-  stage_path_resolver(files, m_config.storage_areas);
+  stage_path_resolver(files, m_resolve, m_storage,
+                      parallelism(ParallelExecution::Operation::stage));
   auto const id       = m_uuid_gen();
   auto const inserted = m_db.insert(id, stage_request);
   if (!inserted) {
@@ -61,21 +83,23 @@ StageResponse TapeService::stage(StageRequest stage_request)
   return inserted ? StageResponse{id, std::move(files)} : StageResponse{};
 }
 
-StatusResponse TapeService::status(StageId const& id)
+// Probe the storage for the files of the stage that are not in a final state
+// and store the changes. The files are returned sorted by state.
+std::optional<StageRequest> TapeService::reconcile(StageId const& id)
 {
   TRACE_FUNCTION();
 
   auto maybe_stage = m_db.find(id);
 
   if (!maybe_stage.has_value()) {
-    throw StageNotFound(id);
+    return std::nullopt;
   }
   auto& stage = *maybe_stage;
 
   const auto now = std::time(nullptr);
 
   // determine the actual state of files and update the db
-  std::vector<std::pair<PhysicalPath, File::State>> files_to_update;
+  FileUpdates files_to_update;
   bool stage_updated = false;
 
   if (stage.files.empty()) {
@@ -88,7 +112,8 @@ StatusResponse TapeService::status(StageId const& id)
       stage_updated      = true;
     }
   } else {
-    status_loop(stage.files, m_storage, now, files_to_update);
+    status_loop(stage.files, m_storage, now, files_to_update,
+                parallelism(ParallelExecution::Operation::status));
 
     std::sort(stage.files.begin(), stage.files.end(),
               [](auto const& f1, auto const& f2) {
@@ -98,16 +123,83 @@ StatusResponse TapeService::status(StageId const& id)
     stage_updated = stage.update_timestamps();
   }
 
-  StageUpdate stage_update{
-      stage_updated
-          ? std::optional(StageEntity{id, stage.created_at, stage.started_at,
-                                      stage.completed_at})
-          : std::nullopt,
-      files_to_update, now};
-  m_db.update(stage_update);
+  if (m_watcher != nullptr && !files_to_update.empty()) {
+    PhysicalPaths started;
+    PhysicalPaths finished;
+    for (auto const& [path, state] : files_to_update) {
+      (state == File::State::started ? started : finished).push_back(path);
+    }
+    m_watcher->watch(started);
+    // the recall is over also for the other stages waiting for the same files
+    m_watcher->forget(finished);
+  }
+
+  if (stage_updated || !files_to_update.empty()) {
+    StageUpdate stage_update{
+        stage_updated
+            ? std::optional(StageEntity{id, stage.created_at,
+                                        stage.started_at, stage.completed_at})
+            : std::nullopt,
+        files_to_update, now};
+    m_db.update(stage_update);
+  }
+  return maybe_stage;
+}
+
+StatusResponse TapeService::status(StageId const& id)
+{
+  TRACE_FUNCTION();
+
+  // with a background reconciler the status only reads the stored state
+  auto maybe_stage =
+      m_config.reconciler.has_value() ? m_db.find(id) : reconcile(id);
+
+  if (!maybe_stage.has_value()) {
+    throw StageNotFound(id);
+  }
+  auto& stage = *maybe_stage;
+
+  if (m_config.reconciler.has_value()) {
+    std::sort(stage.files.begin(), stage.files.end(),
+              [](auto const& f1, auto const& f2) {
+                return to_underlying(f1.state) < to_underlying(f2.state);
+              });
+  }
+
   return StatusResponse{id, std::move(stage)};
 }
 
+namespace {
+
+// The physical paths of the files of the stage waiting for a recall
+PhysicalPaths started_paths(StageRequest const& stage)
+{
+  PhysicalPaths result;
+  for (auto const& file : stage.files) {
+    if (file.state == File::State::started) {
+      result.push_back(file.physical_path);
+    }
+  }
+  return result;
+}
+
+// Same as above, only for the given logical paths, which are sorted
+PhysicalPaths started_paths(StageRequest const& stage,
+                            LogicalPaths const& paths)
+{
+  PhysicalPaths result;
+  for (auto const& file : stage.files) {
+    if (file.state == File::State::started
+        && std::binary_search(paths.begin(), paths.end(),
+                              file.logical_path)) {
+      result.push_back(file.physical_path);
+    }
+  }
+  return result;
+}
+
+} // namespace
+
 CancelResponse TapeService::cancel(StageId const& id, CancelRequest cancel)
 {
   TRACE_FUNCTION();
@@ -137,7 +229,10 @@ CancelResponse TapeService::cancel(StageId const& id, CancelRequest cancel)
 
   const auto now = std::time(nullptr);
   m_db.update(id, cancel.paths, File::State::cancelled, now);
-  // do not bother cancelling the recalls in progress
+  // do not bother cancelling the recalls in progress, but stop waiting for them
+  if (m_watcher != nullptr) {
+    m_watcher->unwatch(started_paths(*stage, cancel.paths));
+  }
 
   return CancelResponse{id};
 }
@@ -146,11 +241,22 @@ DeleteResponse TapeService::erase(StageId const& id)
 {
   TRACE_FUNCTION();
 
+  // the files the stage was waiting for, to stop watching them
+  PhysicalPaths started;
+  if (m_watcher != nullptr) {
+    if (auto const stage = m_db.find(id); stage.has_value()) {
+      started = started_paths(*stage);
+    }
+  }
+
   // do not bother cancelling the recalls in progress
   auto const erased = m_db.erase(id);
   if (!erased) {
     throw StageNotFound(id);
   }
+  if (m_watcher != nullptr) {
+    m_watcher->unwatch(started);
+  }
   return {};
 }
 
@@ -190,10 +296,9 @@ ArchiveInfoResponse TapeService::archive_info(ArchiveInfoRequest info)
 {
   TRACE_FUNCTION();
 
-  auto& paths = info.paths;
-
-  
-  return archive_info_loop(paths, m_config.storage_areas, m_storage);
+  return archive_info_loop(
+      info.paths, m_resolve, m_storage,
+      parallelism(ParallelExecution::Operation::archive_info));
 }
 
 ReadyTakeOverResponse TapeService::ready_take_over()
@@ -212,12 +317,13 @@ TakeOverResponse TapeService::take_over(TakeOverRequest req)
 
   auto physical_paths = m_db.get_files(File::State::submitted, req.n_files);
 
-  auto path_locs =
-      extend_paths_with_localities(std::move(physical_paths), m_storage);
+  auto path_locs = extend_paths_with_localities(
+      std::move(physical_paths), m_storage,
+      parallelism(ParallelExecution::Operation::take_over));
 
   auto [only_on_tape, not_only_on_tape] = select_only_on_tape(path_locs);
-  auto [in_progress, need_recall]       = select_in_progress(only_on_tape);
-  auto [on_disk, the_rest]              = select_on_disk(not_only_on_tape);
+  auto [in_progress, need_recall] = select_in_progress(only_on_tape, m_storage);
+  auto [on_disk, the_rest]        = select_on_disk(not_only_on_tape);
 
   auto const now = std::time(nullptr);
 
@@ -231,6 +337,9 @@ TakeOverResponse TapeService::take_over(TakeOverRequest req)
       boost::make_transform_iterator(in_progress.begin(), proj),
       boost::make_transform_iterator(in_progress.end(), proj));
   m_db.update(physical_paths, File::State::started, now);
+  if (m_watcher != nullptr) {
+    m_watcher->watch(physical_paths);
+  }
 
   // update the state of files already on disk to Completed
   // started_at may remain at its default value
@@ -254,21 +363,18 @@ TakeOverResponse TapeService::take_over(TakeOverRequest req)
     // a big deal, because the file stays in submitted state and can be passed
     // later again to GEMSS. passing a file to GEMSS is mostly an idempotent
     // operation
-    // clang-format off
-    std::for_each(
-        physical_paths.begin(), physical_paths.end(), [&](auto& physical_path) {
-          XAttrName const tsm_rect{"user.TSMRecT"};
-          std::error_code ec;
-          create_xattr(physical_path, tsm_rect, ec);
-          if (ec != std::error_code{}) {
-            CROW_LOG_WARNING << fmt::format("Cannot create xattr {} for file {}",
-                                            tsm_rect.value(),
-                                            physical_path);
-          }
-        });
-    // clang-format on
+    auto const errors = m_storage.request_recall(physical_paths);
+    for (std::size_t i{0}; i != errors.size(); ++i) {
+      if (errors[i] != std::error_code{}) {
+        CROW_LOG_WARNING << fmt::format(
+            "Cannot create xattr user.TSMRecT for file {}", physical_paths[i]);
+      }
+    }
   }
   m_db.update(physical_paths, File::State::started, now);
+  if (m_watcher != nullptr) {
+    m_watcher->watch(physical_paths);
+  }
 
   return TakeOverResponse{std::move(physical_paths)};
 }
@@ -356,9 +462,17 @@ InProgressResponse TapeService::in_progress(InProgressRequest req)
   auto physical_paths = m_db.get_files(File::State::started, req.n_files);
 
   if (req.precise > 0) {
-    std::erase_if(physical_paths, [&](PhysicalPath const& path) {
-      return !ExtendedFileStatus{m_storage, path}.is_in_progress();
-    });
+    auto const probes = m_storage.probe(physical_paths);
+    std::size_t n{0};
+    for (std::size_t i{0}; i != probes.size(); ++i) {
+      if (probes[i].in_progress) {
+        if (n != i) {
+          physical_paths[n] = std::move(physical_paths[i]);
+        }
+        ++n;
+      }
+    }
+    physical_paths.resize(n);
   }
 
   return InProgressResponse{std::move(physical_paths)};
@@ -5,9 +5,12 @@
 #ifndef STORM_TAPE_SERVICE_HPP
 #define STORM_TAPE_SERVICE_HPP
 
+#include "parallelism.hpp"
+#include "storage_area_resolver.hpp"
 #include "types.hpp"
 #include "uuid_generator.hpp"
 #include <filesystem>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -33,6 +36,7 @@ class TakeOverResponse;
 class InProgressRequest;
 class InProgressResponse;
 class File;
+class RecallWatcher;
 
 class TapeService
 {
@@ -40,11 +44,18 @@ class TapeService
   Configuration const& m_config;
   Database& m_db;
   Storage& m_storage;
+  // the access points of the storage areas, compiled once
+  StorageAreaResolver m_resolve;
+  // if set, it is told about the files that start and finish being recalled
+  RecallWatcher* m_watcher;
+  // where the loops over the files run in parallel, if configured
+  std::optional<ParallelExecution> m_parallel;
+
+  std::optional<Parallelism> parallelism(ParallelExecution::Operation op);
 
  public:
-  TapeService(Configuration const& config, Database& db, Storage& storage)
-      : m_config{config}, m_db(db), m_storage(storage)
-  {}
+  TapeService(Configuration const& config, Database& db, Storage& storage,
+              RecallWatcher* watcher = nullptr);
 
   StageResponse stage(StageRequest stage_request);
   StatusResponse status(StageId const& id);
@@ -53,6 +64,9 @@ class TapeService
   ReleaseResponse release(StageId const& id, ReleaseRequest release) const;
   ArchiveInfoResponse archive_info(ArchiveInfoRequest info);
 
+  // bring the stored state of a stage in line with the storage
+  std::optional<StageRequest> reconcile(StageId const& id);
+
   // for GEMSS
   ReadyTakeOverResponse ready_take_over();
   TakeOverResponse take_over(TakeOverRequest);
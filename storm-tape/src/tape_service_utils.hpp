@@ -1,35 +1,28 @@
 #ifndef STORM_TAPE_SERVICE_UTILS_HPP
 #define STORM_TAPE_SERVICE_UTILS_HPP
 
-#include "extended_attributes.hpp"
-#include "extended_file_status.hpp"
+#include "archiveinfo_response.hpp"
+#include "file.hpp"
+#include "parallelism.hpp"
 #include "storage.hpp"
+#include "storage_area_resolver.hpp"
 #include "trace_span.hpp"
 #include "types.hpp"
-#include "storage_area_resolver.hpp" 
 #include <crow/logging.h>
 #include <fmt/std.h>
-#include <execution>
-#include <span>
+#include <tbb/enumerable_thread_specific.h>
+#include <ctime>
 #include <filesystem>
-#include <ctime> 
+#include <optional>
+#include <span>
 #include <vector>
-#include "file.hpp"
-#include "archiveinfo_response.hpp"
 
 namespace storm {
 
 namespace fs = std::filesystem;
 
 using PathLocality = std::pair<PhysicalPath, Locality>;
-
-inline bool recall_in_progress(PhysicalPath const& path)
-{
-  XAttrName const tsm_rect{"user.TSMRecT"};
-  std::error_code ec;
-  auto const in_progress = has_xattr(path, tsm_rect, ec);
-  return ec == std::error_code{} && in_progress;
-}
+using FileUpdates  = std::vector<std::pair<PhysicalPath, File::State>>;
 
 inline bool override_locality(Locality& locality, PhysicalPath const& path)
 {
@@ -45,249 +38,188 @@ inline bool override_locality(Locality& locality, PhysicalPath const& path)
   return false;
 }
 
-inline auto extend_paths_with_localities(PhysicalPaths&& paths,
-                                         Storage& storage,
-                                         bool parallel = false)
+inline auto
+extend_paths_with_localities(PhysicalPaths&& paths, Storage& storage,
+                             std::optional<Parallelism> parallelism = {})
 {
   TRACE_FUNCTION();
-  std::vector<PathLocality> path_localities;
+  std::vector<PathLocality> path_localities(paths.size());
+
+  for_each_range(paths.size(), parallelism,
+                 [&](std::size_t first, std::size_t last) {
+                   auto const probes = storage.probe(
+                       std::span{paths}.subspan(first, last - first));
+                   for (auto i = first; i != last; ++i) {
+                     path_localities[i] = {std::move(paths[i]),
+                                           probes[i - first].locality()};
+                   }
+                 });
 
-  if (parallel) {
-    path_localities.resize(paths.size());
-
-    std::transform(std::execution::par, paths.begin(), paths.end(),
-                   path_localities.begin(), [&](PhysicalPath& path) {
-                     auto const locality =
-                         ExtendedFileStatus{storage, path}.locality();
-                     return PathLocality{std::move(path), locality};
-                   });
-  } else {
-    path_localities.reserve(paths.size());
-
-    for (auto&& path : paths) {
-      auto const locality = ExtendedFileStatus{storage, path}.locality();
-      path_localities.emplace_back(std::move(path), locality);
-    }
-  }
   return path_localities;
 }
 
-inline auto stage_path_resolver(auto &files, const auto &storage_areas, bool parallel = false) {
-  if(parallel) {
-    std::for_each(std::execution::par, files.begin(), files.end(), 
-      [&storage_areas](auto &file) {
-        StorageAreaResolver resolver{storage_areas};
-        file.physical_path = resolver(file.logical_path);
-        std::error_code ec;
-        auto status = fs::status(file.physical_path, ec);
-        if (ec || !fs::is_regular_file(status)) {
-          //using FileType = std::remove_reference_t<decltype(file)>;
-          file.state       = File::State::failed;
-          file.started_at  = std::time(nullptr);
-          file.finished_at = file.started_at;
-        }
-      }
-    );
-  }
-  else {
-    StorageAreaResolver resolve{storage_areas};
-    for (auto& file : files) {
-      file.physical_path = resolve(file.logical_path);
-      std::error_code ec;
-      auto status = fs::status(file.physical_path, ec);
-      if (ec || !fs::is_regular_file(status)) {
-        //using FileType = std::remove_reference_t<decltype(file)>;
-        file.state       = File::State::failed;
-        file.started_at  = std::time(nullptr);
-        file.finished_at = file.started_at;
-      }
-    }
-  }
-}
-
-
-inline auto status_loop(auto &files, auto &storage, auto now, auto &files_to_update, bool parallel = false) {
-
-  if (parallel) {
-    
-    std::for_each(std::execution::par, files.begin(), files.end(),
-      [&storage, &now, &files_to_update](auto &file) {
-        ExtendedFileStatus file_status{storage, file.physical_path};
-
-        switch (file.state) {
-        
-        case File::State::started: {
-          std::cout<<"STARTED \n";
-          if (file_status.is_in_progress()) {
-            break;
-          }
-          file.state       = file_status.is_stub() ? File::State::failed
-                                                   : File::State::completed;
-          file.finished_at = now;
-          files_to_update.emplace_back(file.physical_path, file.state);
-          break;
+// Resolve the physical paths of the files to stage. The files that are not
+// regular files on the storage are marked as failed.
+inline void stage_path_resolver(Files& files,
+                                StorageAreaResolver const& resolve,
+                                Storage& storage,
+                                std::optional<Parallelism> parallelism = {})
+{
+  TRACE_FUNCTION();
+  for_each_range(
+      files.size(), parallelism, [&](std::size_t first, std::size_t last) {
+        PhysicalPaths paths;
+        paths.reserve(last - first);
+        for (auto i = first; i != last; ++i) {
+          paths.push_back(resolve(files[i].logical_path));
         }
-
-        case File::State::completed:
-        case File::State::cancelled:
-        case File::State::failed:
-          // do nothing
-          break;
-
-        case File::State::submitted: {
-          std::cout<<"SUBMITTED \n";
-          if (file_status && file_status.is_in_progress()) {
-            file.state      = File::State::started;
-            file.started_at = now;
-            files_to_update.emplace_back(file.physical_path,
-                                         File::State::started);
-          } else if (file_status && !file_status.is_stub()) {
-            file.state       = File::State::completed;
-            file.started_at  = now;
-            file.finished_at = now;
-            files_to_update.emplace_back(file.physical_path, file.state);
-          } else if (!file_status) {
+        auto const probes = storage.probe(paths);
+        for (auto i = first; i != last; ++i) {
+          auto& file         = files[i];
+          auto const& probe  = probes[i - first];
+          file.physical_path = std::move(paths[i - first]);
+          if (probe.type != fs::file_type::regular) {
             file.state       = File::State::failed;
-            file.started_at  = now;
-            file.finished_at = now;
-            files_to_update.emplace_back(file.physical_path, file.state);
+            file.started_at  = std::time(nullptr);
+            file.finished_at = file.started_at;
           }
-          break;
-        }
         }
       });
+}
 
-  } else {
-    for (auto& file : files) {
-      ExtendedFileStatus file_status{storage, file.physical_path};
-
-      switch (file.state) {
-        
-      case File::State::started: {
-        std::cout<<"STARTED \n";
-        if (file_status.is_in_progress()) {
-          break;
-        }
-        file.state       = file_status.is_stub() ? File::State::failed
-                                                 : File::State::completed;
-        file.finished_at = now;
-        files_to_update.emplace_back(file.physical_path, file.state);
-        break;
-      }
-
-      case File::State::completed:
-      case File::State::cancelled:
-      case File::State::failed:
-        // do nothing
-        break;
+// The status of a file that is not in a final state, as found on the storage.
+// Return true if the file has changed.
+inline bool update_status(File& file, FileProbe const& probe, TimePoint now)
+{
+  switch (file.state) {
+  case File::State::started: {
+    if (probe.in_progress) {
+      return false;
+    }
+    file.state =
+        probe.is_stub() ? File::State::failed : File::State::completed;
+    file.finished_at = now;
+    return true;
+  }
 
-      case File::State::submitted: {
-        std::cout<<"SUBMITTED \n";
-        if (file_status && file_status.is_in_progress()) {
-          file.state      = File::State::started;
-          file.started_at = now;
-          files_to_update.emplace_back(file.physical_path,
-                                       File::State::started);
-        } else if (file_status && !file_status.is_stub()) {
-          file.state       = File::State::completed;
-          file.started_at  = now;
-          file.finished_at = now;
-          files_to_update.emplace_back(file.physical_path, file.state);
-        } else if (!file_status) {
-          file.state       = File::State::failed;
-          file.started_at  = now;
-          file.finished_at = now;
-          files_to_update.emplace_back(file.physical_path, file.state);
-        }
-        break;
-      }
-      }
+  case File::State::completed:
+  case File::State::cancelled:
+  case File::State::failed:
+    // do nothing
+    return false;
+
+  case File::State::submitted: {
+    if (probe.in_progress) {
+      file.state      = File::State::started;
+      file.started_at = now;
+      return true;
+    } else if (probe && !probe.is_stub()) {
+      file.state       = File::State::completed;
+      file.started_at  = now;
+      file.finished_at = now;
+      return true;
+    } else if (!probe) {
+      file.state       = File::State::failed;
+      file.started_at  = now;
+      file.finished_at = now;
+      return true;
     }
+    return false;
+  }
   }
-  return files_to_update;
+  return false;
 }
 
-inline auto archive_info_loop(auto &paths, const auto &storage_areas, auto &storage, bool parallel = false) {
-  PathInfos infos;
-  if(parallel) {
-    
-    // 1. Pre-allocazione del vettore di output per l'accesso concorrente
-    infos.resize(paths.size());
-
-    // 2. Trasformazione parallela
-    std::transform(std::execution::par, paths.begin(), paths.end(), infos.begin(),
-        [&](auto& logical_path) {
-          using namespace std::string_literals;
-          
-          // Resolver locale al thread
-          StorageAreaResolver resolve{storage_areas};
-
-          auto const physical_path = resolve(logical_path);
-          std::error_code ec;
-          auto status = fs::status(physical_path, ec);
+// Update the status of the files and append the changes to files_to_update.
+// Only the files not in a final state are probed. In parallel each worker
+// collects its changes in its own buffer; the buffers are then appended in
+// turn.
+inline void status_loop(Files& files, Storage& storage, TimePoint now,
+                        FileUpdates& files_to_update,
+                        std::optional<Parallelism> parallelism = {})
+{
+  TRACE_FUNCTION();
 
-          if (!fs::exists(status)) {
-            // std::move su logical_path (input) va bene perché è una trasformazione 1:1
-            return PathInfo{std::move(logical_path), "No such file or directory"s};
-          }
-          if (ec != std::error_code{}) {
-            return PathInfo{std::move(logical_path), Locality::unavailable};
-          }
-          if (fs::is_directory(status)) {
-            return PathInfo{std::move(logical_path), "Is a directory"s};
+  tbb::enumerable_thread_specific<FileUpdates> updates;
+  for_each_range(
+      files.size(), parallelism, [&](std::size_t first, std::size_t last) {
+        std::vector<std::size_t> indexes;
+        PhysicalPaths paths;
+        for (auto i = first; i != last; ++i) {
+          if (!is_final(files[i].state)) {
+            indexes.push_back(i);
+            paths.push_back(files[i].physical_path);
           }
-          if (!fs::is_regular_file(status)) {
-            return PathInfo{std::move(logical_path), "Not a regular file"s};
+        }
+        if (paths.empty()) {
+          return;
+        }
+        auto const probes = storage.probe(paths);
+        auto& local       = updates.local();
+        for (std::size_t j{0}; j != indexes.size(); ++j) {
+          auto& file = files[indexes[j]];
+          if (update_status(file, probes[j], now)) {
+            local.emplace_back(file.physical_path, file.state);
           }
-          
-          auto locality = ExtendedFileStatus{storage, physical_path}.locality();
-          override_locality(locality, physical_path);
-          
-          return PathInfo{std::move(logical_path), locality};
         }
-    );
-
-  } else {
-    
-    infos.reserve(paths.size());
-
-    StorageAreaResolver resolve{storage_areas};
-
-    std::transform( //
-        paths.begin(), paths.end(), std::back_inserter(infos),
-        [&](LogicalPath& logical_path) {
-          using namespace std::string_literals;
-
-          auto const physical_path = resolve(logical_path);
-          std::error_code ec;
-          auto status = fs::status(physical_path, ec);
+      });
+  updates.combine_each([&](FileUpdates& local) {
+    std::move(local.begin(), local.end(), std::back_inserter(files_to_update));
+  });
+}
 
-          // if the file doesn't exist, fs::status sets ec, so check first for
-          // existence
-          if (!fs::exists(status)) {
-            return PathInfo{std::move(logical_path),
-                            "No such file or directory"s};
-          }
-          if (ec != std::error_code{}) {
-            return PathInfo{std::move(logical_path), Locality::unavailable};
-          }
-          if (fs::is_directory(status)) {
-            return PathInfo{std::move(logical_path), "Is a directory"s};
-          }
-          if (!fs::is_regular_file(status)) {
-            return PathInfo{std::move(logical_path), "Not a regular file"s};
-          }
-          auto locality = ExtendedFileStatus{storage, physical_path}.locality();
-          override_locality(locality, physical_path);
-          return PathInfo{std::move(logical_path), locality};
-        });
-      
-      
+// The archive info of a file, given its logical path and the probe of its
+// physical path
+inline PathInfo make_path_info(LogicalPath&& logical_path,
+                               PhysicalPath const& physical_path,
+                               FileProbe const& probe)
+{
+  using namespace std::string_literals;
 
+  // if the file doesn't exist, the probe has an error, so check first for
+  // existence
+  if (probe.type == fs::file_type::not_found) {
+    return PathInfo{std::move(logical_path), "No such file or directory"s};
+  }
+  if (!probe) {
+    return PathInfo{std::move(logical_path), Locality::unavailable};
   }
-  return ArchiveInfoResponse{infos};
+  if (probe.type == fs::file_type::directory) {
+    return PathInfo{std::move(logical_path), "Is a directory"s};
+  }
+  if (probe.type != fs::file_type::regular) {
+    return PathInfo{std::move(logical_path), "Not a regular file"s};
+  }
+  auto locality = probe.locality();
+  override_locality(locality, physical_path);
+  return PathInfo{std::move(logical_path), locality};
 }
 
+inline auto archive_info_loop(LogicalPaths& paths,
+                              StorageAreaResolver const& resolve,
+                              Storage& storage,
+                              std::optional<Parallelism> parallelism = {})
+{
+  TRACE_FUNCTION();
+  PathInfos infos(paths.size());
+
+  for_each_range(
+      paths.size(), parallelism, [&](std::size_t first, std::size_t last) {
+        PhysicalPaths physical_paths;
+        physical_paths.reserve(last - first);
+        for (auto i = first; i != last; ++i) {
+          physical_paths.push_back(resolve(paths[i]));
+        }
+        auto const probes = storage.probe(physical_paths);
+        for (auto i = first; i != last; ++i) {
+          infos[i] = make_path_info(std::move(paths[i]),
+                                    physical_paths[i - first],
+                                    probes[i - first]);
+        }
+      });
+
+  return ArchiveInfoResponse{std::move(infos)};
+}
 
 inline auto select_only_on_tape(
     std::span<PathLocality> path_locs) //-V813 span is passed by value
@@ -303,12 +235,27 @@ inline auto select_only_on_tape(
                     std::span{it, path_locs.end()}};
 }
 
-inline auto select_in_progress(std::span<PathLocality> path_locs)
+inline auto select_in_progress(
+    std::span<PathLocality> path_locs, //-V813 span is passed by value
+    Storage& storage)
 {
   TRACE_FUNCTION();
-  auto const it = std::partition(
-      path_locs.begin(), path_locs.end(),
-      [](auto const& path_loc) { return recall_in_progress(path_loc.first); });
+  PhysicalPaths paths;
+  paths.reserve(path_locs.size());
+  for (auto const& path_loc : path_locs) {
+    paths.push_back(path_loc.first);
+  }
+  auto const probes = storage.probe(paths);
+
+  // the probes follow the original order, which is kept past the elements
+  // already visited
+  auto it = path_locs.begin();
+  for (std::size_t i{0}; i != path_locs.size(); ++i) {
+    if (probes[i].in_progress) {
+      std::swap(*it, path_locs[i]);
+      ++it;
+    }
+  }
   return std::tuple{std::span{path_locs.begin(), it},
                     std::span{it, path_locs.end()}};
 }
@@ -4,6 +4,7 @@
 
 #include "telemetry.hpp"
 #include "configuration.hpp"
+#include "trace_span.hpp"
 
 namespace storm {
 
@@ -14,8 +15,15 @@ Telemetry::Telemetry(Configuration const& config)
     if (!tel_config.tracing_endpoint.empty()) {
       m_tracer_provider.emplace(config.hostname, tel_config.service_name,
                                 tel_config.tracing_endpoint);
+      TraceSpan::set_level(tel_config.tracing_level);
     }
   }
 }
 
+Telemetry::~Telemetry()
+{
+  // no new spans once the provider is gone
+  TraceSpan::set_level(TracingLevel::off);
+}
+
 } // namespace storm
@@ -18,7 +18,7 @@ class Telemetry
 
  public:
   explicit Telemetry(Configuration const& config);
-  ~Telemetry()                           = default;
+  ~Telemetry();
   Telemetry(const Telemetry&)            = delete;
   Telemetry(Telemetry&&)                 = delete;
   Telemetry& operator=(const Telemetry&) = delete;
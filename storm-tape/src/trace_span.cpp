@@ -35,7 +35,7 @@ auto make_options(crow::request const& req)
 }
 } // namespace
 
-TraceSpan::TraceSpan(std::string_view name)
+void TraceSpan::start(std::string_view name)
 {
   auto const tracer = TracerProvider::get_tracer();
   BOOST_ASSERT(tracer);
@@ -45,7 +45,7 @@ TraceSpan::TraceSpan(std::string_view name)
       tracer->WithActiveSpan(m_span));
 }
 
-TraceSpan::TraceSpan(std::string_view name, crow::request const& req)
+void TraceSpan::start(std::string_view name, crow::request const& req)
 {
   auto const tracer = TracerProvider::get_tracer();
   BOOST_ASSERT(tracer);
@@ -58,20 +58,16 @@ TraceSpan::TraceSpan(std::string_view name, crow::request const& req)
 
 TraceSpan::TraceSpan(std::string_view name, crow::request const& req,
                      std::string_view operation)
+    : TraceSpan(name, req)
 {
-  auto const tracer = TracerProvider::get_tracer();
-  BOOST_ASSERT(tracer);
-  m_span = tracer->StartSpan({name.data(), name.size()}, to_semconv(req),
-                             make_options(req));
-  BOOST_ASSERT(m_span);
-  m_span->SetAttribute(
-      OtelAttribute::operation_name,
-      opentelemetry::nostd::string_view{operation.data(), operation.size()});
-  m_scope = std::make_unique<opentelemetry::trace::Scope>(
-      tracer->WithActiveSpan(m_span));
+  if (m_span) {
+    m_span->SetAttribute(
+        OtelAttribute::operation_name,
+        opentelemetry::nostd::string_view{operation.data(), operation.size()});
+  }
 }
 
-TraceSpan::~TraceSpan()
+void TraceSpan::end() noexcept
 {
   try {
     m_span->End();
@@ -81,7 +77,9 @@ TraceSpan::~TraceSpan()
 
 void TraceSpan::set_batch_size(std::size_t size)
 {
-  m_span->SetAttribute(OtelAttribute::batch_size, size);
+  if (m_span) {
+    m_span->SetAttribute(OtelAttribute::batch_size, size);
+  }
 }
 
 } // namespace storm
@@ -5,12 +5,15 @@
 #ifndef STORM_TRACE_SPAN_HPP
 #define STORM_TRACE_SPAN_HPP
 
+#include "configuration.hpp"
+
 #include <crow/http_request.h>
 #include <opentelemetry/nostd/shared_ptr.h>
 #include <opentelemetry/nostd/unique_ptr.h>
 #include <opentelemetry/trace/scope.h>
 #include <opentelemetry/trace/span.h>
 
+#include <atomic>
 #include <string_view>
 
 #define COMBINE_HELPER(X, Y) X##Y
@@ -20,17 +23,52 @@
 
 namespace storm {
 
+// A span is started only if the current tracing level covers it: the spans of
+// the requests need at least TracingLevel::request, the others
+// TracingLevel::full. Otherwise the span costs a single check of the level.
 class TraceSpan
 {
+  inline static std::atomic<TracingLevel> s_level{TracingLevel::off};
+
   opentelemetry::nostd::shared_ptr<opentelemetry::trace::Span> m_span;
   opentelemetry::nostd::unique_ptr<opentelemetry::trace::Scope> m_scope;
 
+  void start(std::string_view name);
+  void start(std::string_view name, crow::request const& req);
+  void end() noexcept;
+
  public:
-  explicit TraceSpan(std::string_view name);
-  TraceSpan(std::string_view name, crow::request const& req);
+  static void set_level(TracingLevel level)
+  {
+    s_level.store(level, std::memory_order_relaxed);
+  }
+  static TracingLevel level()
+  {
+    return s_level.load(std::memory_order_relaxed);
+  }
+
+  explicit TraceSpan(std::string_view name)
+  {
+    if (level() == TracingLevel::full) {
+      start(name);
+    }
+  }
+  TraceSpan(std::string_view name, crow::request const& req)
+  {
+    if (level() != TracingLevel::off) {
+      start(name, req);
+    }
+  }
   TraceSpan(std::string_view name, crow::request const& req,
             std::string_view operation);
-  ~TraceSpan();
+  ~TraceSpan()
+  {
+    if (m_span) {
+      end();
+    }
+  }
+  TraceSpan(TraceSpan const&)            = delete;
+  TraceSpan& operator=(TraceSpan const&) = delete;
 
   void set_batch_size(std::size_t size);
 };
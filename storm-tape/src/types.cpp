@@ -3,9 +3,69 @@
 // SPDX-License-Identifier: EUPL-1.2
 
 #include "types.hpp"
+#include <algorithm>
 
 namespace storm {
 
+std::string lexically_normal(std::string_view path)
+{
+  std::string result;
+  if (path.empty()) {
+    return result;
+  }
+  result.reserve(path.size() + 1);
+
+  bool const absolute = path.front() == '/';
+  if (absolute) {
+    result += '/';
+  }
+  // every component is appended followed by a separator; a relative path can
+  // start with a sequence of "..", which are never removed
+  auto const base = result.size();
+  std::size_t n_parents{0};
+  bool trailing_separator{false};
+
+  for (std::size_t pos{0}; pos != path.size();) {
+    if (path[pos] == '/') {
+      ++pos;
+      continue;
+    }
+    auto const end       = std::min(path.find('/', pos), path.size());
+    auto const component = path.substr(pos, end - pos);
+    pos                  = end;
+    trailing_separator   = component == "." || component == "..";
+
+    if (component == ".") {
+      continue;
+    }
+    if (component == "..") {
+      if (result.size() > base + 3 * n_parents) {
+        // remove the last component
+        result.resize(result.rfind('/', result.size() - 2) + 1);
+      } else if (!absolute) {
+        result += "../";
+        ++n_parents;
+      }
+      // the parent of the root is the root
+      continue;
+    }
+    result += component;
+    result += '/';
+  }
+
+  if (result.size() == base) {
+    return absolute ? "/" : ".";
+  }
+  if (path.back() == '/') {
+    trailing_separator = true;
+  }
+  // a path never ends with "../"
+  if (!trailing_separator || result.size() == base + 3 * n_parents) {
+    result.pop_back();
+  }
+  return result;
+}
+
 std::string to_string(Locality locality)
 {
   using namespace std::string_literals;
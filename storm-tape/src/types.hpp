@@ -8,6 +8,7 @@
 #include <boost/system.hpp>
 #include <filesystem>
 #include <string>
+#include <string_view>
 #include <type_traits>
 #include <vector>
 
@@ -30,6 +31,11 @@ struct PhysicalPath : fs::path
   using fs::path::path;
 };
 
+// The lexically normal form of a path, as given by fs::path::lexically_normal,
+// computed in a single pass over the string. A path made only of separators is
+// normalized to "/".
+std::string lexically_normal(std::string_view path);
+
 using LogicalPaths  = std::vector<LogicalPath>;
 using PhysicalPaths = std::vector<PhysicalPath>;
 using TimePoint     = long long int;
@@ -3,3 +3,59 @@
 // SPDX-License-Identifier: EUPL-1.2
 
 #include "uuid_generator.hpp"
+
+#include <boost/uuid/random_generator.hpp>
+#include <boost/uuid/uuid_io.hpp>
+#include <chrono>
+#include <cstdint>
+
+namespace storm {
+
+namespace {
+
+struct GeneratorState
+{
+  boost::uuids::random_generator random;
+  std::uint64_t last_ms{0};
+  // a 12-bit counter, which keeps the UUIDs generated by a thread in the same
+  // millisecond ordered
+  std::uint32_t counter{0};
+};
+
+} // namespace
+
+// The layout is a 48-bit Unix timestamp in milliseconds, the version, the
+// counter, the variant and 62 random bits. The counter starts from a random
+// value in its lower half, leaving room for the increments; if it overflows
+// the timestamp is advanced, as if the next millisecond had already come.
+std::string UuidGenerator::operator()() const
+{
+  static thread_local GeneratorState state;
+
+  // the random bits, including the variant, come from a version 4 UUID
+  auto uuid = state.random();
+
+  auto const now = static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::system_clock::now().time_since_epoch())
+          .count());
+  auto const reseed = std::uint32_t{uuid.data[6]} << 8 | uuid.data[7];
+  if (now > state.last_ms) {
+    state.last_ms = now;
+    state.counter = reseed & 0x7FF;
+  } else if (++state.counter > 0xFFF) {
+    // same millisecond, or the clock went backwards
+    ++state.last_ms;
+    state.counter = reseed & 0x7FF;
+  }
+
+  for (int i{0}; i != 6; ++i) {
+    uuid.data[i] = static_cast<std::uint8_t>(state.last_ms >> (40 - 8 * i));
+  }
+  uuid.data[6] = static_cast<std::uint8_t>(0x70 | state.counter >> 8);
+  uuid.data[7] = static_cast<std::uint8_t>(state.counter);
+
+  return boost::uuids::to_string(uuid);
+}
+
+} // namespace storm
@@ -5,20 +5,17 @@
 #ifndef STORM_UUID_GENERATOR_HPP
 #define STORM_UUID_GENERATOR_HPP
 
-#include <boost/uuid/random_generator.hpp>
-#include <boost/uuid/uuid_io.hpp>
+#include <string>
 
 namespace storm {
 
+// Generates time-ordered UUIDs (version 7, RFC 9562) in their canonical string
+// form. The state of the generator is kept per thread, so a single instance
+// can be shared by all the threads without any synchronization.
 class UuidGenerator
 {
-  boost::uuids::random_generator m_gen;
-
  public:
-  std::string operator()()
-  {
-    return boost::uuids::to_string(m_gen());
-  }
+  std::string operator()() const;
 };
 
 } // namespace storm
@@ -0,0 +1,134 @@
+// SPDX-FileCopyrightText: 2025 Istituto Nazionale di Fisica Nucleare
+//
+// SPDX-License-Identifier: EUPL-1.2
+
+#include "access_log_writer.hpp"
+#include "uuid_generator.hpp"
+
+#include <doctest/doctest.h>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct TempFile
+{
+  fs::path path{fs::temp_directory_path() / storm::UuidGenerator{}()};
+  ~TempFile()
+  {
+    fs::remove(path);
+  }
+};
+
+std::vector<std::string> read_lines(fs::path const& path)
+{
+  std::ifstream is{path};
+  std::vector<std::string> lines;
+  for (std::string line; std::getline(is, line);) {
+    lines.push_back(line);
+  }
+  return lines;
+}
+
+// the line without the timestamp
+std::string format(storm::AccessLogRecord const& record)
+{
+  std::string line;
+  storm::append_access_log_line(line, record);
+  return line.substr(line.find(' ') + 1);
+}
+
+} // namespace
+
+TEST_SUITE_BEGIN("AccessLogWriter");
+
+TEST_CASE("A record is formatted as a line of the access log")
+{
+  storm::AccessLogRecord record{
+      .timestamp      = std::time(nullptr),
+      .request_id     = "abc-123",
+      .principal      = "/DC=org/CN=\"user\"",
+      .operation      = "STAGE",
+      .code           = 201,
+      .latency        = std::chrono::microseconds{1'500},
+      .request_bytes  = 54,
+      .response_bytes = 12,
+      .n_files        = 2,
+      .stage_id       = "an-id"};
+  record.is_voms_user = true;
+  record.files        = {storm::File{storm::LogicalPath{"/atlas/a"}},
+                         storm::File{storm::LogicalPath{"/atlas/b"}}};
+  CHECK_EQ(format(record),
+           "abc-123 \"/DC=org/CN=\\\"user\\\"\" STAGE 201 1.500 54 12 2 "
+           "an-id [\"/atlas/a\",\"/atlas/b\"]\n");
+
+  record.request_id   = "not a valid id";
+  record.principal    = "sub";
+  record.is_voms_user = false;
+  record.operation    = "READY";
+  record.code         = 200;
+  record.latency      = std::chrono::microseconds{42};
+  CHECK_EQ(format(record), "- sub READY 200 0.042 54 12 2\n");
+
+  // a line doesn't exceed 2048 characters
+  record.operation = "STAGE";
+  record.files.assign(1'000, storm::File{storm::LogicalPath{"/atlas/file"}});
+  auto const line = format(record);
+  CHECK_LT(line.size(), 2'048);
+  CHECK(line.ends_with(",...]\n"));
+}
+
+TEST_CASE("The records of all the threads are written")
+{
+  TempFile file;
+  {
+    storm::AccessLogWriter writer{storm::AccessLogConfiguration{
+        .file = file.path, .flush_interval = std::chrono::milliseconds{1}}};
+    std::vector<std::jthread> threads;
+    for (int t{0}; t != 4; ++t) {
+      threads.emplace_back([&, t] {
+        for (int i{0}; i != 100; ++i) {
+          CHECK(writer.push(storm::AccessLogRecord{
+              .request_id = std::to_string(t),
+              .operation  = "STATUS",
+              .code       = 200,
+              .stage_id   = std::to_string(i)}));
+        }
+      });
+    }
+    threads.clear();
+    CHECK_EQ(writer.dropped(), 0);
+  }
+  auto const lines = read_lines(file.path);
+  CHECK_EQ(lines.size(), 400);
+  auto const is_last_of_thread_2 = [](std::string const& line) {
+    return line.ends_with(" 2 - STATUS 200 0.000 0 0 0 99");
+  };
+  CHECK_EQ(std::count_if(lines.begin(), lines.end(), is_last_of_thread_2), 1);
+}
+
+TEST_CASE("The records that don't fit in the buffer are dropped")
+{
+  TempFile file;
+  {
+    storm::AccessLogWriter writer{storm::AccessLogConfiguration{
+        .file = file.path, .buffer_size = 2,
+        .flush_interval = std::chrono::hours{1}}};
+    CHECK(writer.push(storm::AccessLogRecord{.operation = "READY"}));
+    CHECK(writer.push(storm::AccessLogRecord{.operation = "READY"}));
+    CHECK_FALSE(writer.push(storm::AccessLogRecord{.operation = "READY"}));
+    CHECK_EQ(writer.dropped(), 1);
+  }
+  // the buffered records are written when the writer stops
+  CHECK_EQ(read_lines(file.path).size(), 2);
+}
+
+TEST_SUITE_END;
@@ -6,9 +6,11 @@
 #include "uuid_generator.hpp"
 #include <doctest/doctest.h>
 #include <fmt/std.h>
+#include <chrono>
 #include <filesystem>
 #include <fstream>
 #include <sstream>
+#include <utility>
 
 namespace fs = std::filesystem;
 
@@ -1365,4 +1367,679 @@ telemetry:
   CHECK_EQ(otel_config.tracing_endpoint, "file://example.txt");
 }
 
+TEST_CASE("The database settings have defaults, if not specified")
+{
+  auto constexpr conf = R"(
+storage-areas:
+- name: test
+  root: {}
+  access-point: /someexp
+)";
+  storm::TempDirectory tmp{};
+  std::istringstream is{fmt::format(conf, tmp.path())};
+  auto const config = storm::load_configuration(is);
+  auto const& db    = config.database;
+  CHECK_EQ(db.path, fs::path{"storm-tape.sqlite"});
+  CHECK_EQ(db.journal_mode, "WAL");
+  CHECK_EQ(db.synchronous, "NORMAL");
+  CHECK_EQ(db.mmap_size, 256 * 1024 * 1024);
+  CHECK_EQ(db.cache_size, 64 * 1024);
+  CHECK_EQ(db.busy_timeout, std::chrono::milliseconds{5'000});
+  CHECK_EQ(db.lease_timeout, std::chrono::milliseconds{30'000});
+}
+
+TEST_CASE("The database settings can be specified")
+{
+  auto constexpr conf = R"(
+storage-areas:
+- name: test
+  root: {}
+  access-point: /someexp
+database:
+  path: {}/tape.db
+  journal-mode: delete
+  synchronous: full
+  mmap-size: 0
+  cache-size: 1024
+  busy-timeout: 100
+  lease-timeout: 200
+)";
+  storm::TempDirectory tmp{};
+  std::istringstream is{fmt::format(conf, tmp.path(), tmp.path())};
+  auto const config = storm::load_configuration(is);
+  auto const& db    = config.database;
+  CHECK_EQ(db.path, tmp.path() / "tape.db");
+  CHECK_EQ(db.journal_mode, "DELETE");
+  CHECK_EQ(db.synchronous, "FULL");
+  CHECK_EQ(db.mmap_size, 0);
+  CHECK_EQ(db.cache_size, 1024);
+  CHECK_EQ(db.busy_timeout, std::chrono::milliseconds{100});
+  CHECK_EQ(db.lease_timeout, std::chrono::milliseconds{200});
+}
+
+TEST_CASE("The database journal mode must be valid")
+{
+  auto constexpr conf = R"(
+storage-areas:
+- name: test
+  root: {}
+  access-point: /someexp
+database:
+  journal-mode: {}
+)";
+  storm::TempDirectory tmp{};
+
+  for (auto s : {"wal2", "1", "[wal]"}) {
+    std::istringstream is{fmt::format(conf, tmp.path(), s)};
+    CHECK_THROWS_WITH_AS(storm::load_configuration(is),
+                         "invalid 'journal-mode' entry in configuration",
+                         std::runtime_error);
+  }
+}
+
+TEST_CASE("The database synchronous level must be valid")
+{
+  auto constexpr conf = R"(
+storage-areas:
+- name: test
+  root: {}
+  access-point: /someexp
+database:
+  synchronous: {}
+)";
+  storm::TempDirectory tmp{};
+
+  for (auto s : {"sometimes", "4"}) {
+    std::istringstream is{fmt::format(conf, tmp.path(), s)};
+    CHECK_THROWS_WITH_AS(storm::load_configuration(is),
+                         "invalid 'synchronous' entry in configuration",
+                         std::runtime_error);
+  }
+}
+
+TEST_CASE("The database sizes cannot be negative")
+{
+  auto constexpr conf = R"(
+storage-areas:
+- name: test
+  root: {}
+  access-point: /someexp
+database:
+  {}: {}
+)";
+  storm::TempDirectory tmp{};
+
+  for (auto key :
+       {"mmap-size", "cache-size", "busy-timeout", "lease-timeout"}) {
+    for (auto value : {"-1", "1.5", "many"}) {
+      std::istringstream is{fmt::format(conf, tmp.path(), key, value)};
+      CHECK_THROWS_WITH_AS(
+          storm::load_configuration(is),
+          fmt::format("invalid '{}' entry in configuration", key).c_str(),
+          std::runtime_error);
+    }
+  }
+}
+
+TEST_CASE("The database path cannot be empty")
+{
+  auto constexpr conf = R"(
+storage-areas:
+- name: test
+  root: {}
+  access-point: /someexp
+database:
+  path:
+)";
+  storm::TempDirectory tmp{};
+  std::istringstream is{fmt::format(conf, tmp.path())};
+  CHECK_THROWS_WITH_AS(storm::load_configuration(is), "'path' is null",
+                       std::runtime_error);
+}
+
+TEST_CASE("Group commit is disabled, if not specified")
+{
+  auto constexpr conf = R"(
+storage-areas:
+- name: test
+  root: {}
+  access-point: /someexp
+)";
+  storm::TempDirectory tmp{};
+  std::istringstream is{fmt::format(conf, tmp.path())};
+  auto const config = storm::load_configuration(is);
+  CHECK_FALSE(config.group_commit.has_value());
+}
+
+TEST_CASE("Group commit can be enabled with its defaults")
+{
+  auto constexpr conf = R"(
+storage-areas:
+- name: test
+  root: {}
+  access-point: /someexp
+group-commit: {{}}
+)";
+  storm::TempDirectory tmp{};
+  std::istringstream is{fmt::format(conf, tmp.path())};
+  auto const config = storm::load_configuration(is);
+  REQUIRE(config.group_commit.has_value());
+  CHECK_EQ(config.group_commit->max_batch_size, 256);
+  CHECK_EQ(config.group_commit->max_batch_latency,
+           std::chrono::milliseconds{1});
+  CHECK_EQ(config.group_commit->queue_capacity, 4096);
+}
+
+TEST_CASE("The group commit batch size and latency can be specified")
+{
+  auto constexpr conf = R"(
+storage-areas:
+- name: test
+  root: {}
+  access-point: /someexp
+group-commit:
+  max-batch-size: 1000
+  max-batch-latency: 0
+)";
+  storm::TempDirectory tmp{};
+  std::istringstream is{fmt::format(conf, tmp.path())};
+  auto const config = storm::load_configuration(is);
+  REQUIRE(config.group_commit.has_value());
+  CHECK_EQ(config.group_commit->max_batch_size, 1000);
+  CHECK_EQ(config.group_commit->max_batch_latency,
+           std::chrono::milliseconds{0});
+}
+
+TEST_CASE("The group commit batch size must be positive")
+{
+  auto constexpr conf = R"(
+storage-areas:
+- name: test
+  root: {}
+  access-point: /someexp
+group-commit:
+  max-batch-size: {}
+)";
+  storm::TempDirectory tmp{};
+
+  for (auto s : {"0", "-1", "many"}) {
+    std::istringstream is{fmt::format(conf, tmp.path(), s)};
+    CHECK_THROWS_WITH_AS(storm::load_configuration(is),
+                         "invalid 'max-batch-size' entry in configuration",
+                         std::runtime_error);
+  }
+}
+
+TEST_CASE("The group commit queue capacity must be positive")
+{
+  auto constexpr conf = R"(
+storage-areas:
+- name: test
+  root: {}
+  access-point: /someexp
+group-commit:
+  queue-capacity: {}
+)";
+  storm::TempDirectory tmp{};
+
+  {
+    std::istringstream is{fmt::format(conf, tmp.path(), 100)};
+    auto const config = storm::load_configuration(is);
+    REQUIRE(config.group_commit.has_value());
+    CHECK_EQ(config.group_commit->queue_capacity, 100);
+  }
+  for (auto s : {"0", "-1", "many"}) {
+    std::istringstream is{fmt::format(conf, tmp.path(), s)};
+    CHECK_THROWS_WITH_AS(storm::load_configuration(is),
+                         "invalid 'queue-capacity' entry in configuration",
+                         std::runtime_error);
+  }
+}
+
+TEST_CASE("The stage cache memory budget is expressed in MiB")
+{
+  auto constexpr conf = R"(
+storage-areas:
+- name: test
+  root: {}
+  access-point: /someexp
+stage-cache:
+  memory-budget: 128
+)";
+  storm::TempDirectory tmp{};
+  std::istringstream is{fmt::format(conf, tmp.path())};
+  auto const config = storm::load_configuration(is);
+  REQUIRE(config.stage_cache.has_value());
+  CHECK_EQ(config.stage_cache->memory_budget, 128 * 1024 * 1024);
+}
+
+TEST_CASE("The stage cache memory budget cannot be negative")
+{
+  auto constexpr conf = R"(
+storage-areas:
+- name: test
+  root: {}
+  access-point: /someexp
+stage-cache:
+  memory-budget: -1
+)";
+  storm::TempDirectory tmp{};
+  std::istringstream is{fmt::format(conf, tmp.path())};
+  CHECK_THROWS_WITH_AS(storm::load_configuration(is),
+                       "invalid 'memory-budget' entry in configuration",
+                       std::runtime_error);
+}
+
+TEST_CASE("The stage cache cannot be used with the group commit")
+{
+  auto constexpr conf = R"(
+storage-areas:
+- name: test
+  root: {}
+  access-point: /someexp
+group-commit: {{}}
+stage-cache: {{}}
+)";
+  storm::TempDirectory tmp{};
+  std::istringstream is{fmt::format(conf, tmp.path())};
+  CHECK_THROWS_WITH_AS(
+      storm::load_configuration(is),
+      "'stage-cache' and 'group-commit' cannot be used together",
+      std::runtime_error);
+}
+
+TEST_CASE("The reconciler is disabled by default")
+{
+  auto constexpr conf = R"(
+storage-areas:
+- name: test
+  root: {}
+  access-point: /someexp
+)";
+  storm::TempDirectory tmp{};
+  std::istringstream is{fmt::format(conf, tmp.path())};
+  auto const config = storm::load_configuration(is);
+  CHECK_FALSE(config.reconciler.has_value());
+}
+
+TEST_CASE("Load the reconciler configuration")
+{
+  auto constexpr conf = R"(
+storage-areas:
+- name: test
+  root: {}
+  access-point: /someexp
+reconciler:
+  threads: 4
+  interval: 30
+)";
+  storm::TempDirectory tmp{};
+  std::istringstream is{fmt::format(conf, tmp.path())};
+  auto const config = storm::load_configuration(is);
+  REQUIRE(config.reconciler.has_value());
+  CHECK_EQ(config.reconciler->threads, 4);
+  CHECK_EQ(config.reconciler->interval, std::chrono::seconds{30});
+}
+
+TEST_CASE("The reconciler needs at least one thread")
+{
+  auto constexpr conf = R"(
+storage-areas:
+- name: test
+  root: {}
+  access-point: /someexp
+reconciler:
+  threads: 0
+)";
+  storm::TempDirectory tmp{};
+  std::istringstream is{fmt::format(conf, tmp.path())};
+  CHECK_THROWS_WITH_AS(storm::load_configuration(is),
+                       "invalid 'threads' entry in configuration",
+                       std::runtime_error);
+}
+
+TEST_CASE("Load the recall watcher configuration")
+{
+  auto constexpr conf = R"(
+storage-areas:
+- name: test
+  root: {}
+  access-point: /someexp
+recall-watcher:
+  max-directories: 100
+  max-files: 1000
+)";
+  storm::TempDirectory tmp{};
+  std::istringstream is{fmt::format(conf, tmp.path())};
+  auto const config = storm::load_configuration(is);
+  REQUIRE(config.recall_watcher.has_value());
+  CHECK_EQ(config.recall_watcher->max_directories, 100);
+  CHECK_EQ(config.recall_watcher->max_files, 1000);
+}
+
+TEST_CASE("The recall watcher needs at least one directory")
+{
+  auto constexpr conf = R"(
+storage-areas:
+- name: test
+  root: {}
+  access-point: /someexp
+recall-watcher:
+  max-directories: 0
+)";
+  storm::TempDirectory tmp{};
+  std::istringstream is{fmt::format(conf, tmp.path())};
+  CHECK_THROWS_WITH_AS(storm::load_configuration(is),
+                       "invalid 'max-directories' entry in configuration",
+                       std::runtime_error);
+}
+
+TEST_CASE("The recall watcher needs at least one file")
+{
+  auto constexpr conf = R"(
+storage-areas:
+- name: test
+  root: {}
+  access-point: /someexp
+recall-watcher:
+  max-files: 0
+)";
+  storm::TempDirectory tmp{};
+  std::istringstream is{fmt::format(conf, tmp.path())};
+  CHECK_THROWS_WITH_AS(storm::load_configuration(is),
+                       "invalid 'max-files' entry in configuration",
+                       std::runtime_error);
+}
+
+TEST_CASE("Load the parallelism configuration")
+{
+  auto constexpr conf = R"(
+storage-areas:
+- name: test
+  root: {}
+  access-point: /someexp
+parallelism:
+  threads: 8
+  status:
+    files-per-task: 500
+)";
+  storm::TempDirectory tmp{};
+  std::istringstream is{fmt::format(conf, tmp.path())};
+  auto const config = storm::load_configuration(is);
+  REQUIRE(config.parallelism.has_value());
+  CHECK_EQ(config.parallelism->threads, 8);
+  CHECK_EQ(config.parallelism->status.files_per_task, 500);
+  CHECK_EQ(config.parallelism->status.threads, 0);
+  CHECK_EQ(config.parallelism->stage.files_per_task, 1'000);
+}
+
+TEST_CASE("Load the parallelism configuration of each operation")
+{
+  auto constexpr conf = R"(
+storage-areas:
+- name: test
+  root: {}
+  access-point: /someexp
+parallelism:
+  threads: 16
+  stage:
+    threads: 4
+    files-per-task: 2000
+  archive-info:
+    files-per-task: 100
+  take-over:
+    threads: 2
+)";
+  storm::TempDirectory tmp{};
+  std::istringstream is{fmt::format(conf, tmp.path())};
+  auto const config = storm::load_configuration(is);
+  REQUIRE(config.parallelism.has_value());
+  auto const& parallelism = *config.parallelism;
+  CHECK_EQ(parallelism.threads, 16);
+  CHECK_EQ(parallelism.status.threads, 0);
+  CHECK_EQ(parallelism.status.files_per_task, 1'000);
+  CHECK_EQ(parallelism.stage.threads, 4);
+  CHECK_EQ(parallelism.stage.files_per_task, 2'000);
+  CHECK_EQ(parallelism.archive_info.threads, 0);
+  CHECK_EQ(parallelism.archive_info.files_per_task, 100);
+  CHECK_EQ(parallelism.take_over.threads, 2);
+  CHECK_EQ(parallelism.take_over.files_per_task, 1'000);
+}
+
+TEST_CASE("An operation of the parallelism configuration must be a map")
+{
+  auto constexpr conf = R"(
+storage-areas:
+- name: test
+  root: {}
+  access-point: /someexp
+parallelism:
+  take-over: 4
+)";
+  storm::TempDirectory tmp{};
+  std::istringstream is{fmt::format(conf, tmp.path())};
+  CHECK_THROWS_WITH_AS(storm::load_configuration(is),
+                       "invalid 'take-over' entry in configuration",
+                       std::runtime_error);
+}
+
+TEST_CASE("The status files per task cannot be zero")
+{
+  auto constexpr conf = R"(
+storage-areas:
+- name: test
+  root: {}
+  access-point: /someexp
+parallelism:
+  status:
+    files-per-task: 0
+)";
+  storm::TempDirectory tmp{};
+  std::istringstream is{fmt::format(conf, tmp.path())};
+  CHECK_THROWS_WITH_AS(storm::load_configuration(is),
+                       "invalid 'files-per-task' entry in configuration",
+                       std::runtime_error);
+}
+
+TEST_CASE("Load the io_uring configuration")
+{
+  auto constexpr conf = R"(
+storage-areas:
+- name: test
+  root: {}
+  access-point: /someexp
+io-uring:
+  queue-depth: 1024
+)";
+  storm::TempDirectory tmp{};
+  std::istringstream is{fmt::format(conf, tmp.path())};
+  auto const config = storm::load_configuration(is);
+  REQUIRE(config.io_uring.has_value());
+  CHECK_EQ(config.io_uring->queue_depth, 1024);
+}
+
+TEST_CASE("The io_uring queue depth must be accepted by the kernel")
+{
+  auto constexpr conf = R"(
+storage-areas:
+- name: test
+  root: {}
+  access-point: /someexp
+io-uring:
+  queue-depth: {}
+)";
+  for (auto depth : {0, 65536}) {
+    storm::TempDirectory tmp{};
+    std::istringstream is{fmt::format(conf, tmp.path(), depth)};
+    CHECK_THROWS_WITH_AS(storm::load_configuration(is),
+                         "invalid 'queue-depth' entry in configuration",
+                         std::runtime_error);
+  }
+}
+
+TEST_CASE("Load the directory probing configuration")
+{
+  auto constexpr conf = R"(
+storage-areas:
+- name: test
+  root: {}
+  access-point: /someexp
+directory-probing:
+  max-open-directories: 16
+)";
+  storm::TempDirectory tmp{};
+  std::istringstream is{fmt::format(conf, tmp.path())};
+  auto const config = storm::load_configuration(is);
+  REQUIRE(config.directory_probing.has_value());
+  CHECK_EQ(config.directory_probing->max_open_directories, 16);
+}
+
+TEST_CASE("At least a directory must be kept open")
+{
+  auto constexpr conf = R"(
+storage-areas:
+- name: test
+  root: {}
+  access-point: /someexp
+directory-probing:
+  max-open-directories: 0
+)";
+  storm::TempDirectory tmp{};
+  std::istringstream is{fmt::format(conf, tmp.path())};
+  CHECK_THROWS_WITH_AS(storm::load_configuration(is),
+                       "invalid 'max-open-directories' entry in configuration",
+                       std::runtime_error);
+}
+
+TEST_CASE("Load the file status cache configuration")
+{
+  auto constexpr conf = R"(
+storage-areas:
+- name: test
+  root: {}
+  access-point: /someexp
+file-status-cache:
+  ttl: 500
+  max-files: 1000
+)";
+  storm::TempDirectory tmp{};
+  std::istringstream is{fmt::format(conf, tmp.path())};
+  auto const config = storm::load_configuration(is);
+  REQUIRE(config.file_status_cache.has_value());
+  CHECK_EQ(config.file_status_cache->ttl, std::chrono::milliseconds{500});
+  CHECK_EQ(config.file_status_cache->max_files, 1000);
+}
+
+TEST_CASE("The file status cache needs a positive ttl")
+{
+  auto constexpr conf = R"(
+storage-areas:
+- name: test
+  root: {}
+  access-point: /someexp
+file-status-cache:
+  ttl: 0
+)";
+  storm::TempDirectory tmp{};
+  std::istringstream is{fmt::format(conf, tmp.path())};
+  CHECK_THROWS_WITH_AS(storm::load_configuration(is),
+                       "invalid 'ttl' entry in configuration",
+                       std::runtime_error);
+}
+
+TEST_CASE("Load the access log configuration")
+{
+  auto constexpr conf = R"(
+storage-areas:
+- name: test
+  root: {}
+  access-point: /someexp
+access-log:
+  file: /var/log/storm-tape/access.log
+  buffer-size: 100
+  flush-interval: 50
+)";
+  storm::TempDirectory tmp{};
+  std::istringstream is{fmt::format(conf, tmp.path())};
+  auto const config = storm::load_configuration(is);
+  CHECK_EQ(config.access_log.file, "/var/log/storm-tape/access.log");
+  CHECK_EQ(config.access_log.buffer_size, 100);
+  CHECK_EQ(config.access_log.flush_interval, std::chrono::milliseconds{50});
+}
+
+TEST_CASE("By default the access log goes to the standard output")
+{
+  auto constexpr conf = R"(
+storage-areas:
+- name: test
+  root: {}
+  access-point: /someexp
+)";
+  storm::TempDirectory tmp{};
+  std::istringstream is{fmt::format(conf, tmp.path())};
+  auto const config = storm::load_configuration(is);
+  CHECK(config.access_log.file.empty());
+  CHECK_EQ(config.access_log.buffer_size, 4'096);
+}
+
+TEST_CASE("Tracing level defaults to 'full'")
+{
+  auto constexpr conf = R"(
+storage-areas:
+- name: test
+  root: {}
+  access-point: /someexp
+telemetry:
+  tracing-endpoint: https://example.org
+)";
+  storm::TempDirectory tmp{};
+  std::istringstream is{fmt::format(conf, tmp.path())};
+  auto const config = storm::load_configuration(is);
+  CHECK_EQ(config.telemetry.value().tracing_level, storm::TracingLevel::full);
+}
+
+TEST_CASE("Tracing level can be 'off', 'request' or 'full'")
+{
+  auto constexpr conf = R"(
+storage-areas:
+- name: test
+  root: {}
+  access-point: /someexp
+telemetry:
+  tracing-endpoint: https://example.org
+  tracing-level: {}
+)";
+  for (auto [name, level] : {std::pair{"off", storm::TracingLevel::off},
+                             std::pair{"request", storm::TracingLevel::request},
+                             std::pair{"full", storm::TracingLevel::full}}) {
+    storm::TempDirectory tmp{};
+    std::istringstream is{fmt::format(conf, tmp.path(), name)};
+    auto const config = storm::load_configuration(is);
+    CHECK_EQ(config.telemetry.value().tracing_level, level);
+  }
+}
+
+TEST_CASE("Tracing level must be valid")
+{
+  auto constexpr conf = R"(
+storage-areas:
+- name: test
+  root: {}
+  access-point: /someexp
+telemetry:
+  tracing-endpoint: https://example.org
+  tracing-level: {}
+)";
+  for (auto name : {"", "none", "[full]"}) {
+    storm::TempDirectory tmp{};
+    std::istringstream is{fmt::format(conf, tmp.path(), name)};
+    CHECK_THROWS_AS(storm::load_configuration(is), std::runtime_error);
+  }
+  storm::TempDirectory tmp{};
+  std::istringstream is{fmt::format(conf, tmp.path(), "all")};
+  CHECK_THROWS_WITH_AS(storm::load_configuration(is),
+                       "invalid 'tracing-level' entry in configuration",
+                       std::runtime_error);
+}
+
 TEST_SUITE_END;
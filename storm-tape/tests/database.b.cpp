@@ -0,0 +1,178 @@
+// SPDX-FileCopyrightText: 2025 Istituto Nazionale di Fisica Nucleare
+//
+// SPDX-License-Identifier: EUPL-1.2
+
+#include "database_soci.hpp"
+#include "errors.hpp"
+#include "stage_request.hpp"
+#include "uuid_generator.hpp"
+#include <boost/program_options.hpp>
+#include <fmt/core.h>
+#include <soci/sqlite3/soci-sqlite3.h>
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace po = boost::program_options;
+
+namespace {
+
+using Duration = std::chrono::duration<double, std::micro>;
+
+storm::Files generate_files(std::size_t n_files)
+{
+  storm::Files files;
+  files.reserve(n_files);
+  for (std::size_t i{0}; i != n_files; ++i) {
+    auto const name = fmt::format("dir{:03}/file{:06}.dat", i % 100, i);
+    files.push_back(storm::File{storm::LogicalPath{"/atlas/" + name},
+                                storm::PhysicalPath{"/storage/atlas/" + name}});
+  }
+  return files;
+}
+
+// time the insertion of a stage with n_files files, averaged over n_runs
+// stages
+Duration benchmark_insert(storm::SociDatabase& db, std::size_t n_files,
+                          int n_runs)
+{
+  storm::UuidGenerator uuid_gen;
+  storm::StageRequest const stage{generate_files(n_files), std::time(nullptr),
+                                  0, 0};
+  Duration total{};
+  for (int i{0}; i != n_runs; ++i) {
+    auto const id = uuid_gen();
+    auto const t0 = std::chrono::steady_clock::now();
+    if (!db.insert(id, stage)) {
+      throw std::runtime_error{"insert failed"};
+    }
+    total += std::chrono::steady_clock::now() - t0;
+  }
+  return total / n_runs;
+}
+
+struct QueryTimes
+{
+  Duration count_files;
+  Duration get_files;
+  Duration update;
+};
+
+// time the queries that are not driven by a stage id, which must not depend on
+// the size of the File table
+QueryTimes benchmark_queries(storm::SociDatabase& db, int n_runs)
+{
+  auto const paths = [] {
+    storm::PhysicalPaths result;
+    for (auto const& file : generate_files(100)) {
+      result.push_back(file.physical_path);
+    }
+    return result;
+  }();
+  auto const submitted = storm::File::State::submitted;
+  auto const started   = storm::File::State::started;
+
+  QueryTimes total{};
+  for (int i{0}; i != n_runs; ++i) {
+    auto t0 = std::chrono::steady_clock::now();
+    db.count_files(submitted);
+    auto t1 = std::chrono::steady_clock::now();
+    total.count_files += t1 - t0;
+
+    t0 = std::chrono::steady_clock::now();
+    db.get_files(submitted, 1'000);
+    t1 = std::chrono::steady_clock::now();
+    total.get_files += t1 - t0;
+
+    auto const& path = paths[static_cast<std::size_t>(i) % paths.size()];
+    t0               = std::chrono::steady_clock::now();
+    db.update(path, started, std::time(nullptr));
+    t1 = std::chrono::steady_clock::now();
+    total.update += t1 - t0;
+  }
+  return {total.count_files / n_runs, total.get_files / n_runs,
+          total.update / n_runs};
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  try {
+    std::string db_name;
+    int n_runs{};
+    po::options_description desc("Allowed options");
+
+    // clang-format off
+    desc.add_options()
+    ("help,h", "produce help message")
+    ("database,d",
+     po::value<std::string>(&db_name)->default_value(":memory:"),
+     "specify the SQLite database"
+    )
+    ("runs,r",
+     po::value<int>(&n_runs)->default_value(5),
+     "number of stages inserted for each size"
+    );
+    // clang-format on
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+
+    if (vm.count("help")) {
+      std::cout << desc << "\n";
+      return EXIT_SUCCESS;
+    }
+
+    if (n_runs <= 0) {
+      throw std::runtime_error{"the number of runs must be positive"};
+    }
+
+    soci::connection_pool pool{1};
+    pool.at(0).open(soci::sqlite3, db_name);
+    storm::SociDatabase db{pool};
+
+    std::cout << fmt::format("{:>8} {:>14} {:>14}\n", "files", "stage (ms)",
+                             "file (us)");
+    std::array<std::size_t, 5> const sizes{10, 100, 1'000, 10'000, 100'000};
+    std::vector<std::pair<std::size_t, QueryTimes>> query_times;
+    std::size_t n_rows{0};
+    for (auto const n_files : sizes) {
+      auto const t = benchmark_insert(db, n_files, n_runs);
+      std::cout << fmt::format("{:>8} {:>14.3f} {:>14.3f}\n", n_files,
+                               t.count() / 1'000.,
+                               t.count() / static_cast<double>(n_files));
+      n_rows += n_files * static_cast<std::size_t>(n_runs);
+      query_times.emplace_back(n_rows, benchmark_queries(db, n_runs));
+    }
+
+    std::cout << fmt::format("\n{:>8} {:>14} {:>14} {:>14}\n", "rows",
+                             "count (us)", "get (us)", "update (us)");
+    for (auto const& [rows, t] : query_times) {
+      std::cout << fmt::format("{:>8} {:>14.3f} {:>14.3f} {:>14.3f}\n", rows,
+                               t.count_files.count(), t.get_files.count(),
+                               t.update.count());
+    }
+
+  } catch (std::exception const& e) {
+    std::cerr << fmt::format("Caught exception: {}\n", e.what());
+    return EXIT_FAILURE;
+  } catch (...) {
+    std::cerr << "Caught unknown exception\n";
+    return EXIT_FAILURE;
+  }
+}
+
+void boost::assertion_failed(char const* expr, char const* function,
+                             char const* file, long line)
+{
+  std::cerr << "Failed assertion: '" << expr << "' in '" << function << "' ("
+            << file << ':' << line << ")\n";
+  std::abort();
+}
@@ -0,0 +1,133 @@
+// SPDX-FileCopyrightText: 2025 Istituto Nazionale di Fisica Nucleare
+//
+// SPDX-License-Identifier: EUPL-1.2
+
+#include "configuration.hpp"
+#include "database_caching.hpp"
+#include "fixture.t.hpp"
+#include "stage_request.hpp"
+#include "uuid_generator.hpp"
+
+#include <doctest/doctest.h>
+#include <ctime>
+
+namespace {
+
+void check_same(storm::StageRequest const& s1, storm::StageRequest const& s2)
+{
+  CHECK_EQ(s1.created_at, s2.created_at);
+  CHECK_EQ(s1.started_at, s2.started_at);
+  CHECK_EQ(s1.completed_at, s2.completed_at);
+  REQUIRE_EQ(s1.files.size(), s2.files.size());
+  for (std::size_t i{0}; i != s1.files.size(); ++i) {
+    auto const& f1 = s1.files[i];
+    auto const& f2 = s2.files[i];
+    CHECK_EQ(f1.logical_path, f2.logical_path);
+    CHECK_EQ(f1.physical_path, f2.physical_path);
+    CHECK_EQ(f1.state, f2.state);
+    CHECK_EQ(f1.started_at, f2.started_at);
+    CHECK_EQ(f1.finished_at, f2.finished_at);
+  }
+}
+
+} // namespace
+
+TEST_SUITE_BEGIN("CachingDatabase");
+
+TEST_CASE("An inserted stage is found in the cache")
+{
+  storm::DatabaseFixture fixture;
+  storm::CachingDatabase db{fixture.get_db(), storm::StageCacheConfiguration{}};
+
+  auto const id = fixture.get_uuid_gen()();
+  REQUIRE(db.insert(id, {storm::make_files(3), std::time(nullptr), 0, 0}));
+
+  auto stage = db.find(id);
+  REQUIRE(stage.has_value());
+  check_same(*stage, *fixture.get_db().find(id));
+
+  auto const stats = db.stats();
+  CHECK_EQ(stats.hits, 1);
+  CHECK_EQ(stats.misses, 0);
+  CHECK_EQ(stats.evictions, 0);
+}
+
+TEST_CASE("A stage not in the cache is read from the database and cached")
+{
+  storm::DatabaseFixture fixture;
+  auto const id = fixture.get_uuid_gen()();
+  REQUIRE(fixture.get_db().insert(
+      id, {storm::make_files(3), std::time(nullptr), 0, 0}));
+
+  storm::CachingDatabase db{fixture.get_db(), storm::StageCacheConfiguration{}};
+  CHECK(db.find(id).has_value());
+  CHECK(db.find(id).has_value());
+  CHECK_FALSE(db.find(fixture.get_uuid_gen()()).has_value());
+
+  auto const stats = db.stats();
+  CHECK_EQ(stats.hits, 1);
+  CHECK_EQ(stats.misses, 2);
+}
+
+TEST_CASE("The cached stages follow the updates")
+{
+  storm::DatabaseFixture fixture;
+  storm::CachingDatabase db{fixture.get_db(), storm::StageCacheConfiguration{}};
+
+  auto const now = std::time(nullptr);
+  auto const id1 = fixture.get_uuid_gen()();
+  auto const id2 = fixture.get_uuid_gen()();
+  auto const files = storm::make_files(4);
+  REQUIRE(db.insert(id1, {files, now, 0, 0}));
+  REQUIRE(db.insert(id2, {files, now, 0, 0}));
+
+  // by physical path, affecting both stages
+  storm::PhysicalPaths const started{files[0].physical_path,
+                                     files[1].physical_path};
+  CHECK(db.update(started, storm::File::State::started, now + 1));
+
+  // by logical path, in one stage
+  storm::LogicalPaths const cancelled{files[1].logical_path,
+                                      files[2].logical_path};
+  CHECK(db.update(id1, cancelled, storm::File::State::cancelled, now + 2));
+
+  // a status update
+  std::vector<std::pair<storm::PhysicalPath, storm::File::State>> path_states{
+      {files[0].physical_path, storm::File::State::completed},
+      {files[3].physical_path, storm::File::State::failed}};
+  CHECK(db.update(storm::StageUpdate{storm::StageEntity{id2, now, now + 1, 0},
+                                     path_states, now + 3}));
+
+  check_same(*db.find(id1), *fixture.get_db().find(id1));
+  check_same(*db.find(id2), *fixture.get_db().find(id2));
+  CHECK_EQ(db.stats().misses, 0);
+
+  CHECK(db.erase(id1));
+  CHECK_FALSE(db.find(id1).has_value());
+}
+
+TEST_CASE("The cache stays within its memory budget")
+{
+  storm::DatabaseFixture fixture;
+  // enough for a few small stages per shard
+  storm::CachingDatabase db{fixture.get_db(),
+                            storm::StageCacheConfiguration{64 * 1024}};
+
+  std::vector<storm::StageId> ids;
+  for (int i{0}; i != 200; ++i) {
+    ids.push_back(fixture.get_uuid_gen()());
+    REQUIRE(db.insert(ids.back(),
+                      {storm::make_files(10), std::time(nullptr), 0, 0}));
+  }
+  CHECK_GT(db.stats().evictions, 0);
+
+  // evicted stages are read again from the database
+  for (auto const& id : ids) {
+    auto stage = db.find(id);
+    REQUIRE(stage.has_value());
+    CHECK_EQ(stage->files.size(), 10);
+  }
+  CHECK_GT(db.stats().misses, 0);
+}
+
+TEST_SUITE_END;
@@ -0,0 +1,139 @@
+// SPDX-FileCopyrightText: 2025 Istituto Nazionale di Fisica Nucleare
+//
+// SPDX-License-Identifier: EUPL-1.2
+
+#include "configuration.hpp"
+#include "database_group_commit.hpp"
+#include "fixture.t.hpp"
+#include "stage_request.hpp"
+#include "uuid_generator.hpp"
+
+#include <doctest/doctest.h>
+#include <algorithm>
+#include <ctime>
+#include <thread>
+#include <vector>
+
+TEST_SUITE_BEGIN("GroupCommitDatabase");
+
+TEST_CASE("Concurrent inserts are all committed")
+{
+  storm::DatabaseFixture fixture{3};
+  storm::GroupCommitDatabase db{fixture.get_db(),
+                                storm::GroupCommitConfiguration{}};
+
+  std::vector<storm::StageId> ids(16);
+  {
+    std::vector<std::jthread> threads;
+    for (std::size_t i{0}; i != ids.size(); ++i) {
+      threads.emplace_back([&, i] {
+        storm::UuidGenerator uuid_gen;
+        ids[i] = uuid_gen();
+        storm::StageRequest stage{storm::make_files(10), std::time(nullptr), 0,
+                                  0};
+        CHECK(db.insert(ids[i], stage));
+      });
+    }
+  }
+
+  for (auto const& id : ids) {
+    auto stage = db.find(id);
+    REQUIRE(stage.has_value());
+    CHECK_EQ(stage->files.size(), 10);
+  }
+  CHECK_EQ(db.count_files(storm::File::State::submitted), 10);
+}
+
+TEST_CASE("The writers wait while the queue is full")
+{
+  // the writer and the reading threads share the two sessions
+  storm::DatabaseFixture fixture{2};
+  storm::GroupCommitDatabase db{
+      fixture.get_db(), storm::GroupCommitConfiguration{.queue_capacity = 1}};
+
+  auto const now = std::time(nullptr);
+  std::vector<storm::StageId> ids(8);
+  {
+    std::vector<std::jthread> threads;
+    for (std::size_t i{0}; i != ids.size(); ++i) {
+      ids[i] = fixture.get_uuid_gen()();
+      threads.emplace_back([&, i] {
+        storm::StageRequest stage{storm::make_files(2), now, 0, 0};
+        CHECK(db.insert(ids[i], stage));
+        // not waited for by the writer
+        db.update(storm::StageUpdate{storm::StageEntity{ids[i], now, now, 0},
+                                     {}, now});
+        CHECK_EQ(db.find(ids[i])->started_at, now);
+      });
+    }
+  }
+  CHECK_EQ(db.find_incomplete_stages().size(), ids.size());
+}
+
+TEST_CASE("A status update is visible to the following reads")
+{
+  storm::DatabaseFixture fixture{3};
+  storm::GroupCommitDatabase db{fixture.get_db(),
+                                storm::GroupCommitConfiguration{}};
+
+  auto const id  = fixture.get_uuid_gen()();
+  auto const now = std::time(nullptr);
+  REQUIRE(db.insert(id, storm::StageRequest{storm::make_files(2), now, 0, 0}));
+
+  {
+    // the files of the update go out of scope before the update is applied
+    std::vector<std::pair<storm::PhysicalPath, storm::File::State>> files{
+        {storm::PhysicalPath{"/storage/atlas/1"},
+         storm::File::State::completed}};
+    db.update(storm::StageUpdate{storm::StageEntity{id, now, now, 0}, files,
+                                 now});
+  }
+
+  auto stage = db.find(id);
+  REQUIRE(stage.has_value());
+  CHECK_EQ(stage->started_at, now);
+  auto const n_completed =
+      std::count_if(stage->files.begin(), stage->files.end(), [](auto& f) {
+        return f.state == storm::File::State::completed;
+      });
+  CHECK_EQ(n_completed, 1);
+  CHECK_EQ(db.count_files(storm::File::State::submitted), 1);
+}
+
+TEST_CASE("A failed write does not affect the others in the same batch")
+{
+  storm::DatabaseFixture fixture{3};
+  storm::GroupCommitDatabase db{fixture.get_db(),
+                                storm::GroupCommitConfiguration{}};
+
+  auto const id  = fixture.get_uuid_gen()();
+  auto const now = std::time(nullptr);
+  storm::StageRequest stage{storm::make_files(2), now, 0, 0};
+  REQUIRE(db.insert(id, stage));
+  // the same id violates the primary key of Stage
+  CHECK_FALSE(db.insert(id, stage));
+  CHECK(db.erase(id));
+  CHECK_FALSE(db.find(id).has_value());
+}
+
+TEST_CASE("A failed write leaves no partial changes")
+{
+  storm::DatabaseFixture fixture{3};
+  // the files of a stage are deleted before the stage itself, which fails
+  fixture.get_pool().at(0)
+      << "CREATE TRIGGER keep_stages BEFORE DELETE ON Stage BEGIN SELECT "
+         "RAISE(ABORT, 'stages are kept'); END;";
+  storm::GroupCommitDatabase db{fixture.get_db(),
+                                storm::GroupCommitConfiguration{}};
+
+  auto const id  = fixture.get_uuid_gen()();
+  auto const now = std::time(nullptr);
+  REQUIRE(db.insert(id, storm::StageRequest{storm::make_files(2), now, 0, 0}));
+  CHECK_FALSE(db.erase(id));
+
+  auto stage = db.find(id);
+  REQUIRE(stage.has_value());
+  CHECK_EQ(stage->files.size(), 2);
+}
+
+TEST_SUITE_END;
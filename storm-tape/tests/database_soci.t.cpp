@@ -0,0 +1,406 @@
+// SPDX-FileCopyrightText: 2025 Istituto Nazionale di Fisica Nucleare
+//
+// SPDX-License-Identifier: EUPL-1.2
+
+#include "configuration.hpp"
+#include "database_soci.hpp"
+#include "fixture.t.hpp"
+#include "stage_request.hpp"
+#include "uuid_generator.hpp"
+
+#include <doctest/doctest.h>
+#include <fmt/format.h>
+#include <fmt/ranges.h>
+#include <soci/soci.h>
+#include <soci/sqlite3/soci-sqlite3.h>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <ctime>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// the rows left in the temporary tables of the bulk updates; the fixture must
+// have a single session, which is not leased
+int count_temp_rows(storm::DatabaseFixture& fixture)
+{
+  int n_keys{};
+  int n_states{};
+  auto& sql = fixture.get_pool().at(0);
+  sql << "SELECT count(*) FROM temp.PathKey;", soci::into(n_keys);
+  sql << "SELECT count(*) FROM temp.PathState;", soci::into(n_states);
+  return n_keys + n_states;
+}
+
+storm::File::State state_of(storm::SociDatabase const& db,
+                            storm::StageId const& id,
+                            storm::PhysicalPath const& path)
+{
+  auto const stage = db.find(id);
+  REQUIRE(stage.has_value());
+  auto const it = std::find_if(
+      stage->files.begin(), stage->files.end(),
+      [&](storm::File const& file) { return file.physical_path == path; });
+  REQUIRE_NE(it, stage->files.end());
+  return it->state;
+}
+
+// the details of the plan of a query, run on the only session of the fixture
+std::vector<std::string> query_plan(storm::DatabaseFixture& fixture,
+                                    std::string const& query)
+{
+  std::vector<int> ids(16);
+  std::vector<int> parents(16);
+  std::vector<int> unused(16);
+  std::vector<std::string> details(16);
+  fixture.get_pool().at(0) << "EXPLAIN QUERY PLAN " + query, soci::into(ids),
+      soci::into(parents), soci::into(unused), soci::into(details);
+  return details;
+}
+
+// the plan searches File through the index and never scans it
+void check_uses_index(std::vector<std::string> const& plan,
+                      std::string_view index)
+{
+  CAPTURE(fmt::format("{}", fmt::join(plan, "; ")));
+  CHECK(std::any_of(plan.begin(), plan.end(), [&](std::string const& detail) {
+    return detail.starts_with("SEARCH File")
+        && detail.find(index) != std::string::npos;
+  }));
+  CHECK(std::none_of(plan.begin(), plan.end(), [](std::string const& detail) {
+    return detail.starts_with("SCAN File");
+  }));
+}
+
+} // namespace
+
+TEST_SUITE_BEGIN("SociDatabase");
+
+TEST_CASE("The stage ids are stored in binary form")
+{
+  soci::connection_pool pool{1};
+  storm::open_session(pool.at(0),
+                      storm::DatabaseConfiguration{
+                          .path = ":memory:", .journal_mode = "MEMORY"});
+  storm::SociDatabase db{pool};
+
+  storm::UuidGenerator uuid_gen;
+  auto const id = uuid_gen();
+  storm::Files files{storm::File{storm::LogicalPath{"/atlas/file"},
+                                 storm::PhysicalPath{"/storage/atlas/file"}}};
+  REQUIRE(db.insert(id, {files, std::time(nullptr), 0, 0}));
+
+  std::string type;
+  pool.at(0) << "SELECT typeof(id) || length(id) FROM Stage;",
+      soci::into(type);
+  CHECK_EQ(type, "blob16");
+
+  CHECK(db.find(id).has_value());
+  CHECK_EQ(db.find_incomplete_stages(), std::vector<storm::StageId>{id});
+  CHECK_FALSE(db.find("123-abcd-666").has_value());
+  CHECK_FALSE(db.erase("123-abcd-666"));
+}
+
+TEST_CASE("Only the canonical form of a stage id names the stage")
+{
+  using State = storm::File::State;
+  storm::DatabaseFixture fixture{1};
+  auto& db       = fixture.get_db();
+  auto const now = std::time(nullptr);
+  auto const id  = fixture.get_uuid_gen()();
+  REQUIRE(db.insert(id, {storm::make_files(1), now, 0, 0}));
+  storm::LogicalPath const path{"/atlas/1"};
+
+  auto upper_case = id;
+  std::transform(upper_case.begin(), upper_case.end(), upper_case.begin(),
+                 [](unsigned char c) { return std::toupper(c); });
+  auto no_hyphens = id;
+  std::erase(no_hyphens, '-');
+  // the first hyphen moved one digit earlier
+  auto misplaced_hyphen = id;
+  std::swap(misplaced_hyphen[7], misplaced_hyphen[8]);
+  auto const surrounded = " " + id + " ";
+
+  for (auto const& other :
+       {upper_case, no_hyphens, misplaced_hyphen, surrounded}) {
+    CAPTURE(other);
+    CHECK_FALSE(db.find(other).has_value());
+    CHECK_FALSE(db.update(other, path, State::cancelled, now));
+    CHECK_FALSE(db.update(other, std::span{&path, 1}, State::cancelled, now));
+    db.update(storm::StageUpdate{storm::StageEntity{other, now, now, now},
+                                 {}, now});
+    CHECK_FALSE(db.erase(other));
+    CHECK_FALSE(db.insert(other, {storm::make_files(1), now, 0, 0}));
+  }
+
+  auto const stage = db.find(id);
+  REQUIRE(stage.has_value());
+  CHECK_EQ(stage->completed_at, 0);
+  CHECK_EQ(stage->files[0].state, State::submitted);
+  CHECK_EQ(db.find_incomplete_stages(), std::vector<storm::StageId>{id});
+}
+
+TEST_CASE("A database with text stage ids is converted")
+{
+  storm::UuidGenerator uuid_gen;
+  auto const dir = fs::temp_directory_path() / uuid_gen();
+  fs::create_directory(dir);
+  storm::DatabaseConfiguration const config{.path = dir / "storm-tape.sqlite"};
+  auto const id = uuid_gen();
+
+  {
+    // the schema of the previous versions
+    soci::session sql{soci::sqlite3, config.path.string()};
+    sql << "CREATE TABLE Stage (id TEXT PRIMARY KEY, created_at BIGINT NOT "
+           "NULL, started_at BIGINT NOT NULL, completed_at BIGINT NOT NULL);";
+    sql << "CREATE TABLE File (stage_id TEXT NOT NULL, logical_path TEXT NOT "
+           "NULL, physical_path TEXT NOT NULL, state INTEGER NOT NULL, "
+           "locality INTEGER NOT NULL, started_at BIGINT NOT NULL, "
+           "finished_at BIGINT NOT NULL, PRIMARY KEY (stage_id, logical_path), "
+           "FOREIGN KEY(stage_id) REFERENCES Stage(id));";
+    sql << "CREATE INDEX File_physical_path ON File(physical_path);";
+    sql << "INSERT INTO Stage VALUES (:id, 1, 0, 0);", soci::use(id);
+    sql << "INSERT INTO File VALUES (:id, '/atlas/file', "
+           "'/storage/atlas/file', 0, 0, 0, 0);",
+        soci::use(id);
+  }
+
+  {
+    soci::connection_pool pool{1};
+    storm::open_session(pool.at(0), config);
+    storm::SociDatabase db{pool};
+
+    auto stage = db.find(id);
+    REQUIRE(stage.has_value());
+    CHECK_EQ(stage->created_at, 1);
+    REQUIRE_EQ(stage->files.size(), 1);
+    CHECK_EQ(stage->files[0].physical_path,
+             storm::PhysicalPath{"/storage/atlas/file"});
+    CHECK_EQ(db.count_files(storm::File::State::submitted), 1);
+  }
+
+  fs::remove_all(dir);
+}
+
+TEST_CASE("A session sees the writes committed by the others")
+{
+  storm::DatabaseFixture fixture{2};
+  auto& db = fixture.get_db();
+  // the reads of this thread run on the session it holds, the insert of
+  // another thread on the other one
+  storm::SociDatabase::Lease const lease{db};
+
+  // the reads leave their cached statements ready for the next execution
+  CHECK_EQ(db.count_files(storm::File::State::submitted), 0);
+  CHECK(db.get_files(storm::File::State::submitted, 10).empty());
+
+  // another thread, so another session
+  std::jthread{[&] {
+    CHECK(db.insert(fixture.get_uuid_gen()(),
+                    {storm::make_files(2), std::time(nullptr), 0, 0}));
+  }}.join();
+
+  CHECK_EQ(db.count_files(storm::File::State::submitted), 2);
+  CHECK_EQ(db.get_files(storm::File::State::submitted, 10).size(), 2);
+}
+
+TEST_CASE("More threads than sessions share the pool")
+{
+  storm::DatabaseFixture fixture{2};
+  auto& db = fixture.get_db();
+
+  std::vector<storm::StageId> ids(8);
+  std::generate(ids.begin(), ids.end(), std::ref(fixture.get_uuid_gen()));
+  {
+    std::vector<std::jthread> threads;
+    for (auto const& id : ids) {
+      threads.emplace_back([&] {
+        CHECK(db.insert(id, {storm::make_files(2), std::time(nullptr), 0, 0}));
+        CHECK(db.find(id).has_value());
+      });
+    }
+  }
+  CHECK_EQ(db.find_incomplete_stages().size(), ids.size());
+}
+
+TEST_CASE("An operation fails if no session becomes available in time")
+{
+  storm::DatabaseFixture fixture{1};
+  storm::SociDatabase db{fixture.get_pool(), std::chrono::milliseconds{10}};
+  auto const id = fixture.get_uuid_gen()();
+  REQUIRE(db.insert(id, {storm::make_files(2), std::time(nullptr), 0, 0}));
+
+  // the only session is held by this thread until the transaction ends
+  auto tr = db.transaction();
+  std::jthread{[&] {
+    CHECK_THROWS_AS(db.find(id), soci::soci_error);
+    CHECK_FALSE(db.erase(id));
+  }}.join();
+  CHECK(db.find(id).has_value());
+}
+
+TEST_CASE("A bulk update changes a path in all the stages")
+{
+  using State = storm::File::State;
+  storm::DatabaseFixture fixture{1};
+  auto& db       = fixture.get_db();
+  auto const now = std::time(nullptr);
+  auto const id1 = fixture.get_uuid_gen()();
+  auto const id2 = fixture.get_uuid_gen()();
+  REQUIRE(db.insert(id1, {storm::make_files(4), now, 0, 0}));
+  REQUIRE(db.insert(id2, {storm::make_files(4), now, 0, 0}));
+  storm::PhysicalPath const p1{"/storage/atlas/1"};
+  storm::PhysicalPath const p2{"/storage/atlas/2"};
+  storm::PhysicalPath const p3{"/storage/atlas/3"};
+  storm::PhysicalPath const p4{"/storage/atlas/4"};
+  storm::PhysicalPath const absent{"/storage/atlas/absent"};
+
+  // the same path twice and a path absent from File are allowed
+  std::vector<std::pair<storm::PhysicalPath, State>> path_states{
+      {p1, State::started},
+      {p2, State::completed},
+      {p2, State::completed},
+      {absent, State::failed}};
+  CHECK(db.update(storm::StageUpdate{std::nullopt, path_states, now}));
+  CHECK_EQ(count_temp_rows(fixture), 0);
+
+  storm::PhysicalPaths const paths{p3, p3, absent};
+  CHECK(db.update(paths, State::failed, now));
+  CHECK_EQ(count_temp_rows(fixture), 0);
+
+  // only in the first stage
+  storm::LogicalPaths const logical_paths{storm::LogicalPath{"/atlas/4"},
+                                          storm::LogicalPath{"/atlas/absent"}};
+  CHECK(db.update(id1, logical_paths, State::cancelled, now));
+  CHECK_EQ(count_temp_rows(fixture), 0);
+
+  for (auto const& id : {id1, id2}) {
+    CAPTURE(id);
+    CHECK_EQ(state_of(db, id, p1), State::started);
+    CHECK_EQ(state_of(db, id, p2), State::completed);
+    CHECK_EQ(state_of(db, id, p3), State::failed);
+  }
+  CHECK_EQ(state_of(db, id1, p4), State::cancelled);
+  CHECK_EQ(state_of(db, id2, p4), State::submitted);
+}
+
+TEST_CASE("A bulk update of no paths changes nothing")
+{
+  using State = storm::File::State;
+  storm::DatabaseFixture fixture{1};
+  auto& db       = fixture.get_db();
+  auto const now = std::time(nullptr);
+  auto const id  = fixture.get_uuid_gen()();
+  REQUIRE(db.insert(id, {storm::make_files(2), now, 0, 0}));
+
+  CHECK(db.update(storm::StageUpdate{std::nullopt, {}, now}));
+  CHECK(db.update(std::span<storm::PhysicalPath const>{}, State::started, now));
+  CHECK(db.update(id, std::span<storm::LogicalPath const>{}, State::cancelled,
+                  now));
+  CHECK_EQ(count_temp_rows(fixture), 0);
+  CHECK_EQ(db.count_files(State::submitted), 2);
+}
+
+TEST_CASE("A failed bulk update leaves the temporary tables empty")
+{
+  using State = storm::File::State;
+  storm::DatabaseFixture fixture{1};
+  auto& db       = fixture.get_db();
+  auto const now = std::time(nullptr);
+  auto const id  = fixture.get_uuid_gen()();
+  REQUIRE(db.insert(id, {storm::make_files(2), now, 0, 0}));
+  fixture.get_pool().at(0)
+      << "CREATE TRIGGER no_completion BEFORE UPDATE ON File "
+         "WHEN NEW.state = 4 BEGIN SELECT RAISE(ABORT, 'not completed'); END;";
+  storm::PhysicalPath const p1{"/storage/atlas/1"};
+  storm::PhysicalPath const p2{"/storage/atlas/2"};
+
+  storm::PhysicalPaths const paths{p1, p2};
+  CHECK_FALSE(db.update(paths, State::completed, now));
+  CHECK_EQ(count_temp_rows(fixture), 0);
+
+  storm::LogicalPaths const logical_paths{storm::LogicalPath{"/atlas/1"}};
+  CHECK_FALSE(db.update(id, logical_paths, State::completed, now));
+  CHECK_EQ(count_temp_rows(fixture), 0);
+
+  // the state of the second file would be updated by the first statement
+  std::vector<std::pair<storm::PhysicalPath, State>> path_states{
+      {p1, State::completed}, {p2, State::started}};
+  db.update(storm::StageUpdate{std::nullopt, path_states, now});
+  CHECK_EQ(count_temp_rows(fixture), 0);
+  CHECK_EQ(state_of(db, id, p1), State::submitted);
+  CHECK_EQ(state_of(db, id, p2), State::submitted);
+
+  // the next statement of the same session starts from empty tables
+  CHECK(db.update(std::span{&p1, 1}, State::started, now));
+  CHECK_EQ(count_temp_rows(fixture), 0);
+  CHECK_EQ(state_of(db, id, p1), State::started);
+  CHECK_EQ(state_of(db, id, p2), State::submitted);
+}
+
+// The queries are the ones of SociDatabase, with the parameters replaced by
+// values: submitted is 0 and started is 1
+TEST_CASE("The take-over and the physical path queries use the indexes")
+{
+  storm::DatabaseFixture fixture{1};
+  // create the temporary tables of the session
+  CHECK_EQ(fixture.get_db().count_files(storm::File::State::started), 0);
+
+  // take-over
+  check_uses_index(query_plan(fixture,
+                              "SELECT DISTINCT physical_path FROM File "
+                              "WHERE state = 0 LIMIT 100;"),
+                   "File_state_physical_path");
+
+  // update of a physical path
+  check_uses_index(query_plan(fixture,
+                              "UPDATE File SET state = 1, started_at = 1 "
+                              "WHERE physical_path = '/a' AND state = 0;"),
+                   "physical_path");
+  check_uses_index(query_plan(fixture,
+                              "UPDATE File SET state = 4, finished_at = 1 "
+                              "WHERE physical_path = '/a' AND state IN "
+                              "(0, 1);"),
+                   "physical_path");
+
+  // bulk update of physical paths
+  check_uses_index(query_plan(fixture,
+                              "UPDATE File SET state = 1, started_at = 1 "
+                              "WHERE state = 0 AND physical_path IN "
+                              "(SELECT path FROM temp.PathKey);"),
+                   "File_state_physical_path");
+  check_uses_index(query_plan(fixture,
+                              "UPDATE File SET state = 4, finished_at = 1 "
+                              "WHERE state IN (0, 1) AND physical_path IN "
+                              "(SELECT path FROM temp.PathKey);"),
+                   "physical_path");
+
+  // bulk update of physical paths and states
+  check_uses_index(query_plan(fixture,
+                              "UPDATE File SET state = p.state, started_at = 1 "
+                              "FROM temp.PathState AS p "
+                              "WHERE File.physical_path = p.path "
+                              "AND p.state = 1 AND +File.state = 0;"),
+                   "File_physical_path");
+  check_uses_index(query_plan(fixture,
+                              "UPDATE File SET state = p.state, "
+                              "finished_at = 1 "
+                              "FROM temp.PathState AS p "
+                              "WHERE File.physical_path = p.path "
+                              "AND p.state IN (2, 3, 4) "
+                              "AND +File.state IN (0, 1);"),
+                   "File_physical_path");
+}
+
+TEST_SUITE_END;
@@ -8,9 +8,9 @@
 #include "uuid_generator.hpp"
 
 #include <fmt/std.h>
-#include <soci/sqlite3/soci-sqlite3.h>
 #include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cstddef>
 #include <filesystem>
 #include <string>
@@ -77,7 +77,10 @@ TestFixture::TestFixture()
     , m_config{create_config(m_root, m_access_point)}
     , m_storage{}
     , m_db{[](soci::connection_pool& pool) -> soci::connection_pool& {
-          pool.at(0).open(soci::sqlite3, DB_NAME);
+          // an in-memory database cannot be in WAL mode
+          open_session(pool.at(0),
+                       DatabaseConfiguration{.path         = DB_NAME,
+                                             .journal_mode = "MEMORY"});
           return pool;
         }(m_pool)
       }
@@ -95,6 +98,13 @@ TapeService& TestFixture::get_service()
   return m_service;
 }
 
+// the service refers to the configuration, so a change is seen by the
+// following calls
+Configuration& TestFixture::get_config()
+{
+  return m_config;
+}
+
 SociDatabase const& TestFixture::get_db() const
 {
   return m_db;
@@ -117,4 +127,60 @@ storm::PhysicalPath TestFixture::create_stub_on_disk_at(std::size_t index)
   return create_stub(m_files[index].physical_path);
 }
 
+Files make_files(std::size_t n)
+{
+  Files files;
+  files.reserve(n);
+  for (std::size_t i{n}; i != 0; --i) {
+    auto const name = std::to_string(i);
+    files.push_back(File{LogicalPath{"/atlas/" + name},
+                         PhysicalPath{"/storage/atlas/" + name}});
+  }
+  return files;
+}
+
+DatabaseFixture::DatabaseFixture(std::size_t n_sessions)
+    : m_dir{random_directory_path(m_uuid_gen)}
+    , m_n_sessions{n_sessions}
+    , m_pool{n_sessions}
+{
+  fs::create_directory(m_dir);
+  DatabaseConfiguration const config{.path = m_dir / "storm-tape.sqlite"};
+  for (std::size_t i{0}; i != m_n_sessions; ++i) {
+    open_session(m_pool.at(i), config);
+  }
+  // a test that runs out of sessions fails, instead of hanging
+  m_db.emplace(m_pool, std::chrono::milliseconds{5'000});
+}
+
+// the sessions are closed before their database is removed
+DatabaseFixture::~DatabaseFixture()
+{
+  m_db.reset();
+  for (std::size_t i{0}; i != m_n_sessions; ++i) {
+    m_pool.at(i).close();
+  }
+  fs::remove_all(m_dir);
+}
+
+UuidGenerator& DatabaseFixture::get_uuid_gen()
+{
+  return m_uuid_gen;
+}
+
+fs::path const& DatabaseFixture::get_dir() const
+{
+  return m_dir;
+}
+
+soci::connection_pool& DatabaseFixture::get_pool()
+{
+  return m_pool;
+}
+
+SociDatabase& DatabaseFixture::get_db()
+{
+  return *m_db;
+}
+
 } // namespace storm
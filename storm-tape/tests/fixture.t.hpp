@@ -8,6 +8,8 @@
 #include "storage.hpp"
 #include "tape_service.hpp"
 #include "uuid_generator.hpp"
+#include <filesystem>
+#include <optional>
 
 namespace storm {
 
@@ -34,9 +36,38 @@ class TestFixture
   TestFixture& operator=(TestFixture&&)      = default;
 
   TapeService& get_service();
+  Configuration& get_config();
   SociDatabase const& get_db() const;
   Files const& get_files() const;
   storm::PhysicalPath create_file_on_disk_at(std::size_t index);
   storm::PhysicalPath create_stub_on_disk_at(std::size_t index);
 };
+
+// The files of a stage, named after their index and listed from n down to 1,
+// so that they are not sorted by logical path
+Files make_files(std::size_t n);
+
+// A database on disk, in a temporary directory, with a pool of sessions. The
+// threads using the database lease different sessions, so it cannot be in
+// memory.
+class DatabaseFixture
+{
+  UuidGenerator m_uuid_gen;
+  fs::path m_dir;
+  std::size_t m_n_sessions;
+  soci::connection_pool m_pool;
+  std::optional<SociDatabase> m_db;
+
+ public:
+  explicit DatabaseFixture(std::size_t n_sessions = 1);
+  ~DatabaseFixture();
+  DatabaseFixture(DatabaseFixture const&)            = delete;
+  DatabaseFixture& operator=(DatabaseFixture const&) = delete;
+
+  UuidGenerator& get_uuid_gen();
+  fs::path const& get_dir() const;
+  soci::connection_pool& get_pool();
+  SociDatabase& get_db();
+};
+
 } // namespace storm
@@ -0,0 +1,164 @@
+// SPDX-FileCopyrightText: 2025 Istituto Nazionale di Fisica Nucleare
+//
+// SPDX-License-Identifier: EUPL-1.2
+
+#include "archiveinfo_response.hpp"
+#include "io.hpp"
+#include "status_response.hpp"
+#include <boost/json.hpp>
+#include <boost/program_options.hpp>
+#include <crow.h>
+#include <fmt/core.h>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+namespace po = boost::program_options;
+
+namespace {
+
+using Duration = std::chrono::duration<double, std::milli>;
+
+storm::StatusResponse make_status(std::size_t n_files)
+{
+  storm::Files files;
+  files.reserve(n_files);
+  for (std::size_t i{0}; i != n_files; ++i) {
+    storm::File file{storm::LogicalPath{
+        fmt::format("/atlas/dir{:03}/file{:06}.dat", i % 100, i)}};
+    file.state = i % 2 == 0 ? storm::File::State::completed
+                            : storm::File::State::started;
+    files.push_back(std::move(file));
+  }
+  return storm::StatusResponse{
+      "9b9b7d5e-6f4c-4f1e-8a3e-2a6c7d2f1b0a",
+      storm::StageRequest{std::move(files), std::time(nullptr), 0, 0}};
+}
+
+storm::ArchiveInfoResponse make_archive_info(std::size_t n_files)
+{
+  storm::PathInfos infos;
+  infos.reserve(n_files);
+  for (std::size_t i{0}; i != n_files; ++i) {
+    storm::LogicalPath path{
+        fmt::format("/atlas/dir{:03}/file{:06}.dat", i % 100, i)};
+    if (i % 10 == 0) {
+      infos.push_back({std::move(path), "No such file or directory"});
+    } else {
+      infos.push_back({std::move(path), storm::Locality::tape});
+    }
+  }
+  return storm::ArchiveInfoResponse{std::move(infos)};
+}
+
+// the status as it was serialized through a document, for comparison
+std::string serialize_status_document(storm::StatusResponse const& resp)
+{
+  auto const& stage = resp.stage();
+  boost::json::array files;
+  files.reserve(stage.files.size());
+  for (auto const& file : stage.files) {
+    files.push_back(
+        boost::json::object{{"path", file.logical_path.c_str()},
+                            {"state", storm::to_string(file.state)}});
+  }
+  boost::json::object jbody;
+  jbody["id"]          = resp.id();
+  jbody["createdAt"]   = stage.created_at;
+  jbody["startedAt"]   = stage.started_at;
+  jbody["completedAt"] = stage.completed_at;
+  jbody["files"]       = files;
+  return boost::json::serialize(jbody);
+}
+
+template<typename F>
+Duration benchmark(int n_runs, F f)
+{
+  std::size_t size{0};
+  auto const t0 = std::chrono::steady_clock::now();
+  for (int i{0}; i != n_runs; ++i) {
+    size += f().size();
+  }
+  Duration const t = std::chrono::steady_clock::now() - t0;
+  if (size == 0) {
+    throw std::runtime_error{"empty body"};
+  }
+  return t / n_runs;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  try {
+    std::size_t n_files;
+    int n_runs;
+    po::options_description desc("Allowed options");
+
+    // clang-format off
+    desc.add_options()
+    ("help,h", "produce help message")
+    ("files,n",
+     po::value<std::size_t>(&n_files)->default_value(50'000),
+     "number of files of the responses"
+    )
+    ("runs,r",
+     po::value<int>(&n_runs)->default_value(20),
+     "number of serializations of each response"
+    );
+    // clang-format on
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+
+    if (vm.count("help")) {
+      std::cout << desc << "\n";
+      return EXIT_SUCCESS;
+    }
+    if (n_runs <= 0) {
+      throw std::runtime_error{"the number of runs must be positive"};
+    }
+
+    auto const status = make_status(n_files);
+    auto const info   = make_archive_info(n_files);
+
+    // the bodies must describe the same document
+    if (boost::json::parse(storm::to_crow_response(status).body)
+        != boost::json::parse(serialize_status_document(status))) {
+      throw std::runtime_error{"the status bodies differ"};
+    }
+
+    auto const t_status = benchmark(
+        n_runs, [&] { return storm::to_crow_response(status).body; });
+    auto const t_document =
+        benchmark(n_runs, [&] { return serialize_status_document(status); });
+    auto const t_info =
+        benchmark(n_runs, [&] { return storm::to_crow_response(info).body; });
+
+    std::cout << fmt::format("{} files, average of {} runs\n", n_files,
+                             n_runs);
+    std::cout << fmt::format("{:>24} {:>10.3f} ms\n", "status",
+                             t_status.count());
+    std::cout << fmt::format("{:>24} {:>10.3f} ms\n", "status (document)",
+                             t_document.count());
+    std::cout << fmt::format("{:>24} {:>10.3f} ms\n", "archive info",
+                             t_info.count());
+
+  } catch (std::exception const& e) {
+    std::cerr << fmt::format("Caught exception: {}\n", e.what());
+    return EXIT_FAILURE;
+  } catch (...) {
+    std::cerr << "Caught unknown exception\n";
+    return EXIT_FAILURE;
+  }
+}
+
+void boost::assertion_failed(char const* expr, char const* function,
+                             char const* file, long line)
+{
+  std::cerr << "Failed assertion: '" << expr << "' in '" << function << "' ("
+            << file << ':' << line << ")\n";
+  std::abort();
+}
@@ -3,8 +3,16 @@
 // SPDX-License-Identifier: EUPL-1.2
 
 #include "io.hpp"
+#include "archiveinfo_response.hpp"
+#include "in_progress_response.hpp"
+#include "status_response.hpp"
+#include "takeover_response.hpp"
+#include <crow.h>
 #include <crow/query_string.h>
 #include <doctest/doctest.h>
+#include <filesystem>
+#include <string>
+#include <string_view>
 
 TEST_SUITE_BEGIN("IO");
 
@@ -99,4 +107,129 @@ TEST_CASE("TakeOverRequest accepts 'n_files' between 1 and 1'000'000, included")
   }
 }
 
+TEST_CASE("A path is normalized as by std::filesystem")
+{
+  std::string_view const parts[] = {"a", "bc", "..", ".", "", "...", ".a"};
+  // all the combinations of up to four parts, absolute and relative, with and
+  // without a trailing separator
+  for (int n{0}; n <= 4; ++n) {
+    std::size_t n_combinations{1};
+    for (int i{0}; i != n; ++i) {
+      n_combinations *= std::size(parts);
+    }
+    for (std::size_t c{0}; c != n_combinations; ++c) {
+      for (auto const& prefix : {"", "/"}) {
+        for (auto const& suffix : {"", "/"}) {
+          std::string path{prefix};
+          auto k = c;
+          for (int i{0}; i != n; ++i) {
+            if (i != 0) {
+              path += '/';
+            }
+            path += parts[k % std::size(parts)];
+            k /= std::size(parts);
+          }
+          path += suffix;
+          // std::filesystem keeps a path made only of separators as it is
+          if (path.find_first_not_of('/') == std::string::npos
+              && !path.empty()) {
+            CHECK_EQ(storm::lexically_normal(path), "/");
+            continue;
+          }
+          CHECK_EQ(storm::lexically_normal(path),
+                   std::filesystem::path{path}.lexically_normal().native());
+        }
+      }
+    }
+  }
+}
+
+TEST_CASE("The paths of a request are read from the JSON body")
+{
+  {
+    auto const files = storm::from_json(
+        R"({"files":[{"path":"/atlas//a/./b"},{"diskLifetime":10,
+            "path":"/atlas/c/../d","other":{"path":"/x"}}],
+            "paths":["/ignored"],"extra":[1,{"files":[]}]})",
+        storm::StageRequest::tag);
+    REQUIRE_EQ(files.size(), 2);
+    CHECK_EQ(files[0].logical_path, "/atlas/a/b");
+    CHECK_EQ(files[1].logical_path, "/atlas/d");
+  }
+  {
+    auto const paths =
+        storm::from_json(R"({"files":[{"path":"/a"}],"paths":["/b\/c","/è"]})",
+                         storm::ArchiveInfoRequest::tag);
+    REQUIRE_EQ(paths.size(), 2);
+    CHECK_EQ(paths[0], "/b/c");
+    CHECK_EQ(paths[1], "/\xc3\xa8");
+  }
+  {
+    auto const paths = storm::from_json(R"( {"files":[{"path":"/a/"}]} )",
+                                        storm::CancelRequest::tag);
+    REQUIRE_EQ(paths.size(), 1);
+    CHECK_EQ(paths[0], "/a/");
+  }
+  for (auto const body :
+       {R"({"files":[{"name":"/a"}]})", R"({"files":{"path":"/a"}})",
+        R"({"paths":[["/a"]]})", R"({"paths":[1]})", R"(["/a"])", R"({})",
+        R"({"paths":["/a"]} {})", R"({"paths":["/a"])"}) {
+    CHECK_THROWS_WITH_AS(storm::from_json(body, storm::ReleaseRequest::tag),
+                         "Invalid JSON", storm::BadRequest);
+  }
+}
+
+TEST_CASE("The status and the archive info are written as JSON")
+{
+  {
+    storm::Files files{
+        storm::File{storm::LogicalPath{"/atlas/a\"b"}},
+        storm::File{storm::LogicalPath{"/atlas/c\\d\n\x01"}}};
+    files[1].state = storm::File::State::completed;
+    storm::StatusResponse const status{"an-id",
+                                       storm::StageRequest{files, 10, 11, 0}};
+    auto const resp = storm::to_crow_response(status);
+    CHECK_EQ(resp.code, 200);
+    CHECK_EQ(resp.body,
+             R"({"id":"an-id","createdAt":10,"startedAt":11,"completedAt":0,)"
+             R"("files":[{"path":"/atlas/a\"b","state":"SUBMITTED"},)"
+             R"({"path":"/atlas/c\\d\n\u0001","state":"COMPLETED"}]})");
+    // the same as a serialized document
+    CHECK_EQ(boost::json::serialize(boost::json::parse(resp.body)), resp.body);
+  }
+  {
+    storm::ArchiveInfoResponse const info{
+        {storm::PathInfo{storm::LogicalPath{"/atlas/a"}, storm::Locality::tape},
+         storm::PathInfo{storm::LogicalPath{"/atlas/b"},
+                         std::string{"No such file or directory"}}}};
+    auto const resp = storm::to_crow_response(info);
+    CHECK_EQ(resp.code, 200);
+    CHECK_EQ(resp.body, R"([{"path":"/atlas/a","locality":"TAPE"},)"
+                        R"({"path":"/atlas/b","error":"No such file or )"
+                        "directory\"}]\n");
+  }
+  {
+    auto const resp = storm::to_crow_response(storm::ArchiveInfoResponse{});
+    CHECK_EQ(resp.body, "[]\n");
+  }
+}
+
+TEST_CASE("The take over and in progress bodies have a path per line")
+{
+  storm::PhysicalPaths const paths{"/storage/a", "/storage/b c"};
+  {
+    auto const resp = storm::to_crow_response(storm::TakeOverResponse{paths});
+    CHECK_EQ(resp.body, "unused /storage/a\nunused /storage/b c\n");
+  }
+  {
+    auto const resp =
+        storm::to_crow_response(storm::InProgressResponse{paths});
+    CHECK_EQ(resp.body, "/storage/a\n/storage/b c\n");
+  }
+  {
+    auto const resp = storm::to_crow_response(storm::TakeOverResponse{});
+    CHECK(resp.body.empty());
+  }
+}
+
 TEST_SUITE_END;
@@ -0,0 +1,206 @@
+// SPDX-FileCopyrightText: 2025 Istituto Nazionale di Fisica Nucleare
+//
+// SPDX-License-Identifier: EUPL-1.2
+
+#include "configuration.hpp"
+#include "extended_attributes.hpp"
+#include "io_uring_storage.hpp"
+#include "local_storage.hpp"
+#include "uuid_generator.hpp"
+
+#include <doctest/doctest.h>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+storm::XAttrName const migrated{"user.storm.migrated"};
+storm::XAttrName const tsm_rect{"user.TSMRecT"};
+
+struct StorageFixture
+{
+  storm::UuidGenerator uuid_gen;
+  fs::path dir{fs::temp_directory_path() / uuid_gen()};
+
+  StorageFixture()
+  {
+    fs::create_directory(dir);
+  }
+  ~StorageFixture()
+  {
+    fs::remove_all(dir);
+  }
+
+  storm::PhysicalPath create_file(std::string const& name)
+  {
+    storm::PhysicalPath path{dir / name};
+    std::ofstream{path} << std::string(64 * 1024, 'x');
+    return path;
+  }
+
+  // a sparse file, with no blocks on disk
+  storm::PhysicalPath create_stub(std::string const& name)
+  {
+    storm::PhysicalPath path{dir / name};
+    std::ofstream{path};
+    fs::resize_file(path, 1024 * 1024);
+    return path;
+  }
+
+  // A regular file, a stub, a file being recalled, a migrated file, a missing
+  // path and a directory, repeated n times in different directories
+  storm::PhysicalPaths create_files(int n)
+  {
+    storm::PhysicalPaths paths;
+    for (int d{0}; d != n; ++d) {
+      auto const sub = std::to_string(d);
+      fs::create_directory(dir / sub);
+      paths.push_back(create_file(sub + "/on_disk"));
+      auto const on_tape = create_stub(sub + "/on_tape");
+      storm::set_xattr(on_tape, migrated, storm::XAttrValue{""});
+      paths.push_back(on_tape);
+      auto const in_progress = create_stub(sub + "/in_progress");
+      storm::set_xattr(in_progress, migrated, storm::XAttrValue{""});
+      storm::set_xattr(in_progress, tsm_rect, storm::XAttrValue{""});
+      paths.push_back(in_progress);
+      auto const on_disk_and_tape = create_file(sub + "/on_disk_and_tape");
+      storm::set_xattr(on_disk_and_tape, migrated, storm::XAttrValue{""});
+      paths.push_back(on_disk_and_tape);
+      paths.emplace_back(dir / sub / "missing");
+      paths.emplace_back(dir / sub);
+    }
+    return paths;
+  }
+};
+
+void check_same_probes(storm::Storage& storage,
+                       storm::PhysicalPaths const& paths)
+{
+  storm::LocalStorage local_storage;
+  auto const expected = local_storage.probe(paths);
+  auto const probes   = storage.probe(paths);
+
+  REQUIRE_EQ(probes.size(), expected.size());
+  for (std::size_t i{0}; i != probes.size(); ++i) {
+    CAPTURE(paths[i]);
+    CHECK_EQ(probes[i].type, expected[i].type);
+    CHECK_EQ(probes[i].size, expected[i].size);
+    CHECK_EQ(probes[i].blocks, expected[i].blocks);
+    CHECK_EQ(probes[i].in_progress, expected[i].in_progress);
+    CHECK_EQ(probes[i].migrated, expected[i].migrated);
+    CHECK_EQ(probes[i].error, expected[i].error);
+    CHECK_EQ(probes[i].locality(), expected[i].locality());
+  }
+}
+
+// the recalls are requested on two copies of the same files, since a request
+// changes them
+void check_same_recalls(storm::Storage& storage)
+{
+  StorageFixture expected_fixture;
+  StorageFixture fixture;
+  auto const expected_paths = expected_fixture.create_files(2);
+  auto const paths          = fixture.create_files(2);
+
+  storm::LocalStorage local_storage;
+  auto const expected = local_storage.request_recall(expected_paths);
+  auto const errors   = storage.request_recall(paths);
+
+  REQUIRE_EQ(errors.size(), expected.size());
+  for (std::size_t i{0}; i != errors.size(); ++i) {
+    CAPTURE(paths[i]);
+    CHECK_EQ(errors[i], expected[i]);
+  }
+
+  auto const probes = local_storage.probe(paths);
+  for (std::size_t i{0}; i != probes.size(); ++i) {
+    CAPTURE(paths[i]);
+    CHECK_EQ(probes[i].in_progress, errors[i] == std::error_code{}
+                                        && probes[i].type
+                                               == fs::file_type::regular);
+  }
+}
+
+} // namespace
+
+TEST_SUITE_BEGIN("IoUringStorage");
+
+TEST_CASE("A batch probe through io_uring agrees with LocalStorage")
+{
+  StorageFixture fixture;
+  auto const paths = fixture.create_files(3);
+
+  storm::IoUringStorage storage{storm::IoUringConfiguration{}};
+  if (!storage.uses_io_uring()) {
+    MESSAGE("io_uring is not available, the batches use the syscalls");
+  }
+  check_same_probes(storage, paths);
+}
+
+TEST_CASE("A batch larger than the submission queue is probed in rounds")
+{
+  StorageFixture fixture;
+  auto const paths = fixture.create_files(5);
+
+  // three operations per path, many more than the entries of the queue
+  storm::IoUringStorage storage{storm::IoUringConfiguration{4}};
+  check_same_probes(storage, paths);
+  // the ring is reused by the next batch
+  check_same_probes(storage, paths);
+}
+
+TEST_CASE("Without a ring, a batch probe falls back to the syscalls")
+{
+  StorageFixture fixture;
+  auto const paths = fixture.create_files(3);
+
+  // the kernel does not accept a ring without entries
+  storm::IoUringStorage storage{storm::IoUringConfiguration{0}};
+  CHECK_FALSE(storage.uses_io_uring());
+  check_same_probes(storage, paths);
+}
+
+TEST_CASE("Without a ring, the batches are probed relative to the directories")
+{
+  StorageFixture fixture;
+  fs::create_directory(fixture.dir / "d");
+  auto const path = fixture.create_file("d/file");
+
+  storm::IoUringStorage storage{storm::IoUringConfiguration{0},
+                                storm::DirectoryProbingConfiguration{}};
+  CHECK_FALSE(storage.uses_io_uring());
+  check_same_probes(storage, fixture.create_files(3));
+  auto const before = storage.probe(std::span{&path, 1});
+  REQUIRE_EQ(before[0].type, fs::file_type::regular);
+
+  // a directory moved away is still probed through its open descriptor, as
+  // long as its files are found; a probe of the whole path would find the
+  // file now at the same path
+  fs::rename(fixture.dir / "d", fixture.dir / "moved");
+  fs::create_directory(fixture.dir / "d");
+  fixture.create_stub("d/file");
+  auto const after = storage.probe(std::span{&path, 1});
+  CHECK_EQ(after[0].size, before[0].size);
+  CHECK_EQ(after[0].blocks, before[0].blocks);
+}
+
+TEST_CASE("A recall request through io_uring agrees with LocalStorage")
+{
+  storm::IoUringStorage storage{storm::IoUringConfiguration{4}};
+  check_same_recalls(storage);
+}
+
+TEST_CASE("Without a ring, a recall request falls back to the syscalls")
+{
+  storm::IoUringStorage storage{storm::IoUringConfiguration{0}};
+  CHECK_FALSE(storage.uses_io_uring());
+  check_same_recalls(storage);
+}
+
+TEST_SUITE_END;
@@ -0,0 +1,252 @@
+// SPDX-FileCopyrightText: 2025 Istituto Nazionale di Fisica Nucleare
+//
+// SPDX-License-Identifier: EUPL-1.2
+
+#include "configuration.hpp"
+#include "directory_cache.hpp"
+#include "extended_attributes.hpp"
+#include "local_storage.hpp"
+#include "uuid_generator.hpp"
+
+#include <doctest/doctest.h>
+#include <fmt/core.h>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <string>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct StorageFixture
+{
+  storm::UuidGenerator uuid_gen;
+  fs::path dir{fs::temp_directory_path() / uuid_gen()};
+  storm::LocalStorage storage;
+
+  StorageFixture()
+  {
+    fs::create_directory(dir);
+  }
+  ~StorageFixture()
+  {
+    fs::remove_all(dir);
+  }
+
+  storm::PhysicalPath create_file(std::string const& name)
+  {
+    storm::PhysicalPath path{dir / name};
+    std::ofstream{path} << std::string(64 * 1024, 'x');
+    return path;
+  }
+
+  // a sparse file, with no blocks on disk
+  storm::PhysicalPath create_stub(std::string const& name)
+  {
+    storm::PhysicalPath path{dir / name};
+    std::ofstream{path};
+    fs::resize_file(path, 1024 * 1024);
+    return path;
+  }
+};
+
+} // namespace
+
+TEST_SUITE_BEGIN("LocalStorage");
+
+TEST_CASE("A batch probe agrees with the calls per path")
+{
+  StorageFixture fixture;
+  storm::XAttrName const migrated{"user.storm.migrated"};
+  storm::XAttrName const tsm_rect{"user.TSMRecT"};
+
+  auto const on_disk = fixture.create_file("on_disk");
+  auto const on_disk_and_tape = fixture.create_file("on_disk_and_tape");
+  storm::set_xattr(on_disk_and_tape, migrated, storm::XAttrValue{""});
+  auto const on_tape = fixture.create_stub("on_tape");
+  storm::set_xattr(on_tape, migrated, storm::XAttrValue{""});
+  auto const in_progress = fixture.create_stub("in_progress");
+  storm::set_xattr(in_progress, migrated, storm::XAttrValue{""});
+  storm::set_xattr(in_progress, tsm_rect, storm::XAttrValue{""});
+  storm::PhysicalPath const missing{fixture.dir / "missing"};
+  storm::PhysicalPath const directory{fixture.dir};
+
+  storm::PhysicalPaths const paths{on_disk, on_disk_and_tape, on_tape,
+                                   in_progress, missing, directory};
+  auto const probes = fixture.storage.probe(paths);
+  REQUIRE_EQ(probes.size(), paths.size());
+
+  for (std::size_t i{0}; i != 4; ++i) {
+    auto const& probe = probes[i];
+    CHECK(probe);
+    CHECK_EQ(probe.type, fs::file_type::regular);
+    auto size_info = fixture.storage.file_size_info(paths[i]);
+    CHECK_EQ(probe.size, size_info->size);
+    CHECK_EQ(probe.is_stub(), size_info->is_stub);
+    CHECK_EQ(probe.in_progress, *fixture.storage.is_in_progress(paths[i]));
+    CHECK_EQ(probe.migrated, *fixture.storage.is_on_tape(paths[i]));
+  }
+
+  CHECK_EQ(probes[0].locality(), storm::Locality::disk);
+  CHECK_EQ(probes[1].locality(), storm::Locality::disk_and_tape);
+  CHECK_EQ(probes[2].locality(), storm::Locality::tape);
+  CHECK_EQ(probes[3].locality(), storm::Locality::tape);
+  CHECK(probes[3].in_progress);
+
+  CHECK_FALSE(probes[4]);
+  CHECK_EQ(probes[4].type, fs::file_type::not_found);
+  CHECK_EQ(probes[4].locality(), storm::Locality::unavailable);
+
+  CHECK(probes[5]);
+  CHECK_EQ(probes[5].type, fs::file_type::directory);
+}
+
+TEST_CASE("A file with many xattrs is probed correctly")
+{
+  StorageFixture fixture;
+
+  auto const path = fixture.create_file("many_xattrs");
+  // more names than fit in the buffer of a single listxattr
+  for (int i{0}; i != 100; ++i) {
+    storm::XAttrName const name{"user.some.long.name." + std::to_string(i)};
+    storm::set_xattr(path, name, storm::XAttrValue{""});
+  }
+  storm::set_xattr(path, storm::XAttrName{"user.TSMRecT"},
+                   storm::XAttrValue{""});
+
+  auto const probes = fixture.storage.probe(std::span{&path, 1});
+  REQUIRE_EQ(probes.size(), 1);
+  CHECK(probes[0]);
+  CHECK(probes[0].in_progress);
+  CHECK_FALSE(probes[0].migrated);
+}
+
+TEST_CASE("Probing relative to the directories gives the same results")
+{
+  StorageFixture fixture;
+  storm::XAttrName const migrated{"user.storm.migrated"};
+  storm::XAttrName const tsm_rect{"user.TSMRecT"};
+
+  // the files of a few directories, interleaved
+  storm::PhysicalPaths paths;
+  for (int d{0}; d != 3; ++d) {
+    fs::create_directory(fixture.dir / std::to_string(d));
+  }
+  for (int i{0}; i != 30; ++i) {
+    auto const name = fmt::format("{}/{}", i % 3, i);
+    auto const path =
+        i % 2 == 0 ? fixture.create_file(name) : fixture.create_stub(name);
+    storm::set_xattr(path, migrated, storm::XAttrValue{""});
+    if (i % 5 == 0) {
+      storm::set_xattr(path, tsm_rect, storm::XAttrValue{""});
+    }
+    paths.push_back(path);
+  }
+  paths.emplace_back(fixture.dir / "0" / "missing");
+  paths.emplace_back(fixture.dir / "missing" / "missing");
+  paths.emplace_back(fixture.dir / "0" / "0" / "not_a_directory");
+  paths.emplace_back(fixture.dir / "1");
+  paths.emplace_back(fixture.dir / "1" / "");
+  paths.emplace_back("/");
+
+  auto const expected = fixture.storage.probe(paths);
+
+  // a single directory kept open, to exercise the evictions
+  storm::LocalStorage storage{storm::DirectoryProbingConfiguration{1}};
+  auto const probes = storage.probe(paths);
+
+  REQUIRE_EQ(probes.size(), expected.size());
+  for (std::size_t i{0}; i != probes.size(); ++i) {
+    CAPTURE(paths[i]);
+    CHECK_EQ(probes[i].type, expected[i].type);
+    CHECK_EQ(probes[i].size, expected[i].size);
+    CHECK_EQ(probes[i].blocks, expected[i].blocks);
+    CHECK_EQ(probes[i].in_progress, expected[i].in_progress);
+    CHECK_EQ(probes[i].migrated, expected[i].migrated);
+    CHECK_EQ(probes[i].error, expected[i].error);
+  }
+}
+
+TEST_CASE("The directory cache keeps the most recently used directories")
+{
+  StorageFixture fixture;
+  for (int d{0}; d != 3; ++d) {
+    fs::create_directory(fixture.dir / std::to_string(d));
+  }
+  auto const dir = [&](int d) {
+    return (fixture.dir / std::to_string(d)).string();
+  };
+
+  storm::DirectoryCache cache{2};
+  auto const d0 = cache.open(dir(0));
+  REQUIRE(d0.has_value());
+  CHECK_EQ(cache.open(dir(0)).value(), *d0);
+  REQUIRE(cache.open(dir(1)).has_value());
+  CHECK_EQ(cache.size(), 2);
+
+  // 0 is more recent than 1, so 1 is evicted
+  CHECK_EQ(cache.open(dir(0)).value(), *d0);
+  REQUIRE(cache.open(dir(2)).has_value());
+  CHECK_EQ(cache.size(), 2);
+  CHECK_EQ(cache.open(dir(0)).value(), *d0);
+
+  // an evicted directory stays open while used
+  CHECK_GE((*d0)->fd(), 0);
+
+  auto const missing = cache.open((fixture.dir / "missing").string());
+  REQUIRE(missing.has_error());
+  CHECK_EQ(missing.error(),
+           std::make_error_code(std::errc::no_such_file_or_directory));
+  CHECK_EQ(cache.size(), 2);
+}
+
+TEST_CASE("A directory created again is not probed through the old one")
+{
+  StorageFixture fixture;
+  fs::create_directory(fixture.dir / "d");
+  auto const path = fixture.create_file("d/file");
+
+  storm::LocalStorage storage{storm::DirectoryProbingConfiguration{}};
+  auto const before = storage.probe(std::span{&path, 1});
+  CHECK_EQ(before[0].type, fs::file_type::regular);
+
+  // the old directory is still cached
+  fs::remove_all(fixture.dir / "d");
+  fs::create_directory(fixture.dir / "d");
+  fixture.create_file("d/file");
+
+  auto const after = storage.probe(std::span{&path, 1});
+  CHECK_EQ(after[0].type, fs::file_type::regular);
+  CHECK_FALSE(after[0].error);
+
+  fs::remove_all(fixture.dir / "d");
+  auto const removed = storage.probe(std::span{&path, 1});
+  CHECK_EQ(removed[0].type, fs::file_type::not_found);
+}
+
+TEST_CASE("The directory cache replaces a directory created again")
+{
+  StorageFixture fixture;
+  auto const dir = (fixture.dir / "d").string();
+  fs::create_directory(dir);
+
+  storm::DirectoryCache cache{2};
+  auto const d0 = cache.open(dir);
+  REQUIRE(d0.has_value());
+  CHECK_EQ(cache.revalidate(dir, *d0).value(), *d0);
+
+  fs::remove(dir);
+  fs::create_directory(dir);
+  auto const d1 = cache.revalidate(dir, *d0);
+  REQUIRE(d1.has_value());
+  CHECK_NE(*d1, *d0);
+  CHECK_EQ(cache.open(dir).value(), *d1);
+  CHECK_EQ(cache.size(), 1);
+
+  fs::remove(dir);
+  CHECK(cache.revalidate(dir, *d1).has_error());
+  CHECK_EQ(cache.size(), 0);
+}
+
+TEST_SUITE_END;
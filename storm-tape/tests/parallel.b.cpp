@@ -1,10 +1,12 @@
 #include "configuration.hpp"
 #include "errors.hpp"
 #include "local_storage.hpp"
+#include "parallelism.hpp"
 #include "tape_service_utils.hpp"
 #include <boost/program_options.hpp>
 #include <fmt/core.h>
 #include <file.hpp>
+#include <optional>
 #include <type_traits> // Necessario per std::is_void_v
 
 namespace po = boost::program_options;
@@ -77,31 +79,47 @@ int main(int argc, char* argv[])
     std::cerr << "Read " << paths.size() << " files\n";
 
     storm::LocalStorage storage{};
-    std::vector<std::pair<storm::PhysicalPath, storm::File::State>> files_to_update;
+    storm::FileUpdates files_to_update;
+    // the same pool and arenas as the service, default if not configured
+    std::optional<storm::ParallelExecution> execution;
+    if (parallel) {
+      execution.emplace(
+          config.parallelism.value_or(storm::ParallelismConfiguration{}));
+    }
+    auto parallelism = [&](storm::ParallelExecution::Operation op) {
+      return execution.has_value()
+               ? std::optional<storm::Parallelism>{(*execution)(op)}
+               : std::nullopt;
+    };
+    using Operation = storm::ParallelExecution::Operation;
 
     //parallel = false;
     std::cout << "Parallel mode: " << (parallel ? "enabled" : "disabled") << "\n";
 
+    storm::StorageAreaResolver const resolve{config.storage_areas};
+
     // --- BENCHMARK 1 ---
     auto [r1, t1] = benchmark([&] {
-      return storm::extend_paths_with_localities(std::move(paths), storage,
-                                                 parallel);
+      return storm::extend_paths_with_localities(
+          std::move(paths), storage, parallelism(Operation::take_over));
     });
 
     // --- BENCHMARK 2 ---
     auto [r2, t2] = benchmark([&] {
-      storm::stage_path_resolver(files, config.storage_areas,
-                                                 parallel);
+      storm::stage_path_resolver(files, resolve, storage,
+                                 parallelism(Operation::stage));
     });
 
     // --- BENCHMARK 3 ---
     auto [r3, t3] = benchmark([&] {
-      storm::status_loop(files, storage, std::time(nullptr), files_to_update, parallel);
+      storm::status_loop(files, storage, std::time(nullptr), files_to_update,
+                         parallelism(Operation::status));
     });
 
     // --- BENCHMARK 4 ---
     auto [r4, t4] = benchmark([&] {
-      storm::archive_info_loop(logical_paths,config.storage_areas, storage, parallel);
+      storm::archive_info_loop(logical_paths, resolve, storage,
+                               parallelism(Operation::archive_info));
     });
 
     std::cout << r1.size() << " files in " << t1.count() << "ms (extend_paths_with_localities)\n";
@@ -0,0 +1,205 @@
+// SPDX-FileCopyrightText: 2025 Istituto Nazionale di Fisica Nucleare
+//
+// SPDX-License-Identifier: EUPL-1.2
+
+#include "cancel_response.hpp"
+#include "configuration.hpp"
+#include "delete_response.hpp"
+#include "extended_attributes.hpp"
+#include "fixture.t.hpp"
+#include "local_storage.hpp"
+#include "recall_watcher.hpp"
+#include "requests_with_paths.hpp"
+#include "stage_request.hpp"
+#include "stage_response.hpp"
+#include "status_response.hpp"
+#include "tape_service.hpp"
+#include "uuid_generator.hpp"
+
+#include <doctest/doctest.h>
+#include <chrono>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+template<typename Pred>
+bool wait_for(Pred pred)
+{
+  using namespace std::chrono_literals;
+  for (int i{0}; i != 500; ++i) {
+    if (pred()) {
+      return true;
+    }
+    std::this_thread::sleep_for(10ms);
+  }
+  return false;
+}
+
+// a sparse file with a recall in progress
+storm::PhysicalPath create_recalled_stub(storm::PhysicalPath const& path)
+{
+  std::ofstream{path};
+  fs::resize_file(path, 1024 * 1024);
+  storm::set_xattr(path, storm::XAttrName{"user.storm.migrated"},
+                   storm::XAttrValue{""});
+  storm::set_xattr(path, storm::XAttrName{"user.TSMRecT"},
+                   storm::XAttrValue{""});
+  return path;
+}
+
+} // namespace
+
+TEST_SUITE_BEGIN("RecallWatcher");
+
+TEST_CASE("The end of a recall is detected from the change of the xattrs")
+{
+  storm::DatabaseFixture fixture{2};
+  auto& db = fixture.get_db();
+  storm::LocalStorage storage;
+  storm::XAttrName const tsm_rect{"user.TSMRecT"};
+
+  storm::PhysicalPath const path{fixture.get_dir() / "file"};
+  std::ofstream{path} << "some data";
+  storm::set_xattr(path, tsm_rect, storm::XAttrValue{""});
+
+  auto const id  = fixture.get_uuid_gen()();
+  auto const now = std::time(nullptr);
+  storm::Files files{storm::File{storm::LogicalPath{"/atlas/file"}, path,
+                                 storm::File::State::started,
+                                 storm::Locality::unavailable, now, 0}};
+  REQUIRE(db.insert(id, {files, now, now, 0}));
+
+  storm::RecallWatcher watcher{db, storage, storm::RecallWatcherConfiguration{}};
+  // the started files are loaded by the thread of the watcher
+  REQUIRE(wait_for([&] { return watcher.size() == 1; }));
+
+  storm::remove_xattr(path, tsm_rect);
+  CHECK(wait_for([&] {
+    auto stage = db.find(id);
+    return stage->files[0].state == storm::File::State::completed;
+  }));
+  CHECK(wait_for([&] { return watcher.size() == 0; }));
+}
+
+TEST_CASE("The watched directories are bounded and reference counted")
+{
+  storm::DatabaseFixture fixture{2};
+  auto& db = fixture.get_db();
+  storm::LocalStorage storage;
+  auto const& dir = fixture.get_dir();
+  fs::create_directory(dir / "a");
+  fs::create_directory(dir / "b");
+
+  storm::RecallWatcher watcher{db, storage,
+                               storm::RecallWatcherConfiguration{1}};
+  storm::PhysicalPaths const paths{storm::PhysicalPath{dir / "a/1"},
+                                   storm::PhysicalPath{dir / "a/2"},
+                                   storm::PhysicalPath{dir / "b/1"}};
+  watcher.watch(paths);
+  CHECK_EQ(watcher.size(), 2);
+
+  watcher.unwatch(std::span{paths.data(), 2});
+  CHECK_EQ(watcher.size(), 0);
+
+  // the directory of the first files is not watched anymore
+  watcher.watch(std::span{paths.data() + 2, 1});
+  CHECK_EQ(watcher.size(), 1);
+}
+
+TEST_CASE("A file is watched as long as a stage waits for it")
+{
+  storm::DatabaseFixture fixture{2};
+  auto& db = fixture.get_db();
+  storm::LocalStorage storage;
+  auto const& dir = fixture.get_dir();
+
+  storm::RecallWatcher watcher{
+      db, storage,
+      storm::RecallWatcherConfiguration{.max_directories = 8, .max_files = 2}};
+  storm::PhysicalPaths const paths{storm::PhysicalPath{dir / "1"},
+                                   storm::PhysicalPath{dir / "2"},
+                                   storm::PhysicalPath{dir / "3"}};
+  auto const first = std::span{paths.data(), 1};
+
+  // two stages wait for the same file
+  watcher.watch(first);
+  watcher.watch(first);
+  CHECK_EQ(watcher.size(), 1);
+  watcher.unwatch(first);
+  CHECK_EQ(watcher.size(), 1);
+  watcher.unwatch(first);
+  CHECK_EQ(watcher.size(), 0);
+  // a file not watched anymore is not released again
+  watcher.unwatch(first);
+  CHECK_EQ(watcher.size(), 0);
+
+  // the number of files is bounded, not only the number of directories
+  watcher.watch(paths);
+  CHECK_EQ(watcher.size(), 2);
+  // but a stage can wait for a file already watched
+  watcher.watch(first);
+  watcher.unwatch(first);
+  CHECK_EQ(watcher.size(), 2);
+
+  // the end of a recall is for all the stages
+  watcher.watch(first);
+  watcher.forget(first);
+  CHECK_EQ(watcher.size(), 1);
+  watcher.watch(std::span{paths.data() + 2, 1});
+  CHECK_EQ(watcher.size(), 2);
+}
+
+TEST_CASE("A cancelled or deleted stage stops waiting for its recalls")
+{
+  storm::DatabaseFixture fixture{2};
+  auto& db = fixture.get_db();
+  storm::LocalStorage storage;
+  auto const root = fixture.get_dir() / "sa";
+  fs::create_directory(root);
+  storm::Configuration config;
+  config.storage_areas.push_back(
+      storm::StorageArea{"sa", storm::PhysicalPath{root},
+                         storm::LogicalPaths{storm::LogicalPath{"/atlas"}}});
+
+  // a stage started before the watcher, to know when the watcher has loaded
+  // the started files and does not count them again
+  auto const now = std::time(nullptr);
+  storm::Files const started{storm::File{
+      storm::LogicalPath{"/atlas/0"},
+      create_recalled_stub(storm::PhysicalPath{root / "0"}),
+      storm::File::State::started, storm::Locality::unavailable, now, 0}};
+  REQUIRE(db.insert(fixture.get_uuid_gen()(), {started, now, now, 0}));
+
+  storm::RecallWatcher watcher{db, storage, storm::RecallWatcherConfiguration{}};
+  REQUIRE(wait_for([&] { return watcher.size() == 1; }));
+  storm::TapeService service{config, db, storage, &watcher};
+
+  storm::Files const files{
+      storm::File{storm::LogicalPath{"/atlas/1"},
+                  create_recalled_stub(storm::PhysicalPath{root / "1"})},
+      storm::File{storm::LogicalPath{"/atlas/2"},
+                  create_recalled_stub(storm::PhysicalPath{root / "2"})}};
+  auto const id1 = service.stage({files, now, 0, 0}).id();
+  auto const id2 = service.stage({{files[0]}, now, 0, 0}).id();
+  // the status of the first stage finds the recalls in progress and starts the
+  // shared file also in the second stage
+  service.status(id1);
+  service.status(id2);
+  CHECK_EQ(watcher.size(), 3);
+
+  // the second stage still waits for the first file
+  service.cancel(id1, storm::CancelRequest{{{files[0].logical_path}}});
+  CHECK_EQ(watcher.size(), 3);
+  service.erase(id1);
+  CHECK_EQ(watcher.size(), 2);
+  service.erase(id2);
+  CHECK_EQ(watcher.size(), 1);
+}
+
+TEST_SUITE_END;
@@ -0,0 +1,52 @@
+// SPDX-FileCopyrightText: 2025 Istituto Nazionale di Fisica Nucleare
+//
+// SPDX-License-Identifier: EUPL-1.2
+
+#include "fixture.t.hpp"
+#include "reconciler.hpp"
+#include "stage_request.hpp"
+#include "stage_response.hpp"
+#include "status_response.hpp"
+
+#include <doctest/doctest.h>
+#include <ctime>
+
+TEST_SUITE_BEGIN("Reconciler");
+
+TEST_CASE("With a reconciler the status does not probe the storage")
+{
+  auto fixture  = storm::TestFixture();
+  auto& service = fixture.get_service();
+  auto& config  = fixture.get_config();
+  // no threads, the test drives the reconciliation
+  config.reconciler = storm::ReconcilerConfiguration{.threads = 0};
+  storm::Reconciler reconciler{service, fixture.get_db(), *config.reconciler};
+
+  auto const& files = fixture.get_files();
+  fixture.create_file_on_disk_at(0);
+  fixture.create_file_on_disk_at(1);
+  storm::StageRequest request{files, std::time(nullptr), 0, 0};
+  auto const id = service.stage(std::move(request)).id();
+
+  {
+    auto status = service.status(id);
+    auto& stage = status.stage();
+    CHECK(stage.files[0].state == storm::File::State::submitted);
+    CHECK(stage.files[1].state == storm::File::State::submitted);
+    CHECK_EQ(stage.completed_at, 0);
+  }
+
+  CHECK_EQ(reconciler.reconcile(), 1);
+  {
+    auto status = service.status(id);
+    auto& stage = status.stage();
+    CHECK(stage.files[0].state == storm::File::State::completed);
+    CHECK(stage.files[1].state == storm::File::State::completed);
+    CHECK_NE(stage.completed_at, 0);
+  }
+
+  // a completed stage is not visited anymore
+  CHECK_EQ(reconciler.reconcile(), 0);
+}
+
+TEST_SUITE_END;
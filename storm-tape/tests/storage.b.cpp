@@ -0,0 +1,172 @@
+// SPDX-FileCopyrightText: 2025 Istituto Nazionale di Fisica Nucleare
+//
+// SPDX-License-Identifier: EUPL-1.2
+
+#include "configuration.hpp"
+#include "extended_attributes.hpp"
+#include "io_uring_storage.hpp"
+#include "local_storage.hpp"
+#include <boost/program_options.hpp>
+#include <fmt/core.h>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <span>
+#include <string>
+
+namespace po = boost::program_options;
+namespace fs = std::filesystem;
+
+namespace {
+
+using Duration = std::chrono::duration<double, std::milli>;
+
+auto constexpr default_root = "/dev/shm/storm-tape-storage.b";
+
+// A tree of n_files files, 1'000 per directory, resembling a tape buffer: most
+// files are stubs, with no blocks on disk, so that the tree fits in memory.
+// Every file is migrated, one in three is being recalled.
+storm::PhysicalPaths create_tree(fs::path const& root, std::size_t n_files)
+{
+  storm::XAttrName const migrated{"user.storm.migrated"};
+  storm::XAttrName const tsm_rect{"user.TSMRecT"};
+  storm::XAttrValue const empty{""};
+
+  auto const exists = fs::exists(root);
+  storm::PhysicalPaths paths;
+  paths.reserve(n_files);
+  for (std::size_t i{0}; i != n_files; ++i) {
+    auto const dir = root / fmt::format("dir{:04}", i / 1'000);
+    storm::PhysicalPath const path{dir / fmt::format("file{:07}.dat", i)};
+    if (!exists) {
+      if (i % 1'000 == 0) {
+        fs::create_directories(dir);
+      }
+      std::ofstream file{path};
+      if (!file) {
+        throw std::runtime_error{
+            fmt::format("cannot create {}", path.string())};
+      }
+      if (i % 100 == 0) {
+        file << "on disk";
+      } else {
+        file.close();
+        fs::resize_file(path, 1024 * 1024);
+      }
+      storm::set_xattr(path, migrated, empty);
+      if (i % 3 == 0) {
+        storm::set_xattr(path, tsm_rect, empty);
+      }
+    }
+    paths.push_back(path);
+  }
+  return paths;
+}
+
+// probe all the paths, in batches of batch_size, one after the other
+Duration benchmark_probe(storm::Storage& storage,
+                         storm::PhysicalPaths const& paths,
+                         std::size_t batch_size, std::size_t& n_in_progress)
+{
+  n_in_progress = 0;
+  std::span<storm::PhysicalPath const> const all{paths};
+  auto const t0 = std::chrono::steady_clock::now();
+  for (std::size_t first{0}; first < all.size(); first += batch_size) {
+    auto const n      = std::min(batch_size, all.size() - first);
+    auto const probes = storage.probe(all.subspan(first, n));
+    for (auto const& probe : probes) {
+      n_in_progress += probe.in_progress ? 1 : 0;
+    }
+  }
+  return std::chrono::steady_clock::now() - t0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  try {
+    std::string root;
+    std::size_t n_files;
+    std::size_t batch_size;
+    unsigned queue_depth;
+    po::options_description desc("Allowed options");
+
+    // clang-format off
+    desc.add_options()
+    ("help,h", "produce help message")
+    ("root,r",
+     po::value<std::string>(&root)->default_value(default_root),
+     "directory of the tree of files, preferably on tmpfs, created if missing"
+    )
+    ("files,n",
+     po::value<std::size_t>(&n_files)->default_value(1'000'000),
+     "number of files of the tree"
+    )
+    ("batch,b",
+     po::value<std::size_t>(&batch_size)->default_value(1'000),
+     "number of files probed at a time"
+    )
+    ("queue-depth,q",
+     po::value<unsigned>(&queue_depth)->default_value(256),
+     "entries of the io_uring submission queue"
+    );
+    // clang-format on
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+
+    if (vm.count("help")) {
+      std::cout << desc << "\n";
+      return EXIT_SUCCESS;
+    }
+    if (batch_size == 0) {
+      throw std::runtime_error{"the batch size cannot be zero"};
+    }
+
+    auto const paths = create_tree(root, n_files);
+    std::cerr << fmt::format("Tree of {} files in {}\n", paths.size(), root);
+
+    storm::LocalStorage local_storage;
+    storm::LocalStorage directory_storage{
+        storm::DirectoryProbingConfiguration{}};
+    storm::IoUringStorage io_uring_storage{
+        storm::IoUringConfiguration{queue_depth}};
+    if (!io_uring_storage.uses_io_uring()) {
+      std::cerr << "io_uring is not available, both storages use syscalls\n";
+    }
+
+    std::cout << fmt::format("{:>10} {:>12} {:>12} {:>12}\n", "storage",
+                             "total (ms)", "file (us)", "in progress");
+    for (auto const& [name, storage] :
+         {std::pair<char const*, storm::Storage*>{"local", &local_storage},
+          {"directory", &directory_storage},
+          {"io_uring", &io_uring_storage}}) {
+      std::size_t n_in_progress{0};
+      auto const t =
+          benchmark_probe(*storage, paths, batch_size, n_in_progress);
+      std::cout << fmt::format(
+          "{:>10} {:>12.1f} {:>12.3f} {:>12}\n", name, t.count(),
+          t.count() * 1'000. / static_cast<double>(paths.size()),
+          n_in_progress);
+    }
+
+  } catch (std::exception const& e) {
+    std::cerr << fmt::format("Caught exception: {}\n", e.what());
+    return EXIT_FAILURE;
+  } catch (...) {
+    std::cerr << "Caught unknown exception\n";
+    return EXIT_FAILURE;
+  }
+}
+
+void boost::assertion_failed(char const* expr, char const* function,
+                             char const* file, long line)
+{
+  std::cerr << "Failed assertion: '" << expr << "' in '" << function << "' ("
+            << file << ':' << line << ")\n";
+  std::abort();
+}
@@ -0,0 +1,125 @@
+// SPDX-FileCopyrightText: 2025 Istituto Nazionale di Fisica Nucleare
+//
+// SPDX-License-Identifier: EUPL-1.2
+
+#include "configuration.hpp"
+#include "storage_area_resolver.hpp"
+#include <boost/program_options.hpp>
+#include <fmt/core.h>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+
+namespace po = boost::program_options;
+
+namespace {
+
+using Duration = std::chrono::duration<double, std::milli>;
+
+// n storage areas, one in five with a second access point nested in the
+// first, as for the scratch area of an experiment
+storm::StorageAreas make_storage_areas(std::size_t n)
+{
+  storm::StorageAreas sas;
+  sas.reserve(n);
+  for (std::size_t i{0}; i != n; ++i) {
+    auto const name = fmt::format("vo{:02}", i);
+    storm::LogicalPaths aps{storm::LogicalPath{"/" + name}};
+    if (i % 5 == 0) {
+      aps.emplace_back("/" + name + "/scratch");
+    }
+    sas.push_back(storm::StorageArea{
+        name, storm::PhysicalPath{"/storage/" + name}, std::move(aps)});
+  }
+  return sas;
+}
+
+// logical paths spread over the storage areas, some of them not belonging to
+// any
+storm::LogicalPaths make_paths(std::size_t n_sas, std::size_t n)
+{
+  std::mt19937 gen{42};
+  std::uniform_int_distribution<std::size_t> sa{0, n_sas};
+  storm::LogicalPaths paths;
+  paths.reserve(n);
+  for (std::size_t i{0}; i != n; ++i) {
+    auto const s = sa(gen);
+    auto const dir = s % 5 == 0 && i % 2 == 0 ? "scratch/data" : "data/run";
+    paths.emplace_back(
+        fmt::format("/vo{:02}/{}/{:03}/file{:07}.dat", s, dir, i % 1'000, i));
+  }
+  return paths;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  try {
+    std::size_t n_sas;
+    std::size_t n_lookups;
+    po::options_description desc("Allowed options");
+
+    // clang-format off
+    desc.add_options()
+    ("help,h", "produce help message")
+    ("storage-areas,s",
+     po::value<std::size_t>(&n_sas)->default_value(50),
+     "number of storage areas"
+    )
+    ("lookups,n",
+     po::value<std::size_t>(&n_lookups)->default_value(1'000'000),
+     "number of paths to resolve"
+    );
+    // clang-format on
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+
+    if (vm.count("help")) {
+      std::cout << desc << "\n";
+      return EXIT_SUCCESS;
+    }
+    if (n_sas == 0) {
+      throw std::runtime_error{"at least a storage area is needed"};
+    }
+
+    auto const sas   = make_storage_areas(n_sas);
+    auto const paths = make_paths(n_sas, n_lookups);
+
+    auto const t0 = std::chrono::steady_clock::now();
+    storm::StorageAreaResolver const resolve{sas};
+    auto const t1 = std::chrono::steady_clock::now();
+    std::size_t n_resolved{0};
+    for (auto const& path : paths) {
+      n_resolved += resolve(path).empty() ? 0 : 1;
+    }
+    Duration const t = std::chrono::steady_clock::now() - t1;
+
+    std::cout << fmt::format(
+        "{} storage areas compiled in {:.3f} ms\n", n_sas,
+        Duration{t1 - t0}.count());
+    std::cout << fmt::format(
+        "{} paths ({} resolved) in {:.1f} ms, {:.3f} us per path\n",
+        paths.size(), n_resolved, t.count(),
+        t.count() * 1'000. / static_cast<double>(paths.size()));
+
+  } catch (std::exception const& e) {
+    std::cerr << fmt::format("Caught exception: {}\n", e.what());
+    return EXIT_FAILURE;
+  } catch (...) {
+    std::cerr << "Caught unknown exception\n";
+    return EXIT_FAILURE;
+  }
+}
+
+void boost::assertion_failed(char const* expr, char const* function,
+                             char const* file, long line)
+{
+  std::cerr << "Failed assertion: '" << expr << "' in '" << function << "' ("
+            << file << ':' << line << ")\n";
+  std::abort();
+}
@@ -22,6 +22,8 @@ TEST_CASE("An invalid path is resolved to an empty path")
   CHECK(resolve("/atlassss/file")         == "");
   CHECK(resolve("/cms/../atlas/file")     == "");
   CHECK(resolve("cms/file")               == "");
+  CHECK(resolve("/cms/./file")            == "");
+  CHECK(resolve("/cms/data/..")           == "");
 }
 
 TEST_CASE("Resolve storage areas with nested roots")
@@ -50,6 +52,25 @@ TEST_CASE("Resolve storage areas with nested access points")
 
   CHECK(resolve("/cms/file")      == "/storage/cms/file");
   CHECK(resolve("/cms/data/file") == "/storage2/cms/file");
+  CHECK(resolve("/cms/data/")     == "/storage2/cms");
+  CHECK(resolve("/cms/dat/file")  == "/storage/cms/dat/file");
+  CHECK(resolve("/cms/dir/")      == "/storage/cms/dir/");
+}
+
+TEST_CASE("Repeated separators are ignored")
+{
+  storm::StorageAreas const sas{
+    {"sa3", "/storage/cms" , {"/cms"}},
+    {"sa4", "/storage2/cms", {"/cms/data"}}
+  };
+  storm::StorageAreaResolver resolve{sas};
+
+  CHECK(resolve("/cms//file")            == "/storage/cms/file");
+  CHECK(resolve("//cms/file")            == "/storage/cms/file");
+  CHECK(resolve("/cms//data/file")       == "/storage2/cms/file");
+  CHECK(resolve("/cms/data//dir///file") == "/storage2/cms/dir/file");
+  CHECK(resolve("/cms/dir//")            == "/storage/cms/dir/");
+  CHECK(resolve("/cms//")                == "/storage/cms");
 }
 
 TEST_CASE("Resolve storage areas with nested access points and nested roots")
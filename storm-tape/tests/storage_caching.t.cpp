@@ -0,0 +1,178 @@
+// SPDX-FileCopyrightText: 2025 Istituto Nazionale di Fisica Nucleare
+//
+// SPDX-License-Identifier: EUPL-1.2
+
+#include "configuration.hpp"
+#include "storage_caching.hpp"
+
+#include <doctest/doctest.h>
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// the files are described by a map, the probes are counted
+struct FakeStorage : storm::Storage
+{
+  std::map<std::string, storm::FileProbe> files;
+  std::size_t n_probed{0};
+
+  storm::Result<bool> is_in_progress(storm::PhysicalPath const&) override
+  {
+    return false;
+  }
+  storm::Result<storm::FileSizeInfo>
+  file_size_info(storm::PhysicalPath const&) override
+  {
+    return storm::FileSizeInfo{};
+  }
+  storm::Result<bool> is_on_tape(storm::PhysicalPath const&) override
+  {
+    return false;
+  }
+
+  storm::FileProbes probe(std::span<storm::PhysicalPath const> paths) override
+  {
+    storm::FileProbes probes;
+    for (auto const& path : paths) {
+      ++n_probed;
+      auto it = files.find(path.native());
+      probes.push_back(it != files.end() ? it->second : storm::FileProbe{});
+    }
+    return probes;
+  }
+
+  std::vector<std::error_code>
+  request_recall(std::span<storm::PhysicalPath const> paths) override
+  {
+    for (auto const& path : paths) {
+      files[path.native()].in_progress = true;
+    }
+    return std::vector<std::error_code>(paths.size());
+  }
+};
+
+storm::FileProbe on_tape()
+{
+  return storm::FileProbe{.type     = fs::file_type::regular,
+                          .size     = 1024,
+                          .blocks   = 0,
+                          .migrated = true};
+}
+
+storm::FileProbe missing()
+{
+  return storm::FileProbe{
+      .type  = fs::file_type::not_found,
+      .error = std::make_error_code(std::errc::no_such_file_or_directory)};
+}
+
+storm::FileProbe failed()
+{
+  return storm::FileProbe{
+      .error = std::make_error_code(std::errc::permission_denied)};
+}
+
+} // namespace
+
+TEST_SUITE_BEGIN("CachingStorage");
+
+TEST_CASE("The probes are shared until they expire")
+{
+  FakeStorage fake;
+  fake.files["/a"] = on_tape();
+  fake.files["/b"] = missing();
+  fake.files["/c"] = failed();
+  storm::CachingStorage storage{
+      fake, storm::FileStatusCacheConfiguration{std::chrono::milliseconds{50}}};
+
+  storm::PhysicalPaths const paths{"/a", "/b", "/c"};
+  auto const first = storage.probe(paths);
+  CHECK_EQ(fake.n_probed, 3);
+  CHECK_EQ(first[0].locality(), storm::Locality::tape);
+  CHECK_EQ(first[1].type, fs::file_type::not_found);
+
+  // the existing and the missing files are cached, the failure is not
+  auto const second = storage.probe(paths);
+  CHECK_EQ(fake.n_probed, 4);
+  CHECK_EQ(second[0].locality(), storm::Locality::tape);
+  CHECK_EQ(second[1].type, fs::file_type::not_found);
+  CHECK_EQ(second[2].error, first[2].error);
+  CHECK_EQ(storage.stats().hits, 2);
+  CHECK_EQ(storage.stats().misses, 4);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds{60});
+  storage.probe(paths);
+  CHECK_EQ(fake.n_probed, 7);
+}
+
+TEST_CASE("Marking a file for recall forgets its probe")
+{
+  FakeStorage fake;
+  fake.files["/a"] = on_tape();
+  fake.files["/b"] = on_tape();
+  storm::CachingStorage storage{fake, storm::FileStatusCacheConfiguration{}};
+
+  storm::PhysicalPaths const paths{"/a", "/b"};
+  auto probes = storage.probe(paths);
+  CHECK_FALSE(probes[0].in_progress);
+
+  storm::PhysicalPaths const recalled{"/a"};
+  storage.request_recall(recalled);
+
+  probes = storage.probe(paths);
+  CHECK(probes[0].in_progress);
+  CHECK_FALSE(probes[1].in_progress);
+  CHECK_EQ(fake.n_probed, 3);
+}
+
+TEST_CASE("The cache remembers a bounded number of files")
+{
+  FakeStorage fake;
+  storm::PhysicalPaths paths;
+  for (int i{0}; i != 1'000; ++i) {
+    paths.emplace_back("/file" + std::to_string(i));
+    fake.files[paths.back().native()] = on_tape();
+  }
+  storm::CachingStorage storage{
+      fake, storm::FileStatusCacheConfiguration{.max_files = 160}};
+
+  storage.probe(paths);
+  storage.probe(paths);
+  // at most 10 files per shard survive
+  CHECK_LE(storage.stats().hits, 160);
+  CHECK_EQ(fake.n_probed, 2'000 - storage.stats().hits);
+}
+
+TEST_CASE("A full cache evicts the oldest probes first")
+{
+  FakeStorage fake;
+  storm::PhysicalPaths paths;
+  for (int i{0}; i != 1'000; ++i) {
+    paths.emplace_back("/file" + std::to_string(i));
+    fake.files[paths.back().native()] = on_tape();
+  }
+  storm::CachingStorage storage{
+      fake, storm::FileStatusCacheConfiguration{.max_files = 160}};
+
+  // every shard is filled, then keeps inserting
+  storage.probe(paths);
+  CHECK_EQ(storage.stats().misses, 1'000);
+
+  // whatever their shard, the last 10 files are among its 10 most recent
+  storage.probe(std::span{paths}.last(10));
+  CHECK_EQ(storage.stats().hits, 10);
+  storage.probe(std::span{paths}.first(10));
+  CHECK_EQ(storage.stats().hits, 10);
+
+  // inserting again into a full shard still works
+  storage.probe(std::span{paths}.first(10));
+  CHECK_EQ(storage.stats().hits, 20);
+  CHECK_EQ(fake.n_probed, 1'010);
+}
+
+TEST_SUITE_END;
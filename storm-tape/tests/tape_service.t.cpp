@@ -462,6 +462,37 @@ TEST_CASE("Cancel")
   CHECK(in_progress.paths.empty());
 }
 
+TEST_CASE("Ready take-over counts each submitted physical path once")
+{
+  auto fixture      = storm::TestFixture();
+  auto& service     = fixture.get_service();
+  auto const& files = fixture.get_files();
+  auto const now    = std::time(nullptr);
+  REQUIRE_EQ(files.size(), 2);
+  fixture.create_stub_on_disk_at(0);
+  fixture.create_stub_on_disk_at(1);
+
+  // two stages requesting the same files
+  auto id1 = service.stage({files, now, 0, 0}).id();
+  auto id2 = service.stage({files, now, 0, 0}).id();
+  CHECK_EQ(service.ready_take_over().n_ready, 2);
+
+  // taking over a path moves it out of submitted in both stages
+  auto to_response = service.take_over({1});
+  REQUIRE_EQ(to_response.paths.size(), 1);
+  CHECK_EQ(service.ready_take_over().n_ready, 1);
+
+  // the other path is still submitted in the first stage
+  service.erase(id2);
+  CHECK_EQ(service.ready_take_over().n_ready, 1);
+
+  storm::LogicalPaths paths;
+  std::transform(files.begin(), files.end(), std::back_inserter(paths),
+                 [](storm::File const& f) { return f.logical_path; });
+  service.cancel(id1, storm::CancelRequest{paths});
+  CHECK_EQ(service.ready_take_over().n_ready, 0);
+}
+
 TEST_CASE("Empty Stage")
 {
   auto fixture        = storm::TestFixture();
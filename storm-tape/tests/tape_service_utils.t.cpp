@@ -0,0 +1,161 @@
+// SPDX-FileCopyrightText: 2025 Istituto Nazionale di Fisica Nucleare
+//
+// SPDX-License-Identifier: EUPL-1.2
+
+#include "tape_service_utils.hpp"
+#include "fixture.t.hpp"
+
+#include <doctest/doctest.h>
+#include <tbb/task_arena.h>
+#include <algorithm>
+#include <filesystem>
+#include <ctime>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// the status of a file depends on the number in its name
+struct FakeStorage : storm::Storage
+{
+  static int number(storm::PhysicalPath const& path)
+  {
+    return std::stoi(path.filename().string());
+  }
+
+  storm::Result<bool> is_in_progress(storm::PhysicalPath const& path) override
+  {
+    if (number(path) % 7 == 0) {
+      return std::make_error_code(std::errc::no_such_file_or_directory);
+    }
+    return number(path) % 3 == 0;
+  }
+
+  storm::Result<storm::FileSizeInfo>
+  file_size_info(storm::PhysicalPath const& path) override
+  {
+    return storm::FileSizeInfo{1024, number(path) % 3 == 1};
+  }
+
+  storm::Result<bool> is_on_tape(storm::PhysicalPath const&) override
+  {
+    return true;
+  }
+
+  storm::FileProbes probe(std::span<storm::PhysicalPath const> paths) override
+  {
+    storm::FileProbes probes;
+    for (auto const& path : paths) {
+      storm::FileProbe probe{};
+      if (number(path) % 7 == 0) {
+        probe.type  = fs::file_type::not_found;
+        probe.error =
+            std::make_error_code(std::errc::no_such_file_or_directory);
+      } else {
+        probe.type        = fs::file_type::regular;
+        probe.size        = 1024;
+        probe.blocks      = number(path) % 3 == 1 ? 0 : 2;
+        probe.in_progress = number(path) % 3 == 0;
+        probe.migrated    = true;
+      }
+      probes.push_back(probe);
+    }
+    return probes;
+  }
+};
+
+// half of the files are still to be started
+storm::Files make_pending_files(std::size_t n)
+{
+  auto files = storm::make_files(n);
+  for (auto& file : files) {
+    auto const i = FakeStorage::number(file.physical_path);
+    file.state =
+        i % 2 == 0 ? storm::File::State::submitted : storm::File::State::started;
+  }
+  return files;
+}
+
+} // namespace
+
+TEST_SUITE_BEGIN("TapeServiceUtils");
+
+TEST_CASE("The parallel status loop finds the same changes as the sequential")
+{
+  FakeStorage storage;
+  auto const now = std::time(nullptr);
+
+  auto sequential_files = make_pending_files(10'000);
+  storm::FileUpdates sequential_updates;
+  storm::status_loop(sequential_files, storage, now, sequential_updates);
+
+  tbb::task_arena arena{4};
+  auto parallel_files = make_pending_files(10'000);
+  storm::FileUpdates parallel_updates;
+  storm::status_loop(parallel_files, storage, now, parallel_updates,
+                     storm::Parallelism{arena, 100});
+
+  CHECK_FALSE(sequential_updates.empty());
+  // the order of the changes found in parallel is not deterministic
+  std::sort(sequential_updates.begin(), sequential_updates.end());
+  std::sort(parallel_updates.begin(), parallel_updates.end());
+  CHECK_EQ(parallel_updates, sequential_updates);
+  CHECK(std::equal(sequential_files.begin(), sequential_files.end(),
+                   parallel_files.begin(), parallel_files.end(),
+                   [](auto const& f1, auto const& f2) {
+                     return f1.state == f2.state
+                         && f1.started_at == f2.started_at
+                         && f1.finished_at == f2.finished_at;
+                   }));
+}
+
+TEST_CASE("The ranges of a loop cover all the indexes once")
+{
+  tbb::task_arena arena{4};
+  std::vector<int> visits(10'050);
+  storm::for_each_range(visits.size(), storm::Parallelism{arena, 100},
+                        [&](std::size_t first, std::size_t last) {
+                          CHECK_LE(last - first, 100);
+                          for (auto i = first; i != last; ++i) {
+                            ++visits[i];
+                          }
+                        });
+  CHECK(std::all_of(visits.begin(), visits.end(),
+                    [](int v) { return v == 1; }));
+
+  // a batch that fits in a task is processed in a single range
+  int n_ranges = 0;
+  storm::for_each_range(100, storm::Parallelism{arena, 100},
+                        [&](std::size_t first, std::size_t last) {
+                          CHECK_EQ(first, 0);
+                          CHECK_EQ(last, 100);
+                          ++n_ranges;
+                        });
+  CHECK_EQ(n_ranges, 1);
+}
+
+TEST_CASE("The localities found in parallel keep the order of the paths")
+{
+  FakeStorage storage;
+
+  storm::PhysicalPaths paths;
+  for (auto const& file : storm::make_files(10'000)) {
+    paths.push_back(file.physical_path);
+  }
+
+  auto const sequential =
+      storm::extend_paths_with_localities(storm::PhysicalPaths{paths}, storage);
+
+  tbb::task_arena arena{4};
+  auto const parallel = storm::extend_paths_with_localities(
+      storm::PhysicalPaths{paths}, storage, storm::Parallelism{arena, 100});
+
+  CHECK_EQ(parallel, sequential);
+  CHECK_EQ(sequential.front().first, paths.front());
+  CHECK_EQ(sequential.back().first, paths.back());
+}
+
+TEST_SUITE_END;
@@ -0,0 +1,60 @@
+// SPDX-FileCopyrightText: 2025 Istituto Nazionale di Fisica Nucleare
+//
+// SPDX-License-Identifier: EUPL-1.2
+
+#include "uuid_generator.hpp"
+
+#include <doctest/doctest.h>
+#include <algorithm>
+#include <functional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+TEST_SUITE_BEGIN("UuidGenerator");
+
+TEST_CASE("A generated UUID is a version 7 UUID in canonical form")
+{
+  storm::UuidGenerator uuid_gen;
+  auto const uuid = uuid_gen();
+  REQUIRE_EQ(uuid.size(), 36);
+  for (auto i : {8, 13, 18, 23}) {
+    CHECK_EQ(uuid[i], '-');
+  }
+  CHECK_EQ(uuid[14], '7');
+  CHECK_NE(std::string_view{"89ab"}.find(uuid[19]), std::string_view::npos);
+}
+
+TEST_CASE("The UUIDs generated by a thread are strictly increasing")
+{
+  storm::UuidGenerator uuid_gen;
+  std::vector<std::string> uuids(10'000);
+  std::generate(uuids.begin(), uuids.end(), uuid_gen);
+  CHECK(std::adjacent_find(uuids.begin(), uuids.end(),
+                           std::greater_equal<>{})
+        == uuids.end());
+}
+
+TEST_CASE("A generator can be shared by multiple threads")
+{
+  storm::UuidGenerator const uuid_gen;
+  std::vector<std::vector<std::string>> uuids(8);
+  {
+    std::vector<std::jthread> threads;
+    for (auto& v : uuids) {
+      threads.emplace_back([&] {
+        v.resize(1'000);
+        std::generate(v.begin(), v.end(), uuid_gen);
+      });
+    }
+  }
+  std::set<std::string> all;
+  for (auto const& v : uuids) {
+    all.insert(v.begin(), v.end());
+  }
+  CHECK_EQ(all.size(), 8'000);
+}
+
+TEST_SUITE_END;